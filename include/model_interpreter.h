@@ -1,7 +1,9 @@
 #ifndef MODEL_INTERPRETER_H
 #define MODEL_INTERPRETER_H
 
+// Models are loaded into a shared registry and referred to by handle. They
+// are executed through a session, which owns the tensors of a run.
 int load_model(const char *model_path);
-int execute_model(void);
+int unload_model(int handle);
 
 #endif // MODEL_INTERPRETER_H
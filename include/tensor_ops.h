@@ -0,0 +1,380 @@
+#ifndef TENSOR_OPS_H
+#define TENSOR_OPS_H
+
+#include <linux/types.h>
+#include <linux/limits.h>
+#include "tensor_results.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared compute kernels used by the TensorFlow / TensorFlow Lite interpreters.
+// Quantized tensors are stored as raw bytes. Kernels work in the unsigned
+// domain: int8 tensors are mapped onto it by XOR-ing every byte with 0x80
+// (which adds 128 to the value), so one kernel set serves uint8 and int8 models.
+
+#define TENSOR_OPS_INT8_XOR 0x80
+
+// IEEE-754 single precision bit patterns used when deriving multipliers
+#define TENSOR_OPS_FLOAT_ONE_BITS 0x3f800000u
+#define TENSOR_OPS_FLOAT_LN2_BITS 0x3f317218u
+#define TENSOR_OPS_FLOAT_1_256_BITS 0x3b800000u
+#define TENSOR_OPS_FLOAT_SIX_BITS 0x40c00000u
+#define TENSOR_OPS_FLOAT_MINUS_ONE_BITS 0xbf800000u
+#define TENSOR_OPS_FLOAT_MAX_BITS 0x7f7fffffu
+#define TENSOR_OPS_FLOAT_LOWEST_BITS 0xff7fffffu
+
+// Fixed-point multiplier: real = multiplier * 2^(shift - 31)
+struct quant_multiplier {
+    int32_t multiplier;
+    int shift;
+};
+
+// Parameters for quantized CONV_2D and DEPTHWISE_CONV_2D (NHWC layout)
+struct qconv_params {
+    int stride_h;
+    int stride_w;
+    int dilation_h;
+    int dilation_w;
+    int pad_h;
+    int pad_w;
+    int depth_multiplier;       // DEPTHWISE_CONV_2D only
+    int32_t input_offset;       // -input_zero_point (unsigned domain)
+    int32_t filter_offset;      // -filter_zero_point (unsigned domain)
+    int32_t output_offset;      // output_zero_point (unsigned domain)
+    uint8_t input_xor;
+    uint8_t filter_xor;
+    uint8_t output_xor;
+    int32_t act_min;            // clamp range in the unsigned domain
+    int32_t act_max;
+    const struct quant_multiplier *output_multiplier; // one per output channel
+};
+
+// Parameters for quantized AVERAGE_POOL_2D; input and output share quantization
+struct qpool_params {
+    int stride_h;
+    int stride_w;
+    int filter_h;
+    int filter_w;
+    int pad_h;
+    int pad_w;
+    uint8_t xor_mask;
+    int32_t act_min;
+    int32_t act_max;
+};
+
+// Parameters for quantized SOFTMAX; output scale is fixed at 1/256
+struct qsoftmax_params {
+    uint8_t input_xor;
+    uint8_t output_xor;
+    int32_t output_offset;      // output_zero_point (unsigned domain)
+    uint32_t exp_lut[256];      // exp(-beta * scale * d) in Q31, d = max - x
+};
+
+// Parameters for quantized ADD / SUB / MUL on equally shaped tensors
+struct qelementwise_params {
+    int32_t input1_offset;      // -input1_zero_point (unsigned domain)
+    int32_t input2_offset;      // -input2_zero_point (unsigned domain)
+    int32_t output_offset;      // output_zero_point (unsigned domain)
+    uint8_t input1_xor;
+    uint8_t input2_xor;
+    uint8_t output_xor;
+    int left_shift;             // ADD / SUB only
+    struct quant_multiplier input1_multiplier;  // ADD / SUB only
+    struct quant_multiplier input2_multiplier;  // ADD / SUB only
+    struct quant_multiplier output_multiplier;
+    int32_t act_min;            // clamp range in the unsigned domain
+    int32_t act_max;
+};
+
+// Binary elementwise operations for the broadcasting engine
+#define TENSOR_OPS_BINARY_ADD 0
+#define TENSOR_OPS_BINARY_SUB 1
+#define TENSOR_OPS_BINARY_MUL 2
+#define TENSOR_OPS_BINARY_DIV 3     // float only
+
+#define TENSOR_OPS_BROADCAST_MAX_DIMS 6
+
+// Broadcast of two inputs onto an output shape, with dims collapsed to the
+// fewest strided loops by tensor_ops_broadcast_prepare()
+struct broadcast_params {
+    int num_dims;
+    size_t dims[TENSOR_OPS_BROADCAST_MAX_DIMS];            // outermost first
+    size_t input1_strides[TENSOR_OPS_BROADCAST_MAX_DIMS];  // in elements, 0 where broadcast
+    size_t input2_strides[TENSOR_OPS_BROADCAST_MAX_DIMS];
+    size_t output_size;
+};
+
+// Output rows per packed weight panel of the quantized GEMM
+#define TENSOR_OPS_QGEMM_NR 4
+
+// Parameters for quantized FULLY_CONNECTED: output[b][n] = sum_k input[b][k] * weights[n][k]
+struct qfc_params {
+    int output_depth;
+    int accum_depth;
+    const uint8_t *packed_weights;  // from tensor_ops_qgemm_pack_weights()
+    const int32_t *bias;            // from tensor_ops_qgemm_fold_bias()
+    int32_t input_offset;           // -input_zero_point (unsigned domain)
+    int32_t filter_offset;          // -filter_zero_point (unsigned domain)
+    int32_t output_offset;          // output_zero_point (unsigned domain)
+    uint8_t input_xor;
+    uint8_t output_xor;
+    int32_t act_min;                // clamp range in the unsigned domain
+    int32_t act_max;
+    const struct quant_multiplier *output_multiplier; // one per output channel
+};
+
+// Parameters for float32 MAX_POOL_2D and AVERAGE_POOL_2D (NHWC layout)
+struct fpool_params {
+    int stride_h;
+    int stride_w;
+    int filter_h;
+    int filter_w;
+    int pad_h;
+    int pad_w;
+    float act_min;
+    float act_max;
+};
+
+// Float32 CONV_2D algorithms
+#define TENSOR_OPS_CONV_DIRECT 0
+#define TENSOR_OPS_CONV_WINOGRAD 1     // F(2x2, 3x3): 3x3 filters, stride 1, no dilation
+
+// Parameters for float32 CONV_2D (NHWC layout)
+struct fconv_params {
+    int stride_h;
+    int stride_w;
+    int dilation_h;
+    int dilation_w;
+    int pad_h;
+    int pad_w;
+    int algorithm;                  // from tensor_ops_conv2d_f32_select()
+    const float *packed_filter;     // from tensor_ops_conv2d_f32_pack_filter()
+    const float *bias;              // may be NULL
+    float act_min;
+    float act_max;
+};
+
+// One tensor to be placed in a shared activation arena. first_use/last_use
+// are the indices of the first and last operator that touch the tensor.
+struct arena_allocation {
+    size_t size;
+    int first_use;
+    int last_use;
+    size_t offset;              // filled in by tensor_ops_plan_arena()
+};
+
+// Saturating rounding doubling high multiply, as in gemmlowp
+static inline int32_t tensor_ops_sat_rounding_doubling_high_mul(int32_t a, int32_t b) {
+    int64_t ab;
+    int64_t rounded;
+
+    if (a == INT_MIN && b == INT_MIN)
+        return INT_MAX;
+
+    ab = (int64_t)a * b;
+    rounded = ab + (ab >= 0 ? (1ll << 30) : (1 - (1ll << 30)));
+    // Divide by 2^31 rounding toward zero without a 64-bit division
+    return (int32_t)(rounded >= 0 ? rounded >> 31 : -((-rounded) >> 31));
+}
+
+// Rounding arithmetic right shift, rounding half away from zero
+static inline int32_t tensor_ops_rounding_divide_by_pot(int32_t x, int exponent) {
+    int32_t mask;
+    int32_t remainder;
+    int32_t threshold;
+
+    if (exponent <= 0)
+        return x;
+    if (exponent > 31)
+        return 0;
+
+    mask = (int32_t)((1ll << exponent) - 1);
+    remainder = x & mask;
+    threshold = (mask >> 1) + (x < 0 ? 1 : 0);
+    return (x >> exponent) + (remainder > threshold ? 1 : 0);
+}
+
+static inline int32_t tensor_ops_multiply_by_quantized_multiplier(int32_t x, const struct quant_multiplier *qm) {
+    int left_shift = qm->shift > 0 ? qm->shift : 0;
+    int right_shift = qm->shift > 0 ? 0 : -qm->shift;
+
+    return tensor_ops_rounding_divide_by_pot(
+        tensor_ops_sat_rounding_doubling_high_mul(x * (1 << left_shift), qm->multiplier),
+        right_shift);
+}
+
+static inline int32_t tensor_ops_clamp(int32_t v, int32_t lo, int32_t hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Fixed-point helpers (tensor_ops_quant.c). Scales are passed as the raw bits
+// of the float32 values stored in the model so that no FPU state is touched.
+int tensor_ops_quantize_ratio(uint32_t num_a_bits, uint32_t num_b_bits, uint32_t den_bits,
+                              int pot, struct quant_multiplier *qm);
+int tensor_ops_softmax_prepare(uint32_t beta_bits, uint32_t input_scale_bits,
+                               struct qsoftmax_params *params);
+int tensor_ops_compute_padding(int in_size, int filter_size, int stride, int dilation,
+                               int out_size, bool same_padding);
+
+// Static memory planning (tensor_ops_arena.c). Tensors whose lifetimes
+// overlap never share memory; the resulting peak size is returned in arena_size.
+int tensor_ops_plan_arena(struct arena_allocation *allocations, int count,
+                          size_t alignment, size_t *arena_size);
+
+// Quantized 8-bit kernels (tensor_ops_quant.c). Dims are NHWC; the conv
+// filter is OHWI and the depthwise filter is 1HW(C*M).
+void tensor_ops_conv2d_q8(const struct qconv_params *params,
+                          const int *input_dims, const uint8_t *input,
+                          const int *filter_dims, const uint8_t *filter,
+                          const int32_t *bias,
+                          const int *output_dims, uint8_t *output);
+void tensor_ops_depthwise_conv2d_q8(const struct qconv_params *params,
+                                    const int *input_dims, const uint8_t *input,
+                                    const int *filter_dims, const uint8_t *filter,
+                                    const int32_t *bias,
+                                    const int *output_dims, uint8_t *output);
+void tensor_ops_average_pool2d_q8(const struct qpool_params *params,
+                                  const int *input_dims, const uint8_t *input,
+                                  const int *output_dims, uint8_t *output);
+void tensor_ops_softmax_q8(const struct qsoftmax_params *params,
+                           int outer_size, int depth,
+                           const uint8_t *input, uint8_t *output);
+
+// Quantized 8-bit elementwise kernels (tensor_ops_elementwise.c). The
+// multipliers are derived once by the prepare functions, so the kernels
+// themselves are integer only. Large tensors run vectorized inside an FPU
+// section of their own, or scalar if the caller already holds one.
+int tensor_ops_add_prepare(uint32_t input1_scale_bits, uint32_t input2_scale_bits,
+                           uint32_t output_scale_bits, struct qelementwise_params *params);
+int tensor_ops_mul_prepare(uint32_t input1_scale_bits, uint32_t input2_scale_bits,
+                           uint32_t output_scale_bits, struct qelementwise_params *params);
+void tensor_ops_add_q8(const struct qelementwise_params *params, size_t size,
+                       const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+void tensor_ops_sub_q8(const struct qelementwise_params *params, size_t size,
+                       const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+void tensor_ops_mul_q8(const struct qelementwise_params *params, size_t size,
+                       const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+
+// Broadcasting binary ops (tensor_ops_broadcast.c). Shapes follow NumPy
+// rules, right-aligned; inputs may have a lower rank than the output. A
+// scratch buffer of tensor_ops_broadcast_scratch_size() bytes is needed when
+// an input is broadcast along the innermost dim; it holds one splat buffer
+// per thread pool slot. The f32 variant must be
+// called inside kernel_fpu_begin/end; the q8 one opens its own section.
+int tensor_ops_broadcast_prepare(int rank1, const int *dims1, int rank2, const int *dims2,
+                                 int output_rank, const int *output_dims, struct broadcast_params *params);
+size_t tensor_ops_broadcast_scratch_size(const struct broadcast_params *params, size_t element_size);
+void tensor_ops_broadcast_f32(const struct broadcast_params *params, int op,
+                              const float *input1, const float *input2, float *output, float *scratch);
+void tensor_ops_broadcast_q8(const struct broadcast_params *params, int op,
+                             const struct qelementwise_params *q8_params,
+                             const uint8_t *input1, const uint8_t *input2, uint8_t *output, uint8_t *scratch);
+
+// Quantized GEMM (tensor_ops_gemm.c). Weights are repacked once at prepare
+// time; the kernel accumulates in int32 and needs a scratch buffer of
+// tensor_ops_fully_connected_q8_scratch_size() bytes.
+size_t tensor_ops_qgemm_packed_size(int output_depth, int accum_depth);
+void tensor_ops_qgemm_pack_weights(int output_depth, int accum_depth, const uint8_t *weights,
+                                   uint8_t xor_mask, uint8_t *packed);
+void tensor_ops_qgemm_fold_bias(const struct qfc_params *params, const int32_t *bias, int32_t *folded_bias);
+size_t tensor_ops_fully_connected_q8_scratch_size(int output_depth, int batches);
+void tensor_ops_fully_connected_q8(const struct qfc_params *params, int batches,
+                                   const uint8_t *input, uint8_t *output, int32_t *scratch);
+
+// Float32 elementwise kernels, vectorized for the CPU found at module load.
+// Callers must be inside kernel_fpu_begin/end.
+void tensor_ops_add_f32(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_sub_f32(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_mul_f32(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_div_f32(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_max_f32(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_relu_f32(size_t size, const float *input, float *output);
+const char *tensor_ops_simd_name(void);
+
+// Float32 pooling (tensor_ops_pool_f32.c). Windows are clipped to the input,
+// so padding never contributes; each window reduces whole channel rows with
+// the vector kernels above. Callers must be inside kernel_fpu_begin/end.
+void tensor_ops_max_pool2d_f32(const struct fpool_params *params,
+                               const int *input_dims, const float *input,
+                               const int *output_dims, float *output);
+void tensor_ops_average_pool2d_f32(const struct fpool_params *params,
+                                   const int *input_dims, const float *input,
+                                   const int *output_dims, float *output);
+
+// Float32 convolution (tensor_ops_conv.c). The algorithm is chosen per layer
+// shape from a cost table measured at module load, the filter is repacked
+// for it once, and the kernel needs tensor_ops_conv2d_f32_scratch_size()
+// bytes of scratch, sized for every thread pool slot. Both calls open their
+// own FPU section and return -EBUSY when vector registers cannot be used in
+// the calling context.
+int tensor_ops_conv2d_f32_select(const struct fconv_params *params, const int *filter_dims, const int *output_dims);
+size_t tensor_ops_conv2d_f32_packed_size(int algorithm, const int *filter_dims);
+size_t tensor_ops_conv2d_f32_scratch_size(int algorithm, const int *filter_dims);
+int tensor_ops_conv2d_f32_pack_filter(int algorithm, const int *filter_dims, const float *filter, float *packed);
+int tensor_ops_conv2d_f32(const struct fconv_params *params,
+                          const int *input_dims, const float *input,
+                          const int *filter_dims,
+                          const int *output_dims, float *output, float *scratch);
+
+// Intra-op parallelism (tensor_ops_parallel.c). fn is called on disjoint
+// [begin, end) ranges of count items, on the calling thread (slot 0) and on
+// per-CPU worker threads (slots 1 to tensor_ops_parallel_slots() - 1), so
+// per-slot scratch needs tensor_ops_parallel_slots() copies. item_cost is the
+// work per item in inner-loop operations and sets the split grain. Jobs whose
+// caller holds an FPU section pass TENSOR_OPS_PARALLEL_FPU; the section is
+// left while the caller waits for the workers, so vector registers do not
+// keep their contents across the call.
+#define TENSOR_OPS_PARALLEL_FPU 0x1
+
+typedef void (*tensor_ops_parallel_fn)(void *context, size_t begin, size_t end, int slot);
+
+int tensor_ops_parallel_slots(void);
+void tensor_ops_parallel_for(size_t count, size_t item_cost, unsigned int flags,
+                             tensor_ops_parallel_fn fn, void *context);
+
+// Task graphs. Task i starts once num_predecessors[i] tasks listing it among
+// their successors have finished; the successors of task i are
+// successors[successor_offsets[i]] to successors[successor_offsets[i + 1] - 1].
+// Tasks must be numbered in a topological order, which is the order they run
+// in when no worker threads are available. pending is scratch for num_tasks
+// counters. With TENSOR_OPS_PARALLEL_FPU every task runs inside an FPU
+// section of its own, so the caller must not hold one. The first error a task
+// returns is returned once all tasks are done; later tasks are then skipped.
+struct tensor_ops_task_graph {
+    int num_tasks;
+    const int *num_predecessors;
+    const int *successor_offsets;
+    const int *successors;
+};
+
+typedef int (*tensor_ops_task_fn)(void *context, int task, int slot);
+
+int tensor_ops_parallel_run_graph(const struct tensor_ops_task_graph *graph, atomic_t *pending, unsigned int flags,
+                                  tensor_ops_task_fn fn, void *context);
+
+// Model files mapped read-only from the page cache (tensor_ops_model_map.c).
+// Loads of the same file version share one mapping of its page-cache pages,
+// which are used in place rather than copied. data is followed by at least
+// one zero byte. Returns an ERR_PTR on failure; every successful map needs a
+// tensor_ops_model_unmap(), which accepts NULL.
+struct model_mapping {
+    const void *data;
+    size_t size;
+};
+
+struct model_mapping *tensor_ops_model_map(const char *path);
+void tensor_ops_model_unmap(struct model_mapping *mapping);
+
+// Output tensors in the binary framing of tensor_results.h
+// (tensor_ops_results.c). Returns a kvmalloc'ed stream of *size bytes to be
+// released with kvfree(), or NULL.
+void *tensor_ops_pack_results(const struct tensor_result_header *headers, const void *const *data,
+                              int count, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TENSOR_OPS_H
@@ -0,0 +1,102 @@
+#ifndef TENSOR_OPS_SIMD_H
+#define TENSOR_OPS_SIMD_H
+
+#include <linux/types.h>
+#include <asm/simd.h>
+#ifdef CONFIG_X86
+#include <asm/fpu/api.h>
+#endif
+#ifdef CONFIG_ARM64
+#include <asm/neon.h>
+#endif
+#include "tensor_ops.h"
+
+// Internal to tensor_ops: one table of elementwise kernels per instruction
+// set. The table in use is picked once at module load by tensor_ops_simd_init().
+struct tensor_ops_simd_kernels {
+    const char *name;
+    void (*add_f32)(size_t size, const float *input1, const float *input2, float *output);
+    void (*sub_f32)(size_t size, const float *input1, const float *input2, float *output);
+    void (*mul_f32)(size_t size, const float *input1, const float *input2, float *output);
+    void (*div_f32)(size_t size, const float *input1, const float *input2, float *output);
+    void (*max_f32)(size_t size, const float *input1, const float *input2, float *output);
+    void (*relu_f32)(size_t size, const float *input, float *output);
+    void (*add_q8)(const struct qelementwise_params *params, size_t size,
+                   const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+    void (*sub_q8)(const struct qelementwise_params *params, size_t size,
+                   const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+    void (*mul_q8)(const struct qelementwise_params *params, size_t size,
+                   const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+};
+
+// Below this many elements the quantized kernels stay scalar, because entering
+// an FPU section costs more than vectorizing saves
+#define TENSOR_OPS_SIMD_Q8_MIN_ELEMENTS 1024
+
+extern const struct tensor_ops_simd_kernels tensor_ops_scalar_kernels;
+#ifdef CONFIG_X86
+extern const struct tensor_ops_simd_kernels tensor_ops_sse2_kernels;
+extern const struct tensor_ops_simd_kernels tensor_ops_avx2_kernels;
+#endif
+#ifdef CONFIG_ARM64
+extern const struct tensor_ops_simd_kernels tensor_ops_neon_kernels;
+#endif
+
+// Scalar kernels, also used for the tails of the vector loops.
+// The float ones live in tensor_ops_simd_generic.c, built with FPU flags.
+void tensor_ops_add_f32_generic(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_sub_f32_generic(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_mul_f32_generic(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_div_f32_generic(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_max_f32_generic(size_t size, const float *input1, const float *input2, float *output);
+void tensor_ops_relu_f32_generic(size_t size, const float *input, float *output);
+void tensor_ops_add_q8_scalar(const struct qelementwise_params *params, size_t size,
+                              const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+void tensor_ops_sub_q8_scalar(const struct qelementwise_params *params, size_t size,
+                              const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+void tensor_ops_mul_q8_scalar(const struct qelementwise_params *params, size_t size,
+                              const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+
+// Float32 convolution kernels (tensor_ops_conv_f32.c, built with FPU flags)
+void tensor_ops_conv2d_f32_pack_generic(int algorithm, const int *filter_dims, const float *filter, float *packed);
+// The kernel computes output rows [row_begin, row_end) of
+// tensor_ops_conv2d_f32_rows(); for Winograd a row is a row of 2x2 tiles.
+size_t tensor_ops_conv2d_f32_rows(int algorithm, const int *output_dims);
+void tensor_ops_conv2d_f32_generic(const struct fconv_params *params, const int *input_dims, const float *input,
+                                   const int *filter_dims, const int *output_dims, float *output, float *scratch,
+                                   size_t row_begin, size_t row_end);
+
+const char *tensor_ops_simd_init(const char *requested);
+const struct tensor_ops_simd_kernels *tensor_ops_simd_active(void);
+int tensor_ops_simd_variants(const struct tensor_ops_simd_kernels **variants, int max_variants);
+void tensor_ops_simd_benchmark(void);
+int tensor_ops_selftest(void);
+int tensor_ops_conv_init(const char *requested);
+int tensor_ops_parallel_init(unsigned int max_threads);
+void tensor_ops_parallel_exit(void);
+
+// Enter a section in which vector registers may be used. Returns false when
+// that is not possible here, e.g. when already inside such a section. The
+// interpreters open their float sections through these as well, so they
+// build on every architecture tensor_ops supports.
+static inline bool tensor_ops_simd_begin(void) {
+    if (!may_use_simd()) {
+        return false;
+    }
+#if defined(CONFIG_X86)
+    kernel_fpu_begin();
+#elif defined(CONFIG_ARM64)
+    kernel_neon_begin();
+#endif
+    return true;
+}
+
+static inline void tensor_ops_simd_end(void) {
+#if defined(CONFIG_X86)
+    kernel_fpu_end();
+#elif defined(CONFIG_ARM64)
+    kernel_neon_end();
+#endif
+}
+
+#endif // TENSOR_OPS_SIMD_H
@@ -0,0 +1,206 @@
+#ifndef TENSOR_OPS_SIMD_IMPL_H
+#define TENSOR_OPS_SIMD_IMPL_H
+
+// Vector elementwise kernels written with GCC vector extensions. Each per-ISA
+// translation unit defines SIMD_VECTOR_BYTES and SIMD_SUFFIX, includes this
+// file and is compiled with the matching -m flags, so the same source yields
+// SSE2, AVX2 and NEON code. Tails shorter than one vector use the scalar kernels.
+
+#include <linux/string.h>
+#include "tensor_ops_simd.h"
+
+#if !defined(SIMD_VECTOR_BYTES) || !defined(SIMD_SUFFIX)
+#error "SIMD_VECTOR_BYTES and SIMD_SUFFIX must be defined"
+#endif
+
+#define SIMD_CONCAT_(name, suffix) name##_##suffix
+#define SIMD_CONCAT(name, suffix) SIMD_CONCAT_(name, suffix)
+#define SIMD_FN(name) SIMD_CONCAT(name, SIMD_SUFFIX)
+
+// Number of 32-bit lanes; 8-bit data is widened to 32 bits before any math
+#define SIMD_LANES (SIMD_VECTOR_BYTES / 4)
+
+typedef float v_f32 __attribute__((vector_size(SIMD_VECTOR_BYTES)));
+typedef int32_t v_i32 __attribute__((vector_size(SIMD_VECTOR_BYTES)));
+typedef uint32_t v_u32 __attribute__((vector_size(SIMD_VECTOR_BYTES)));
+typedef int64_t v_i64 __attribute__((vector_size(SIMD_VECTOR_BYTES * 2)));
+typedef uint64_t v_u64 __attribute__((vector_size(SIMD_VECTOR_BYTES * 2)));
+typedef uint8_t v_u8 __attribute__((vector_size(SIMD_VECTOR_BYTES / 4)));
+
+static inline v_f32 load_f32(const float *p) {
+    v_f32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store_f32(float *p, v_f32 v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+#define SIMD_BINARY_F32(name, op)                                                            \
+static void SIMD_FN(name)(size_t size, const float *input1, const float *input2, float *output) { \
+    size_t i = 0;                                                                            \
+    for (; i + SIMD_LANES <= size; i += SIMD_LANES) {                                        \
+        store_f32(output + i, load_f32(input1 + i) op load_f32(input2 + i));                 \
+    }                                                                                        \
+    tensor_ops_##name##_generic(size - i, input1 + i, input2 + i, output + i);               \
+}
+
+SIMD_BINARY_F32(add_f32, +)
+SIMD_BINARY_F32(sub_f32, -)
+SIMD_BINARY_F32(mul_f32, *)
+SIMD_BINARY_F32(div_f32, /)
+
+static void SIMD_FN(max_f32)(size_t size, const float *input1, const float *input2, float *output) {
+    size_t i = 0;
+
+    for (; i + SIMD_LANES <= size; i += SIMD_LANES) {
+        v_f32 a = load_f32(input1 + i);
+        v_f32 b = load_f32(input2 + i);
+        v_i32 greater = a > b;
+        store_f32(output + i, (v_f32)(((v_i32)a & greater) | ((v_i32)b & ~greater)));
+    }
+    tensor_ops_max_f32_generic(size - i, input1 + i, input2 + i, output + i);
+}
+
+static void SIMD_FN(relu_f32)(size_t size, const float *input, float *output) {
+    const v_f32 zero = { 0 };
+    size_t i = 0;
+
+    for (; i + SIMD_LANES <= size; i += SIMD_LANES) {
+        v_f32 v = load_f32(input + i);
+        v_i32 positive = v > zero;
+        store_f32(output + i, (v_f32)((v_i32)v & positive));
+    }
+    tensor_ops_relu_f32_generic(size - i, input + i, output + i);
+}
+
+static inline v_i32 load_q8(const uint8_t *p, uint8_t xor_mask) {
+    v_u8 v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_convertvector(v ^ xor_mask, v_i32);
+}
+
+static inline void store_q8(uint8_t *p, v_i32 v, uint8_t xor_mask) {
+    v_u8 out = __builtin_convertvector(v, v_u8) ^ xor_mask;
+    memcpy(p, &out, sizeof(out));
+}
+
+// Lane-wise tensor_ops_sat_rounding_doubling_high_mul() for the non-negative
+// multipliers produced by tensor_ops_quantize_ratio(). Working on |a| keeps the
+// product an unsigned 32x32->64 multiply, which every ISA here has natively;
+// the saturating case (both operands INT_MIN) cannot occur with b >= 0.
+static inline v_i32 vec_sat_rounding_doubling_high_mul(v_i32 a, int32_t b) {
+    v_i32 negative = a < 0;
+    v_u32 magnitude = (v_u32)((a ^ negative) - negative);
+    v_u64 product = __builtin_convertvector(magnitude, v_u64) * (uint64_t)(uint32_t)b;
+    // Nudge by 2^30, minus one for negative products so the division by 2^31
+    // rounds toward zero exactly like the scalar version
+    v_u64 nudge = (1ull << 30) + (v_u64)__builtin_convertvector(negative, v_i64);
+    v_i32 quotient = (v_i32)__builtin_convertvector((product + nudge) >> 31, v_u32);
+
+    return (quotient ^ negative) - negative;
+}
+
+// Lane-wise tensor_ops_rounding_divide_by_pot()
+static inline v_i32 vec_rounding_divide_by_pot(v_i32 x, int exponent) {
+    int32_t mask;
+    v_i32 remainder;
+    v_i32 threshold;
+
+    if (exponent <= 0) {
+        return x;
+    }
+    if (exponent > 31) {
+        return x & 0;
+    }
+    mask = (int32_t)((1ll << exponent) - 1);
+    remainder = x & mask;
+    // Comparisons yield -1 for true lanes
+    threshold = (mask >> 1) - (x < 0);
+    return (x >> exponent) - (remainder > threshold);
+}
+
+static inline v_i32 vec_multiply_by_quantized_multiplier(v_i32 x, const struct quant_multiplier *qm) {
+    int left_shift = qm->shift > 0 ? qm->shift : 0;
+    int right_shift = qm->shift > 0 ? 0 : -qm->shift;
+
+    return vec_rounding_divide_by_pot(
+        vec_sat_rounding_doubling_high_mul(x * (1 << left_shift), qm->multiplier),
+        right_shift);
+}
+
+static inline v_i32 vec_clamp(v_i32 v, int32_t lo, int32_t hi) {
+    v_i32 below = v < lo;
+    v_i32 above;
+
+    v = (v & ~below) | (lo & below);
+    above = v > hi;
+    return (v & ~above) | (hi & above);
+}
+
+static inline v_i32 vec_requantize_output(v_i32 raw, const struct qelementwise_params *params) {
+    raw = vec_multiply_by_quantized_multiplier(raw, &params->output_multiplier) + params->output_offset;
+    return vec_clamp(raw, params->act_min, params->act_max);
+}
+
+static inline v_i32 vec_rescale_input(const uint8_t *p, uint8_t xor_mask, int32_t offset, int left_shift,
+                                      const struct quant_multiplier *qm) {
+    return vec_multiply_by_quantized_multiplier((load_q8(p, xor_mask) + offset) * (1 << left_shift), qm);
+}
+
+static void SIMD_FN(add_q8)(const struct qelementwise_params *params, size_t size,
+                            const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    size_t i = 0;
+
+    for (; i + SIMD_LANES <= size; i += SIMD_LANES) {
+        v_i32 a = vec_rescale_input(input1 + i, params->input1_xor, params->input1_offset,
+                                    params->left_shift, &params->input1_multiplier);
+        v_i32 b = vec_rescale_input(input2 + i, params->input2_xor, params->input2_offset,
+                                    params->left_shift, &params->input2_multiplier);
+        store_q8(output + i, vec_requantize_output(a + b, params), params->output_xor);
+    }
+    tensor_ops_add_q8_scalar(params, size - i, input1 + i, input2 + i, output + i);
+}
+
+static void SIMD_FN(sub_q8)(const struct qelementwise_params *params, size_t size,
+                            const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    size_t i = 0;
+
+    for (; i + SIMD_LANES <= size; i += SIMD_LANES) {
+        v_i32 a = vec_rescale_input(input1 + i, params->input1_xor, params->input1_offset,
+                                    params->left_shift, &params->input1_multiplier);
+        v_i32 b = vec_rescale_input(input2 + i, params->input2_xor, params->input2_offset,
+                                    params->left_shift, &params->input2_multiplier);
+        store_q8(output + i, vec_requantize_output(a - b, params), params->output_xor);
+    }
+    tensor_ops_sub_q8_scalar(params, size - i, input1 + i, input2 + i, output + i);
+}
+
+static void SIMD_FN(mul_q8)(const struct qelementwise_params *params, size_t size,
+                            const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    size_t i = 0;
+
+    for (; i + SIMD_LANES <= size; i += SIMD_LANES) {
+        v_i32 a = load_q8(input1 + i, params->input1_xor) + params->input1_offset;
+        v_i32 b = load_q8(input2 + i, params->input2_xor) + params->input2_offset;
+        store_q8(output + i, vec_requantize_output(a * b, params), params->output_xor);
+    }
+    tensor_ops_mul_q8_scalar(params, size - i, input1 + i, input2 + i, output + i);
+}
+
+#define SIMD_KERNEL_TABLE(isa_name)         \
+    {                                       \
+        .name = isa_name,                   \
+        .add_f32 = SIMD_FN(add_f32),        \
+        .sub_f32 = SIMD_FN(sub_f32),        \
+        .mul_f32 = SIMD_FN(mul_f32),        \
+        .div_f32 = SIMD_FN(div_f32),        \
+        .max_f32 = SIMD_FN(max_f32),        \
+        .relu_f32 = SIMD_FN(relu_f32),      \
+        .add_q8 = SIMD_FN(add_q8),          \
+        .sub_q8 = SIMD_FN(sub_q8),          \
+        .mul_q8 = SIMD_FN(mul_q8),          \
+    }
+
+#endif // TENSOR_OPS_SIMD_IMPL_H
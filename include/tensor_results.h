@@ -0,0 +1,33 @@
+#ifndef TENSOR_RESULTS_H
+#define TENSOR_RESULTS_H
+
+#include <linux/types.h>
+
+// Binary framing of output tensors, shared with userspace. The interpreter
+// devices return it from read() after GET_RESULTS: a tensor_results_header,
+// then for each output a tensor_result_header followed by its raw data. Data
+// is padded to TENSOR_RESULTS_ALIGN bytes, so every header in the stream is
+// aligned. Integers are in native byte order.
+
+#define TENSOR_RESULTS_MAGIC 0x524e5354     // "TSNR"
+#define TENSOR_RESULTS_VERSION 1
+#define TENSOR_RESULTS_ALIGN 8
+#define TENSOR_RESULTS_MAX_DIMS 4
+
+struct tensor_results_header {
+    __u32 magic;
+    __u16 version;
+    __u16 num_tensors;
+    __u64 total_bytes;      // of the whole stream, this header included
+};
+
+struct tensor_result_header {
+    __u32 type;             // TensorType of the TFLite schema
+    __u32 rank;
+    __s32 dims[TENSOR_RESULTS_MAX_DIMS];
+    __u32 scale_bits;       // IEEE-754 bits of the scale; 1.0 if unquantized
+    __s32 zero_point;       // real value = scale * (q - zero_point)
+    __u64 bytes;            // of data, without padding
+};
+
+#endif // TENSOR_RESULTS_H
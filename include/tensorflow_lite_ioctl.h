@@ -0,0 +1,188 @@
+#ifndef TENSORFLOW_LITE_IOCTL_H
+#define TENSORFLOW_LITE_IOCTL_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+// Binary command interface of /dev/tensorflow_lite_kernel_interpreter, shared
+// with userspace. Every struct has a fixed layout; reserved fields must be
+// zero. Incompatible changes bump TFLITE_IOC_VERSION and, as the struct sizes
+// are encoded in the command numbers, also change the commands.
+//
+// A session (one open file) is bound to one model at a time: LOAD binds the
+// model it loads, and EXECUTE and RUN bind the model they name. SET_INPUT and
+// GET_OUTPUT address the input and output tensors of the bound model, which
+// belong to the session, so concurrent sessions never share tensors.
+//
+// The tensors can also be used in place: mmap() of the device maps the bound
+// model's tensor arena of arena_bytes, where each tensor is at its offset.
+// Inputs written there are used by the next EXECUTE, and outputs appear there
+// once it returns. While the arena is mapped the session cannot be bound to
+// another model.
+
+#define TFLITE_IOC_VERSION 1
+#define TFLITE_IOC_MAGIC 'T'
+
+#define TFLITE_MAX_DIMS 4
+
+// Tensor types; the values are those of TensorType in the TFLite schema
+#define TFLITE_TYPE_FLOAT32 0
+#define TFLITE_TYPE_INT32 2
+#define TFLITE_TYPE_UINT8 3
+#define TFLITE_TYPE_INT64 4
+#define TFLITE_TYPE_INT16 7
+#define TFLITE_TYPE_INT8 9
+
+// Offset of a tensor that is part of the model rather than the arena
+#define TFLITE_NO_OFFSET (~(__u64)0)
+
+struct tflite_ioc_load {
+    __u64 path;             // in: user pointer to a NUL-terminated path
+    __s32 handle;           // out
+    __u32 reserved;
+};
+
+// One input or output tensor. Quantized values are scale * (q - zero_point).
+struct tflite_tensor_info {
+    __u32 type;             // TFLITE_TYPE_*
+    __u32 rank;
+    __s32 dims[TFLITE_MAX_DIMS];
+    __u32 scale_bits;       // IEEE-754 bits of the scale; 1.0 for float tensors
+    __s32 zero_point;
+    __u64 bytes;
+    __u64 offset;           // in the mmap of the arena, or TFLITE_NO_OFFSET
+};
+
+struct tflite_ioc_metadata {
+    __s32 handle;           // in
+    __u32 capacity;         // in: entries available at tensors
+    __u64 tensors;          // in: user pointer to tflite_tensor_info, inputs then outputs
+    __u32 num_inputs;       // out
+    __u32 num_outputs;      // out
+    __u64 arena_bytes;      // out: size of the tensor arena of a session
+};
+
+// Copies one tensor of the bound model in (SET_INPUT) or out (GET_OUTPUT).
+// bytes must be the size of the tensor.
+struct tflite_ioc_tensor {
+    __u32 index;
+    __u32 reserved;
+    __u64 data;             // user pointer
+    __u64 bytes;
+};
+
+// With TFLITE_EXECUTE_ASYNC the model is only queued. Until it completes,
+// commands using the session's tensors or binding fail with -EBUSY; the
+// device fd then polls readable, the registered eventfd (SET_EVENTFD) is
+// signalled, and GET_COMPLETION returns the result.
+#define TFLITE_EXECUTE_ASYNC (1U << 0)
+
+struct tflite_ioc_execute {
+    __s32 handle;           // in
+    __u32 flags;            // in: TFLITE_EXECUTE_*
+};
+
+// A whole inference round trip: bind, copy in the inputs, execute and copy
+// out the outputs in one call
+struct tflite_ioc_run {
+    __s32 handle;           // in
+    __u32 flags;            // in: must be zero
+    __u32 num_inputs;       // in: entries at inputs
+    __u32 num_outputs;      // in: entries at outputs
+    __u64 inputs;           // in: user pointer to tflite_ioc_tensor
+    __u64 outputs;          // in: user pointer to tflite_ioc_tensor
+};
+
+// Submission and completion rings, set up once per session with SETUP_RINGS
+// and mapped at TFLITE_RING_MMAP_OFFSET. Clients queue many requests in the
+// submission queue (SQ) and reap their results from the completion queue
+// (CQ) without a system call per request. Each request names a model and the
+// offsets of its tensors in the data area of the mapping; inputs are read
+// from there and outputs written back before the completion is posted.
+//
+// Userspace writes sq_tail and cq_head, the kernel sq_head, cq_tail and
+// flags. Indices run freely and are masked into the rings; publish entries
+// before their tail, with release ordering, and read tails with acquire.
+//
+// Queued requests are run by RING_ENTER, which returns how many it ran, or,
+// with TFLITE_RING_SQPOLL, by a kernel thread that polls the SQ and sleeps
+// after sq_idle_ms without work. It then sets TFLITE_RING_NEED_WAKEUP; a
+// client seeing the flag after advancing sq_tail (with a full barrier in
+// between) calls RING_ENTER to wake it. Requests wait while the CQ is full.
+// With TFLITE_RING_ASYNC, RING_ENTER hands the queued requests to a kernel
+// worker and returns at once. The device fd polls readable while the CQ has
+// entries, and completions signal the registered eventfd.
+
+#define TFLITE_RING_MMAP_OFFSET 0x40000000ULL
+#define TFLITE_RING_MAX_ENTRIES 4096
+#define TFLITE_RING_MAX_TENSORS 4
+#define TFLITE_RING_MAX_IDLE_MS 10000       // longest sq_idle_ms
+
+#define TFLITE_RING_SQPOLL (1U << 0)        // tflite_ioc_rings.flags
+#define TFLITE_RING_ASYNC (1U << 1)         // RING_ENTER queues the requests
+#define TFLITE_RING_NEED_WAKEUP (1U << 0)   // tflite_ring_header.flags
+
+struct tflite_ring_header {
+    __u32 sq_head;
+    __u32 sq_tail;
+    __u32 cq_head;
+    __u32 cq_tail;
+    __u32 sq_mask;
+    __u32 cq_mask;
+    __u32 flags;
+    __u32 reserved;
+};
+
+struct tflite_sqe {
+    __u64 user_data;        // returned in the completion
+    __s32 handle;
+    __u32 flags;            // must be zero
+    __u32 num_inputs;       // all inputs of the model
+    __u32 num_outputs;      // the first num_outputs outputs are written
+    __u64 inputs[TFLITE_RING_MAX_TENSORS];  // offsets in the data area
+    __u64 outputs[TFLITE_RING_MAX_TENSORS];
+};
+
+struct tflite_cqe {
+    __u64 user_data;
+    __s32 result;           // 0 or a negative errno
+    __u32 flags;
+};
+
+struct tflite_ioc_rings {
+    __u32 sq_entries;       // in: power of two, at most TFLITE_RING_MAX_ENTRIES
+    __u32 cq_entries;       // in: power of two, at least sq_entries
+    __u64 data_bytes;       // in: size of the data area
+    __u32 flags;            // in: TFLITE_RING_*
+    __u32 sq_idle_ms;       // in: polling time before the SQPOLL thread sleeps, at most TFLITE_RING_MAX_IDLE_MS
+    __u64 sq_offset;        // out: offsets in the mapping
+    __u64 cq_offset;        // out
+    __u64 data_offset;      // out
+    __u64 ring_bytes;       // out: size of the mapping
+};
+
+// io_uring passthrough: an IORING_OP_URING_CMD SQE on the device fd with
+// cmd_op set to one of the TFLITE_IOC_* commands and this struct in its
+// command area runs the command as if by ioctl(fd, cmd_op, arg), and posts
+// its return value as the CQE result.
+struct tflite_uring_cmd {
+    __u64 arg;              // the ioctl argument, a user pointer or zero
+};
+
+#define TFLITE_IOC_GET_VERSION _IOR(TFLITE_IOC_MAGIC, 0x00, __u32)
+#define TFLITE_IOC_LOAD _IOWR(TFLITE_IOC_MAGIC, 0x01, struct tflite_ioc_load)
+#define TFLITE_IOC_UNLOAD _IOW(TFLITE_IOC_MAGIC, 0x02, __s32)
+#define TFLITE_IOC_QUERY_METADATA _IOWR(TFLITE_IOC_MAGIC, 0x03, struct tflite_ioc_metadata)
+#define TFLITE_IOC_SET_INPUT _IOW(TFLITE_IOC_MAGIC, 0x04, struct tflite_ioc_tensor)
+#define TFLITE_IOC_EXECUTE _IOW(TFLITE_IOC_MAGIC, 0x05, struct tflite_ioc_execute)
+#define TFLITE_IOC_GET_OUTPUT _IOW(TFLITE_IOC_MAGIC, 0x06, struct tflite_ioc_tensor)
+#define TFLITE_IOC_RUN _IOW(TFLITE_IOC_MAGIC, 0x07, struct tflite_ioc_run)
+#define TFLITE_IOC_SETUP_RINGS _IOWR(TFLITE_IOC_MAGIC, 0x08, struct tflite_ioc_rings)
+#define TFLITE_IOC_RING_ENTER _IO(TFLITE_IOC_MAGIC, 0x09)
+// SET_EVENTFD takes an eventfd to signal on completions, or -1. GET_COMPLETION
+// fails with -EAGAIN while an asynchronous EXECUTE runs and with -ENOENT when
+// there is no result to collect.
+#define TFLITE_IOC_SET_EVENTFD _IOW(TFLITE_IOC_MAGIC, 0x0a, __s32)
+#define TFLITE_IOC_GET_COMPLETION _IOR(TFLITE_IOC_MAGIC, 0x0b, __s32)
+
+#endif // TENSORFLOW_LITE_IOCTL_H
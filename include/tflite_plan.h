@@ -0,0 +1,85 @@
+#ifndef TFLITE_PLAN_H
+#define TFLITE_PLAN_H
+
+#include <linux/types.h>
+#include "tensor_ops.h"
+
+#define TFLITE_PLAN_MAX_INPUTS 3
+
+// Location of an operator input or output. Constant tensors are resolved to a
+// pointer into the model at prepare time; activations are an offset into the
+// arena the plan is executed with, so one plan can run against many arenas.
+struct tflite_plan_operand {
+    int tensor_index;           // -1 for an omitted optional input
+    int type;                   // tflite::TensorType
+    uint32_t scale_bits;        // quantization scale as float bits, 1.0 if unquantized
+    int32_t zero_point;         // as stored in the model
+    const uint8_t *constant;
+    size_t arena_offset;
+    size_t bytes;
+    int rank;
+    int dims[4];                // NHWC, padded with leading ones
+};
+
+struct tflite_plan_entry;
+typedef int (*tflite_kernel_fn)(const struct tflite_plan_entry *entry, uint8_t *arena);
+
+// One resolved operator: everything the kernel needs, with no flatbuffer access
+struct tflite_plan_entry {
+    tflite_kernel_fn kernel;
+    int opcode;
+    int num_inputs;
+    struct tflite_plan_operand inputs[TFLITE_PLAN_MAX_INPUTS];
+    struct tflite_plan_operand output;
+    size_t scratch_offset;      // per-operator scratch space in the arena
+    size_t scratch_bytes;
+    union {
+        struct qconv_params conv;
+        struct fconv_params fconv;
+        struct qpool_params pool;
+        struct qelementwise_params elementwise;
+        struct qfc_params fully_connected;
+        const struct qsoftmax_params *softmax;
+    } params;
+    struct broadcast_params broadcast;  // binary elementwise operators only
+    void *owned_data;           // per-entry allocation released with the plan (kvfree)
+};
+
+struct tflite_plan {
+    int num_entries;
+    struct tflite_plan_entry *entries;
+    size_t arena_size;
+    int num_inputs;
+    struct tflite_plan_operand *inputs;
+    int num_outputs;
+    struct tflite_plan_operand *outputs;
+};
+
+static inline const uint8_t *tflite_input_data(const struct tflite_plan_operand *operand, uint8_t *arena) {
+    return operand->constant ? operand->constant : arena + operand->arena_offset;
+}
+
+static inline uint8_t *tflite_output_data(const struct tflite_plan_operand *operand, uint8_t *arena) {
+    return arena + operand->arena_offset;
+}
+
+static inline void *tflite_scratch_data(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    return arena + entry->scratch_offset;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Exported by tflite_flatbuffer_parser.c for the interpreter devices.
+// tflite_plan_create() verifies and prepares a model and returns an ERR_PTR
+// on failure. The model data must outlive the plan, which points into it.
+struct tflite_plan *tflite_plan_create(const void *model_data, size_t model_size);
+void tflite_plan_destroy(struct tflite_plan *plan);
+int tflite_plan_invoke(const struct tflite_plan *plan, uint8_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TFLITE_PLAN_H
@@ -0,0 +1,177 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tflite
+
+#if !defined(TFLITE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define TFLITE_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/smp.h>
+#include "tflite_plan.h"
+
+// Tracepoints of model loading and execution, for ftrace, perf and bpftrace
+// (events/tflite/ in tracefs). They are defined in tensor_ops.ko
+// (tensor_ops_trace.c) and used by the modules depending on it; disabled,
+// each costs a patched-out branch.
+
+// Queues whose requests are traced
+#define TFLITE_TRACE_QUEUE_SQ 0     // submission ring of a session
+#define TFLITE_TRACE_QUEUE_CQ 1     // completion ring of a session
+
+#define show_tflite_queue(kind) \
+    __print_symbolic(kind, \
+                     { TFLITE_TRACE_QUEUE_SQ, "sq" }, \
+                     { TFLITE_TRACE_QUEUE_CQ, "cq" })
+
+TRACE_EVENT(tflite_model_load_begin,
+    TP_PROTO(const char *path),
+    TP_ARGS(path),
+    TP_STRUCT__entry(
+        __string(path, path)
+    ),
+    TP_fast_assign(
+        __assign_str(path);
+    ),
+    TP_printk("path=%s", __get_str(path))
+);
+
+// handle is negative on failure. A model already loaded reports the sizes of
+// the loaded copy.
+TRACE_EVENT(tflite_model_load_end,
+    TP_PROTO(const char *path, int handle, size_t model_bytes, size_t arena_bytes),
+    TP_ARGS(path, handle, model_bytes, arena_bytes),
+    TP_STRUCT__entry(
+        __string(path, path)
+        __field(int, handle)
+        __field(size_t, model_bytes)
+        __field(size_t, arena_bytes)
+    ),
+    TP_fast_assign(
+        __assign_str(path);
+        __entry->handle = handle;
+        __entry->model_bytes = model_bytes;
+        __entry->arena_bytes = arena_bytes;
+    ),
+    TP_printk("path=%s handle=%d model_bytes=%zu arena_bytes=%zu",
+              __get_str(path), __entry->handle, __entry->model_bytes, __entry->arena_bytes)
+);
+
+TRACE_EVENT(tflite_prepare_begin,
+    TP_PROTO(size_t model_bytes),
+    TP_ARGS(model_bytes),
+    TP_STRUCT__entry(
+        __field(size_t, model_bytes)
+    ),
+    TP_fast_assign(
+        __entry->model_bytes = model_bytes;
+    ),
+    TP_printk("model_bytes=%zu", __entry->model_bytes)
+);
+
+TRACE_EVENT(tflite_prepare_end,
+    TP_PROTO(int num_ops, size_t arena_bytes, int ret),
+    TP_ARGS(num_ops, arena_bytes, ret),
+    TP_STRUCT__entry(
+        __field(int, num_ops)
+        __field(size_t, arena_bytes)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->num_ops = num_ops;
+        __entry->arena_bytes = arena_bytes;
+        __entry->ret = ret;
+    ),
+    TP_printk("num_ops=%d arena_bytes=%zu ret=%d", __entry->num_ops, __entry->arena_bytes, __entry->ret)
+);
+
+// The arena tells concurrent invocations of one plan apart
+TRACE_EVENT(tflite_op_begin,
+    TP_PROTO(const struct tflite_plan_entry *entry, int index, const uint8_t *arena),
+    TP_ARGS(entry, index, arena),
+    TP_STRUCT__entry(
+        __field(const void *, arena)
+        __field(int, index)
+        __field(int, opcode)
+        __field(int, cpu)
+        __field(size_t, input_bytes)
+        __field(size_t, output_bytes)
+    ),
+    TP_fast_assign(
+        int i;
+
+        __entry->arena = arena;
+        __entry->index = index;
+        __entry->opcode = entry->opcode;
+        __entry->cpu = raw_smp_processor_id();
+        __entry->input_bytes = 0;
+        for (i = 0; i < entry->num_inputs; i++) {
+            if (entry->inputs[i].tensor_index >= 0) {
+                __entry->input_bytes += entry->inputs[i].bytes;
+            }
+        }
+        __entry->output_bytes = entry->output.bytes;
+    ),
+    TP_printk("arena=%p op=%d opcode=%d cpu=%d input_bytes=%zu output_bytes=%zu",
+              __entry->arena, __entry->index, __entry->opcode, __entry->cpu,
+              __entry->input_bytes, __entry->output_bytes)
+);
+
+TRACE_EVENT(tflite_op_end,
+    TP_PROTO(const struct tflite_plan_entry *entry, int index, const uint8_t *arena, int ret),
+    TP_ARGS(entry, index, arena, ret),
+    TP_STRUCT__entry(
+        __field(const void *, arena)
+        __field(int, index)
+        __field(int, opcode)
+        __field(int, cpu)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->arena = arena;
+        __entry->index = index;
+        __entry->opcode = entry->opcode;
+        __entry->cpu = raw_smp_processor_id();
+        __entry->ret = ret;
+    ),
+    TP_printk("arena=%p op=%d opcode=%d cpu=%d ret=%d",
+              __entry->arena, __entry->index, __entry->opcode, __entry->cpu, __entry->ret)
+);
+
+// id identifies the request within its queue; depth counts the requests
+// queued once the event has happened
+DECLARE_EVENT_CLASS(tflite_queue,
+    TP_PROTO(const void *queue, int kind, u64 id, unsigned int depth),
+    TP_ARGS(queue, kind, id, depth),
+    TP_STRUCT__entry(
+        __field(const void *, queue)
+        __field(int, kind)
+        __field(u64, id)
+        __field(unsigned int, depth)
+    ),
+    TP_fast_assign(
+        __entry->queue = queue;
+        __entry->kind = kind;
+        __entry->id = id;
+        __entry->depth = depth;
+    ),
+    TP_printk("queue=%p kind=%s id=%llu depth=%u",
+              __entry->queue, show_tflite_queue(__entry->kind), __entry->id, __entry->depth)
+);
+
+DEFINE_EVENT(tflite_queue, tflite_queue_enqueue,
+    TP_PROTO(const void *queue, int kind, u64 id, unsigned int depth),
+    TP_ARGS(queue, kind, id, depth)
+);
+
+DEFINE_EVENT(tflite_queue, tflite_queue_dequeue,
+    TP_PROTO(const void *queue, int kind, u64 id, unsigned int depth),
+    TP_ARGS(queue, kind, id, depth)
+);
+
+#endif // TFLITE_TRACE_H
+
+// Out of tree, define_trace.h finds this header on the include path
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tflite_trace
+#include <trace/define_trace.h>
@@ -29,16 +29,14 @@ static int dev_release(struct inode *inodep, struct file *filep) {
 }
 
 static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *offset) {
-    int error_count = 0;
-    error_count = copy_to_user(buffer, kernel_buffer, len);
+    ssize_t ret = simple_read_from_buffer(buffer, len, offset, kernel_buffer, strnlen(kernel_buffer, 1024));
 
-    if (error_count == 0) {
-        printk(KERN_INFO "FlaxDevice: Sent %zu characters to the user\n", len);
-        return 0;
+    if (ret >= 0) {
+        printk(KERN_INFO "FlaxDevice: Sent %zd characters to the user\n", ret);
     } else {
-        printk(KERN_INFO "FlaxDevice: Failed to send %d characters to the user\n", error_count);
-        return -EFAULT;
+        printk(KERN_INFO "FlaxDevice: Failed to send characters to the user\n");
     }
+    return ret;
 }
 
 static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset) {
@@ -4,65 +4,44 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
-#include <linux/vmalloc.h>
+#include <linux/err.h>
+#include "tensor_ops.h"
 
 #define MODEL_PATH "/path/to/tensorflow/model"
 
 // Structure to represent the internal state of a module
 struct module_internal_state {
-    void *model_data;
+    struct model_mapping *mapping;
+    const void *model_data;
     size_t model_size;
 };
 
+static struct module_internal_state *state;
+
 // Function to initialize the module
 static int __init kernel_module_init(void) {
     printk(KERN_INFO "Initializing Kernel Module\n");
 
-    // Load the TensorFlow model from the specified path
-    struct file *model_file;
-    mm_segment_t old_fs;
-    loff_t pos = 0;
-    struct module_internal_state *state;
-
-    old_fs = get_fs();
-    set_fs(KERNEL_DS);
-
-    model_file = filp_open(MODEL_PATH, O_RDONLY, 0);
-    if (IS_ERR(model_file)) {
-        printk(KERN_ERR "Failed to open TensorFlow model file\n");
-        set_fs(old_fs);
-        return PTR_ERR(model_file);
-    }
+    // Map the TensorFlow model at the specified path from the page cache;
+    // the weights are used in place rather than copied
+    struct model_mapping *mapping;
 
     state = kmalloc(sizeof(struct module_internal_state), GFP_KERNEL);
     if (!state) {
         printk(KERN_ERR "Failed to allocate memory for module state\n");
-        filp_close(model_file, NULL);
-        set_fs(old_fs);
         return -ENOMEM;
     }
 
-    state->model_size = i_size_read(file_inode(model_file));
-    state->model_data = vmalloc(state->model_size);
-    if (!state->model_data) {
-        printk(KERN_ERR "Failed to allocate memory for TensorFlow model\n");
+    mapping = tensor_ops_model_map(MODEL_PATH);
+    if (IS_ERR(mapping)) {
+        printk(KERN_ERR "Failed to map TensorFlow model file\n");
         kfree(state);
-        filp_close(model_file, NULL);
-        set_fs(old_fs);
-        return -ENOMEM;
+        state = NULL;
+        return PTR_ERR(mapping);
     }
-
-    if (kernel_read(model_file, state->model_data, state->model_size, &pos) != state->model_size) {
-        printk(KERN_ERR "Failed to read TensorFlow model file\n");
-        vfree(state->model_data);
-        kfree(state);
-        filp_close(model_file, NULL);
-        set_fs(old_fs);
-        return -EIO;
-    }
-
-    filp_close(model_file, NULL);
-    set_fs(old_fs);
+    state->mapping = mapping;
+    state->model_data = mapping->data;
+    state->model_size = mapping->size;
 
     // TODO: Implement TensorFlow model execution using custom code
     // The custom execution engine should interpret and run TensorFlow models directly in kernel space
@@ -76,8 +55,9 @@ static int __init kernel_module_init(void) {
 static void __exit kernel_module_exit(void) {
     printk(KERN_INFO "Exiting Kernel Module\n");
 
-    // TODO: Clean up resources allocated for TensorFlow model execution
-    // Ensure proper memory management and cleanup routines for the loaded models
+    // Release the mapped model
+    tensor_ops_model_unmap(state->mapping);
+    kfree(state);
 
     printk(KERN_INFO "Kernel Module Exited\n");
 }
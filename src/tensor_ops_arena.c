@@ -0,0 +1,90 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include "tensor_ops.h"
+
+static int compare_by_size_desc(const void *a, const void *b, const void *priv) {
+    const struct arena_allocation *allocations = (const struct arena_allocation *)priv;
+    const struct arena_allocation *lhs = &allocations[*(const int *)a];
+    const struct arena_allocation *rhs = &allocations[*(const int *)b];
+
+    if (lhs->size != rhs->size) {
+        return lhs->size > rhs->size ? -1 : 1;
+    }
+    // Keep the order deterministic for equally sized tensors
+    return lhs->first_use - rhs->first_use;
+}
+
+static bool lifetimes_overlap(const struct arena_allocation *a, const struct arena_allocation *b) {
+    return !(a->last_use < b->first_use || b->last_use < a->first_use);
+}
+
+// Greedy-by-size offset assignment: tensors are placed largest first at the
+// lowest offset that does not collide with any already placed tensor whose
+// lifetime overlaps. Tensors with a zero size are left out of the arena.
+int tensor_ops_plan_arena(struct arena_allocation *allocations, int count,
+                          size_t alignment, size_t *arena_size) {
+    int *order;
+    int *placed;
+    int num_placed = 0;
+    size_t total = 0;
+    int i, j;
+
+    if (alignment == 0 || (alignment & (alignment - 1))) {
+        return -EINVAL;
+    }
+
+    order = kmalloc_array(count, sizeof(*order), GFP_KERNEL);
+    placed = kmalloc_array(count, sizeof(*placed), GFP_KERNEL);
+    if (!order || !placed) {
+        kfree(order);
+        kfree(placed);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < count; i++) {
+        order[i] = i;
+        allocations[i].offset = 0;
+    }
+    sort_r(order, count, sizeof(*order), compare_by_size_desc, NULL, allocations);
+
+    for (i = 0; i < count; i++) {
+        struct arena_allocation *current_alloc = &allocations[order[i]];
+        size_t size = ALIGN(current_alloc->size, alignment);
+        size_t candidate = 0;
+        bool moved;
+
+        if (current_alloc->size == 0) {
+            continue;
+        }
+
+        // Bump the candidate past every conflicting tensor until it fits
+        do {
+            moved = false;
+            for (j = 0; j < num_placed; j++) {
+                const struct arena_allocation *other = &allocations[placed[j]];
+                size_t other_end = other->offset + ALIGN(other->size, alignment);
+
+                if (!lifetimes_overlap(current_alloc, other)) {
+                    continue;
+                }
+                if (candidate < other_end && other->offset < candidate + size) {
+                    candidate = other_end;
+                    moved = true;
+                }
+            }
+        } while (moved);
+
+        current_alloc->offset = candidate;
+        placed[num_placed++] = order[i];
+        total = max(total, candidate + size);
+    }
+
+    kfree(order);
+    kfree(placed);
+    *arena_size = total;
+    return 0;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_plan_arena);
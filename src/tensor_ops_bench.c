@@ -0,0 +1,170 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include "tensor_ops_simd.h"
+
+// Microbenchmark of the elementwise kernel tables, run at module load with
+// benchmark=1. Every supported table is timed on the same data so the vector
+// variants can be compared against the scalar one.
+
+#define BENCH_ELEMENTS (64 * 1024)
+#define BENCH_ITERATIONS 200
+#define BENCH_MAX_VARIANTS 4
+
+enum bench_op {
+    BENCH_ADD_F32,
+    BENCH_MUL_F32,
+    BENCH_DIV_F32,
+    BENCH_RELU_F32,
+    BENCH_ADD_Q8,
+    BENCH_MUL_Q8,
+    BENCH_NUM_OPS,
+};
+
+static const char *const bench_op_names[BENCH_NUM_OPS] = {
+    "add_f32", "mul_f32", "div_f32", "relu_f32", "add_q8", "mul_q8",
+};
+
+struct bench_buffers {
+    float *input1_f32;
+    float *input2_f32;
+    float *output_f32;
+    uint8_t *input1_q8;
+    uint8_t *input2_q8;
+    uint8_t *output_q8;
+    struct qelementwise_params add_params;
+    struct qelementwise_params mul_params;
+};
+
+static void run_bench_op(const struct tensor_ops_simd_kernels *kernels, enum bench_op op,
+                         struct bench_buffers *buffers) {
+    switch (op) {
+        case BENCH_ADD_F32:
+            kernels->add_f32(BENCH_ELEMENTS, buffers->input1_f32, buffers->input2_f32, buffers->output_f32);
+            break;
+        case BENCH_MUL_F32:
+            kernels->mul_f32(BENCH_ELEMENTS, buffers->input1_f32, buffers->input2_f32, buffers->output_f32);
+            break;
+        case BENCH_DIV_F32:
+            kernels->div_f32(BENCH_ELEMENTS, buffers->input1_f32, buffers->input2_f32, buffers->output_f32);
+            break;
+        case BENCH_RELU_F32:
+            kernels->relu_f32(BENCH_ELEMENTS, buffers->input1_f32, buffers->output_f32);
+            break;
+        case BENCH_ADD_Q8:
+            kernels->add_q8(&buffers->add_params, BENCH_ELEMENTS, buffers->input1_q8, buffers->input2_q8, buffers->output_q8);
+            break;
+        case BENCH_MUL_Q8:
+            kernels->mul_q8(&buffers->mul_params, BENCH_ELEMENTS, buffers->input1_q8, buffers->input2_q8, buffers->output_q8);
+            break;
+        default:
+            break;
+    }
+}
+
+// Average nanoseconds per call, or 0 if vector registers were unavailable
+static u64 time_bench_op(const struct tensor_ops_simd_kernels *kernels, enum bench_op op,
+                         struct bench_buffers *buffers) {
+    u64 total_ns = 0;
+    int i;
+
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        ktime_t start;
+
+        if (!tensor_ops_simd_begin()) {
+            return 0;
+        }
+        start = ktime_get();
+        run_bench_op(kernels, op, buffers);
+        total_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+        tensor_ops_simd_end();
+        cond_resched();
+    }
+    return div_u64(total_ns, BENCH_ITERATIONS);
+}
+
+static int alloc_bench_buffers(struct bench_buffers *buffers) {
+    uint32_t *bits1;
+    uint32_t *bits2;
+    int i;
+
+    buffers->input1_f32 = vmalloc(BENCH_ELEMENTS * sizeof(float));
+    buffers->input2_f32 = vmalloc(BENCH_ELEMENTS * sizeof(float));
+    buffers->output_f32 = vmalloc(BENCH_ELEMENTS * sizeof(float));
+    buffers->input1_q8 = vmalloc(BENCH_ELEMENTS);
+    buffers->input2_q8 = vmalloc(BENCH_ELEMENTS);
+    buffers->output_q8 = vmalloc(BENCH_ELEMENTS);
+    if (!buffers->input1_f32 || !buffers->input2_f32 || !buffers->output_f32 ||
+        !buffers->input1_q8 || !buffers->input2_q8 || !buffers->output_q8) {
+        return -ENOMEM;
+    }
+
+    // Fill the float inputs through their bit patterns so no FPU state is used
+    // here: values in [-2, -1) and [1, 2), never zero
+    bits1 = (uint32_t *)buffers->input1_f32;
+    bits2 = (uint32_t *)buffers->input2_f32;
+    for (i = 0; i < BENCH_ELEMENTS; i++) {
+        bits1[i] = TENSOR_OPS_FLOAT_ONE_BITS | ((i * 2654435761u) & 0x7fffff) | ((i & 1) << 31);
+        bits2[i] = TENSOR_OPS_FLOAT_ONE_BITS | ((i * 40503u) & 0x7fffff);
+        buffers->input1_q8[i] = (uint8_t)(i * 7);
+        buffers->input2_q8[i] = (uint8_t)(i * 13 + 5);
+    }
+
+    // Scales 0.02, 0.05 and 0.07 with zero points near the middle of the range
+    buffers->add_params.input1_offset = -120;
+    buffers->add_params.input2_offset = -100;
+    buffers->add_params.output_offset = 128;
+    buffers->add_params.act_min = 0;
+    buffers->add_params.act_max = 255;
+    buffers->mul_params = buffers->add_params;
+    if (tensor_ops_add_prepare(0x3ca3d70au, 0x3d4ccccdu, 0x3d8f5c29u, &buffers->add_params) < 0 ||
+        tensor_ops_mul_prepare(0x3ca3d70au, 0x3d4ccccdu, 0x3d8f5c29u, &buffers->mul_params) < 0) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static void free_bench_buffers(struct bench_buffers *buffers) {
+    vfree(buffers->input1_f32);
+    vfree(buffers->input2_f32);
+    vfree(buffers->output_f32);
+    vfree(buffers->input1_q8);
+    vfree(buffers->input2_q8);
+    vfree(buffers->output_q8);
+}
+
+void tensor_ops_simd_benchmark(void) {
+    const struct tensor_ops_simd_kernels *variants[BENCH_MAX_VARIANTS];
+    struct bench_buffers buffers = {};
+    int num_variants;
+    int op, v;
+
+    if (alloc_bench_buffers(&buffers) < 0) {
+        printk(KERN_ALERT "TensorOps: Failed to set up the elementwise benchmark\n");
+        free_bench_buffers(&buffers);
+        return;
+    }
+
+    num_variants = tensor_ops_simd_variants(variants, BENCH_MAX_VARIANTS);
+    for (op = 0; op < BENCH_NUM_OPS; op++) {
+        u64 scalar_ns = 0;
+
+        for (v = 0; v < num_variants; v++) {
+            u64 ns = time_bench_op(variants[v], (enum bench_op)op, &buffers);
+
+            if (v == 0) {
+                scalar_ns = ns;
+            }
+            // Speedup over the scalar kernels, in hundredths
+            printk(KERN_INFO "TensorOps: Benchmark %s n=%d variant=%s avg_ns=%llu speedup=%llu.%02llu\n",
+                   bench_op_names[op], BENCH_ELEMENTS, variants[v]->name, ns,
+                   ns ? div64_u64(scalar_ns, ns) : 0,
+                   ns ? div64_u64(scalar_ns * 100, ns) % 100 : 0);
+        }
+    }
+
+    free_bench_buffers(&buffers);
+}
@@ -0,0 +1,269 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include "tensor_ops.h"
+#include "tensor_ops_simd.h"
+
+// N-d broadcasting for the binary elementwise ops. All shape work happens in
+// tensor_ops_broadcast_prepare(): size-1 output dims are dropped and adjacent
+// dims that broadcast the same way are merged, so same-shape operands become
+// one flat run, scalar-vs-tensor one run against a splatted scalar and
+// row-vs-matrix a single loop over rows. Everything else is a few nested
+// strided loops around contiguous inner runs.
+
+// A broadcast scalar is expanded into at most this many elements of scratch
+#define BROADCAST_SPLAT_ELEMENTS 1024
+
+int tensor_ops_broadcast_prepare(int rank1, const int *dims1, int rank2, const int *dims2,
+                                 int output_rank, const int *output_dims, struct broadcast_params *params) {
+    bool broadcast1[TENSOR_OPS_BROADCAST_MAX_DIMS];
+    bool broadcast2[TENSOR_OPS_BROADCAST_MAX_DIMS];
+    size_t extents[TENSOR_OPS_BROADCAST_MAX_DIMS];
+    size_t stride1 = 1;
+    size_t stride2 = 1;
+    int num_dims = 0;
+    int d, n;
+
+    if (max(rank1, rank2) > output_rank || output_rank > TENSOR_OPS_BROADCAST_MAX_DIMS) {
+        return -EINVAL;
+    }
+
+    // Walk the right-aligned shapes from the outermost dim, dropping size-1
+    // output dims and merging a dim into the previous one when both inputs
+    // broadcast along them in the same way
+    params->output_size = 1;
+    for (d = 0; d < output_rank; d++) {
+        int extent = output_dims[d];
+        int extent1 = d - (output_rank - rank1) >= 0 ? dims1[d - (output_rank - rank1)] : 1;
+        int extent2 = d - (output_rank - rank2) >= 0 ? dims2[d - (output_rank - rank2)] : 1;
+        bool b1 = extent1 != extent;
+        bool b2 = extent2 != extent;
+
+        if (extent <= 0 || (b1 && extent1 != 1) || (b2 && extent2 != 1)) {
+            return -EINVAL;
+        }
+        params->output_size *= extent;
+        if (extent == 1) {
+            continue;
+        }
+        if (num_dims > 0 && broadcast1[num_dims - 1] == b1 && broadcast2[num_dims - 1] == b2) {
+            extents[num_dims - 1] *= extent;
+            continue;
+        }
+        broadcast1[num_dims] = b1;
+        broadcast2[num_dims] = b2;
+        extents[num_dims] = extent;
+        num_dims++;
+    }
+
+    params->num_dims = num_dims;
+    for (n = num_dims - 1; n >= 0; n--) {
+        params->dims[n] = extents[n];
+        params->input1_strides[n] = broadcast1[n] ? 0 : stride1;
+        params->input2_strides[n] = broadcast2[n] ? 0 : stride2;
+        stride1 *= broadcast1[n] ? 1 : extents[n];
+        stride2 *= broadcast2[n] ? 1 : extents[n];
+    }
+    return 0;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_broadcast_prepare);
+
+static inline bool inner_broadcast(const struct broadcast_params *params) {
+    return params->num_dims > 0 && (params->input1_strides[params->num_dims - 1] == 0 ||
+                                     params->input2_strides[params->num_dims - 1] == 0);
+}
+
+static size_t slot_scratch_elements(const struct broadcast_params *params) {
+    if (!inner_broadcast(params)) {
+        return 0;
+    }
+    return min_t(size_t, params->dims[params->num_dims - 1], BROADCAST_SPLAT_ELEMENTS);
+}
+
+// One splat buffer per thread pool slot
+size_t tensor_ops_broadcast_scratch_size(const struct broadcast_params *params, size_t element_size) {
+    return slot_scratch_elements(params) * tensor_ops_parallel_slots() * element_size;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_broadcast_scratch_size);
+
+// Contiguous kernel over one run; the kernel type differs between f32 and q8
+struct broadcast_kernel {
+    void (*f32)(size_t size, const float *input1, const float *input2, float *output);
+    void (*q8)(const struct qelementwise_params *params, size_t size,
+               const uint8_t *input1, const uint8_t *input2, uint8_t *output);
+    const struct qelementwise_params *q8_params;
+    size_t element_size;
+};
+
+static inline void run_kernel(const struct broadcast_kernel *kernel, size_t size,
+                              const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    if (kernel->f32) {
+        kernel->f32(size, (const float *)input1, (const float *)input2, (float *)output);
+    } else {
+        kernel->q8(kernel->q8_params, size, input1, input2, output);
+    }
+}
+
+// One inner run of `size` output elements. An input that is constant along
+// the run is splatted into scratch, so the vector kernels still apply.
+static void run_inner(const struct broadcast_kernel *kernel, size_t size, bool splat1, bool splat2,
+                      const uint8_t *input1, const uint8_t *input2, uint8_t *output, uint8_t *scratch) {
+    const size_t element_size = kernel->element_size;
+    size_t chunk = min_t(size_t, size, BROADCAST_SPLAT_ELEMENTS);
+    size_t offset;
+    size_t i;
+
+    if (!splat1 && !splat2) {
+        run_kernel(kernel, size, input1, input2, output);
+        return;
+    }
+    for (i = 0; i < chunk; i++) {
+        memcpy(scratch + i * element_size, splat1 ? input1 : input2, element_size);
+    }
+    for (offset = 0; offset < size; offset += chunk) {
+        size_t len = min(chunk, size - offset);
+
+        run_kernel(kernel, len,
+                   splat1 ? scratch : input1 + offset * element_size,
+                   splat2 ? scratch : input2 + offset * element_size,
+                   output + offset * element_size);
+    }
+}
+
+struct broadcast_job {
+    const struct broadcast_params *params;
+    const struct broadcast_kernel *kernel;
+    const uint8_t *input1;
+    const uint8_t *input2;
+    uint8_t *output;
+    uint8_t *scratch;
+};
+
+// Output elements [begin, end), which may start and end inside a run
+static void broadcast_range(void *context, size_t begin, size_t end, int slot) {
+    const struct broadcast_job *job = context;
+    const struct broadcast_params *params = job->params;
+    const size_t element_size = job->kernel->element_size;
+    const int inner_dim = params->num_dims - 1;
+    const size_t inner = params->dims[inner_dim];
+    const bool splat1 = params->input1_strides[inner_dim] == 0;
+    const bool splat2 = params->input2_strides[inner_dim] == 0;
+    uint8_t *scratch = job->scratch ? job->scratch + slot_scratch_elements(params) * slot * element_size : NULL;
+    size_t index[TENSOR_OPS_BROADCAST_MAX_DIMS] = {};
+    size_t offset1 = 0;
+    size_t offset2 = 0;
+    size_t position = begin % inner;
+    size_t outer = begin / inner;
+    int d;
+
+    // Odometer position of the first run
+    for (d = inner_dim - 1; d >= 0; d--) {
+        index[d] = outer % params->dims[d];
+        outer /= params->dims[d];
+        offset1 += index[d] * params->input1_strides[d];
+        offset2 += index[d] * params->input2_strides[d];
+    }
+
+    while (begin < end) {
+        size_t len = min(inner - position, end - begin);
+
+        run_inner(job->kernel, len, splat1, splat2,
+                  job->input1 + (offset1 + (splat1 ? 0 : position)) * element_size,
+                  job->input2 + (offset2 + (splat2 ? 0 : position)) * element_size,
+                  job->output + begin * element_size, scratch);
+        begin += len;
+        position = 0;
+
+        // Advance the outer index like an odometer, innermost outer dim first
+        for (d = inner_dim - 1; d >= 0; d--) {
+            offset1 += params->input1_strides[d];
+            offset2 += params->input2_strides[d];
+            if (++index[d] < params->dims[d]) {
+                break;
+            }
+            offset1 -= params->input1_strides[d] * params->dims[d];
+            offset2 -= params->input2_strides[d] * params->dims[d];
+            index[d] = 0;
+        }
+    }
+}
+
+// Large outputs are split into element ranges over the thread pool
+static void broadcast_run(const struct broadcast_params *params, const struct broadcast_kernel *kernel,
+                          unsigned int flags, const uint8_t *input1, const uint8_t *input2,
+                          uint8_t *output, uint8_t *scratch) {
+    struct broadcast_job job = { params, kernel, input1, input2, output, scratch };
+
+    // All dims were size 1
+    if (params->num_dims == 0) {
+        run_kernel(kernel, 1, input1, input2, output);
+        return;
+    }
+    tensor_ops_parallel_for(params->output_size, 1, flags, broadcast_range, &job);
+}
+
+void tensor_ops_broadcast_f32(const struct broadcast_params *params, int op,
+                              const float *input1, const float *input2, float *output, float *scratch) {
+    const struct tensor_ops_simd_kernels *kernels = tensor_ops_simd_active();
+    struct broadcast_kernel kernel = {};
+
+    kernel.element_size = sizeof(float);
+    switch (op) {
+        case TENSOR_OPS_BINARY_ADD:
+            kernel.f32 = kernels->add_f32;
+            break;
+        case TENSOR_OPS_BINARY_SUB:
+            kernel.f32 = kernels->sub_f32;
+            break;
+        case TENSOR_OPS_BINARY_MUL:
+            kernel.f32 = kernels->mul_f32;
+            break;
+        case TENSOR_OPS_BINARY_DIV:
+            kernel.f32 = kernels->div_f32;
+            break;
+        default:
+            return;
+    }
+    broadcast_run(params, &kernel, TENSOR_OPS_PARALLEL_FPU, (const uint8_t *)input1, (const uint8_t *)input2,
+                  (uint8_t *)output, (uint8_t *)scratch);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_broadcast_f32);
+
+// Large quantized ops take one FPU section for all their runs, rather than
+// leaving every run to decide on its own; pool workers then take their own
+void tensor_ops_broadcast_q8(const struct broadcast_params *params, int op,
+                             const struct qelementwise_params *q8_params,
+                             const uint8_t *input1, const uint8_t *input2, uint8_t *output, uint8_t *scratch) {
+    const struct tensor_ops_simd_kernels *kernels = &tensor_ops_scalar_kernels;
+    struct broadcast_kernel kernel = {};
+    bool simd = false;
+
+    if (params->output_size >= TENSOR_OPS_SIMD_Q8_MIN_ELEMENTS && tensor_ops_simd_active() != kernels &&
+        tensor_ops_simd_begin()) {
+        kernels = tensor_ops_simd_active();
+        simd = true;
+    }
+
+    kernel.element_size = 1;
+    kernel.q8_params = q8_params;
+    switch (op) {
+        case TENSOR_OPS_BINARY_ADD:
+            kernel.q8 = kernels->add_q8;
+            break;
+        case TENSOR_OPS_BINARY_SUB:
+            kernel.q8 = kernels->sub_q8;
+            break;
+        case TENSOR_OPS_BINARY_MUL:
+            kernel.q8 = kernels->mul_q8;
+            break;
+    }
+    if (kernel.q8) {
+        broadcast_run(params, &kernel, simd ? TENSOR_OPS_PARALLEL_FPU : 0, input1, input2, output, scratch);
+    }
+
+    if (simd) {
+        tensor_ops_simd_end();
+    }
+}
+EXPORT_SYMBOL_GPL(tensor_ops_broadcast_q8);
@@ -0,0 +1,255 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include "tensor_ops.h"
+#include "tensor_ops_simd.h"
+
+// Algorithm selection for float32 CONV_2D. Winograd F(2x2, 3x3) does 2.25x
+// fewer multiplies than the direct kernel but pays for the input and output
+// transforms on every tile, so whether it wins depends on the channel counts
+// and on the CPU. The cost of both is measured once at module load on a
+// 16x16 layer per channel class; layers are matched to the nearest class.
+
+#define CONV_COST_SIZE 16
+#define CONV_COST_TARGET_MACS (64u << 20)
+#define CONV_COST_MAX_RUNS 100
+
+static const int conv_cost_channels[] = { 8, 32, 128 };
+
+// Winograd time as a percentage of direct time, per channel class. The
+// defaults are only used if the measurement cannot run.
+static unsigned int winograd_cost_percent[ARRAY_SIZE(conv_cost_channels)] = { 110, 70, 55 };
+
+// -1 for automatic selection, otherwise the forced algorithm
+static int forced_algorithm = -1;
+
+size_t tensor_ops_conv2d_f32_packed_size(int algorithm, const int *filter_dims) {
+    const size_t taps = algorithm == TENSOR_OPS_CONV_WINOGRAD ? 16 : (size_t)filter_dims[1] * filter_dims[2];
+
+    return taps * filter_dims[0] * filter_dims[3] * sizeof(float);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_conv2d_f32_packed_size);
+
+// Winograd keeps one transformed input tile and one product tile per slot
+static size_t conv_slot_scratch_floats(int algorithm, const int *filter_dims) {
+    if (algorithm != TENSOR_OPS_CONV_WINOGRAD) {
+        return 0;
+    }
+    return 16 * ((size_t)filter_dims[0] + filter_dims[3]);
+}
+
+size_t tensor_ops_conv2d_f32_scratch_size(int algorithm, const int *filter_dims) {
+    return conv_slot_scratch_floats(algorithm, filter_dims) * tensor_ops_parallel_slots() * sizeof(float);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_conv2d_f32_scratch_size);
+
+size_t tensor_ops_conv2d_f32_rows(int algorithm, const int *output_dims) {
+    const int rows = algorithm == TENSOR_OPS_CONV_WINOGRAD ? DIV_ROUND_UP(output_dims[1], 2) : output_dims[1];
+
+    return (size_t)output_dims[0] * rows;
+}
+
+// Multiply-adds per row, including the tile transforms for Winograd
+static size_t conv_row_cost(int algorithm, const int *filter_dims, const int *output_dims) {
+    const size_t channels = (size_t)filter_dims[0] * filter_dims[3];
+
+    if (algorithm == TENSOR_OPS_CONV_WINOGRAD) {
+        return DIV_ROUND_UP(output_dims[2], 2) * (16 * channels + 32 * ((size_t)filter_dims[0] + filter_dims[3]));
+    }
+    return (size_t)output_dims[2] * filter_dims[1] * filter_dims[2] * channels;
+}
+
+static bool winograd_applicable(const struct fconv_params *params, const int *filter_dims) {
+    return filter_dims[1] == 3 && filter_dims[2] == 3 && params->stride_h == 1 && params->stride_w == 1 &&
+           params->dilation_h == 1 && params->dilation_w == 1;
+}
+
+// Channel class nearest to the layer on a log scale
+static int conv_cost_class(const int *filter_dims) {
+    int log_channels = (ilog2(max(filter_dims[0], 1)) + ilog2(max(filter_dims[3], 1)) + 1) / 2;
+    int best = 0;
+    int i;
+
+    for (i = 1; i < ARRAY_SIZE(conv_cost_channels); i++) {
+        if (abs(ilog2(conv_cost_channels[i]) - log_channels) <
+            abs(ilog2(conv_cost_channels[best]) - log_channels)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+int tensor_ops_conv2d_f32_select(const struct fconv_params *params, const int *filter_dims, const int *output_dims) {
+    u64 output_pixels = (u64)output_dims[1] * output_dims[2];
+    u64 tile_pixels = (u64)DIV_ROUND_UP(output_dims[1], 2) * DIV_ROUND_UP(output_dims[2], 2) * 4;
+
+    if (!winograd_applicable(params, filter_dims) || output_pixels == 0) {
+        return TENSOR_OPS_CONV_DIRECT;
+    }
+    if (forced_algorithm >= 0) {
+        return forced_algorithm;
+    }
+    // Odd output sizes compute partial tiles whose extra outputs are discarded
+    return (u64)winograd_cost_percent[conv_cost_class(filter_dims)] * tile_pixels < 100 * output_pixels ?
+           TENSOR_OPS_CONV_WINOGRAD : TENSOR_OPS_CONV_DIRECT;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_conv2d_f32_select);
+
+int tensor_ops_conv2d_f32_pack_filter(int algorithm, const int *filter_dims, const float *filter, float *packed) {
+    if (!tensor_ops_simd_begin()) {
+        return -EBUSY;
+    }
+    tensor_ops_conv2d_f32_pack_generic(algorithm, filter_dims, filter, packed);
+    tensor_ops_simd_end();
+    return 0;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_conv2d_f32_pack_filter);
+
+struct conv_f32_job {
+    const struct fconv_params *params;
+    const int *input_dims;
+    const float *input;
+    const int *filter_dims;
+    const int *output_dims;
+    float *output;
+    float *scratch;
+};
+
+static void conv2d_f32_rows(void *context, size_t begin, size_t end, int slot) {
+    const struct conv_f32_job *job = context;
+    float *scratch = job->scratch ?
+        job->scratch + conv_slot_scratch_floats(job->params->algorithm, job->filter_dims) * slot : NULL;
+
+    tensor_ops_conv2d_f32_generic(job->params, job->input_dims, job->input, job->filter_dims,
+                                  job->output_dims, job->output, scratch, begin, end);
+}
+
+int tensor_ops_conv2d_f32(const struct fconv_params *params,
+                          const int *input_dims, const float *input,
+                          const int *filter_dims,
+                          const int *output_dims, float *output, float *scratch) {
+    struct conv_f32_job job = { params, input_dims, input, filter_dims, output_dims, output, scratch };
+
+    if (!tensor_ops_simd_begin()) {
+        return -EBUSY;
+    }
+    tensor_ops_parallel_for(tensor_ops_conv2d_f32_rows(params->algorithm, output_dims),
+                            conv_row_cost(params->algorithm, filter_dims, output_dims),
+                            TENSOR_OPS_PARALLEL_FPU, conv2d_f32_rows, &job);
+    tensor_ops_simd_end();
+    return 0;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_conv2d_f32);
+
+// Best-of-N nanoseconds for one algorithm on a channels x channels 3x3 layer
+static u64 time_conv_algorithm(int algorithm, int channels, const float *input, const float *filter,
+                               float *packed, float *output, float *scratch) {
+    const int input_dims[4] = { 1, CONV_COST_SIZE, CONV_COST_SIZE, channels };
+    const int filter_dims[4] = { channels, 3, 3, channels };
+    const int output_dims[4] = { 1, CONV_COST_SIZE, CONV_COST_SIZE, channels };
+    const u32 macs = CONV_COST_SIZE * CONV_COST_SIZE * 9 * channels * channels;
+    const int runs = clamp_t(u32, CONV_COST_TARGET_MACS / macs, 3, CONV_COST_MAX_RUNS);
+    const u32 lowest_bits = TENSOR_OPS_FLOAT_LOWEST_BITS;
+    const u32 max_bits = TENSOR_OPS_FLOAT_MAX_BITS;
+    struct fconv_params params = {};
+    u64 best_ns = U64_MAX;
+    int i;
+
+    params.stride_h = 1;
+    params.stride_w = 1;
+    params.dilation_h = 1;
+    params.dilation_w = 1;
+    params.pad_h = 1;
+    params.pad_w = 1;
+    params.algorithm = algorithm;
+    params.packed_filter = packed;
+    // No clamping; set through the bit patterns as no FPU section is held here
+    memcpy(&params.act_min, &lowest_bits, sizeof(params.act_min));
+    memcpy(&params.act_max, &max_bits, sizeof(params.act_max));
+
+    if (tensor_ops_conv2d_f32_pack_filter(algorithm, filter_dims, filter, packed) < 0) {
+        return 0;
+    }
+    for (i = 0; i < runs; i++) {
+        ktime_t start;
+
+        if (!tensor_ops_simd_begin()) {
+            return 0;
+        }
+        start = ktime_get();
+        // Single-threaded, as the table compares per-core cost
+        tensor_ops_conv2d_f32_generic(&params, input_dims, input, filter_dims, output_dims, output, scratch,
+                                      0, tensor_ops_conv2d_f32_rows(algorithm, output_dims));
+        best_ns = min_t(u64, best_ns, ktime_to_ns(ktime_sub(ktime_get(), start)));
+        tensor_ops_simd_end();
+        cond_resched();
+    }
+    return best_ns;
+}
+
+static void measure_conv_cost(int index) {
+    const int channels = conv_cost_channels[index];
+    const size_t pixels = CONV_COST_SIZE * CONV_COST_SIZE;
+    const int filter_dims[4] = { channels, 3, 3, channels };
+    float *input = vmalloc(pixels * channels * sizeof(float));
+    float *filter = vmalloc(9 * channels * channels * sizeof(float));
+    float *packed = vmalloc(tensor_ops_conv2d_f32_packed_size(TENSOR_OPS_CONV_WINOGRAD, filter_dims));
+    float *output = vmalloc(pixels * channels * sizeof(float));
+    float *scratch = vmalloc(tensor_ops_conv2d_f32_scratch_size(TENSOR_OPS_CONV_WINOGRAD, filter_dims));
+    u64 direct_ns;
+    u64 winograd_ns;
+    size_t i;
+
+    if (input && filter && packed && output && scratch) {
+        // Values in [-2, -1) and [1, 2), filled through their bit patterns
+        for (i = 0; i < pixels * channels; i++) {
+            ((u32 *)input)[i] = TENSOR_OPS_FLOAT_ONE_BITS | ((i * 2654435761u) & 0x7fffff) | ((i & 1) << 31);
+        }
+        for (i = 0; i < 9 * channels * channels; i++) {
+            ((u32 *)filter)[i] = TENSOR_OPS_FLOAT_ONE_BITS | ((i * 40503u) & 0x7fffff) | ((u32)(i % 3 == 0) << 31);
+        }
+        direct_ns = time_conv_algorithm(TENSOR_OPS_CONV_DIRECT, channels, input, filter, packed, output, scratch);
+        winograd_ns = time_conv_algorithm(TENSOR_OPS_CONV_WINOGRAD, channels, input, filter, packed, output, scratch);
+        if (direct_ns && winograd_ns) {
+            winograd_cost_percent[index] = (unsigned int)div64_u64(winograd_ns * 100, direct_ns);
+        }
+        printk(KERN_INFO "TensorOps: 3x3 conv channels=%d direct_ns=%llu winograd_ns=%llu winograd_cost=%u%%\n",
+               channels, direct_ns, winograd_ns, winograd_cost_percent[index]);
+    } else {
+        printk(KERN_ALERT "TensorOps: Failed to allocate buffers for the 3x3 conv cost table\n");
+    }
+
+    vfree(input);
+    vfree(filter);
+    vfree(packed);
+    vfree(output);
+    vfree(scratch);
+}
+
+// Measure the cost table, or force one algorithm for every eligible layer
+int tensor_ops_conv_init(const char *requested) {
+    int i;
+
+    if (requested && strcmp(requested, "direct") == 0) {
+        forced_algorithm = TENSOR_OPS_CONV_DIRECT;
+        return 0;
+    }
+    if (requested && strcmp(requested, "winograd") == 0) {
+        forced_algorithm = TENSOR_OPS_CONV_WINOGRAD;
+        return 0;
+    }
+    if (requested && strcmp(requested, "auto") != 0) {
+        return -EINVAL;
+    }
+
+    forced_algorithm = -1;
+    for (i = 0; i < ARRAY_SIZE(conv_cost_channels); i++) {
+        measure_conv_cost(i);
+    }
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include "tensor_ops.h"
+#include "tensor_ops_simd.h"
+
+// Float32 CONV_2D kernels. Built with FPU flags; tensor_ops_conv.c calls them
+// inside tensor_ops_simd_begin/end.
+//
+// Direct: filters are repacked to HWIO so that for each tap and input channel
+// the weights of all output channels are contiguous. Each output pixel is
+// accumulated in place, so no im2col buffer is needed.
+//
+// Winograd F(2x2, 3x3): filters are transformed once to U = G g G^T and stored
+// as [16][IC][OC]; each 4x4 input tile becomes 16 small IC x OC products and
+// yields a 2x2 output tile, 2.25x fewer multiplies than the direct kernel.
+
+static inline float clamp_f32(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void pack_filter_direct(const int *filter_dims, const float *filter, float *packed) {
+    const int output_channels = filter_dims[0];
+    const int taps = filter_dims[1] * filter_dims[2];
+    const int input_channels = filter_dims[3];
+    int oc, t, ic;
+
+    for (oc = 0; oc < output_channels; oc++) {
+        for (t = 0; t < taps; t++) {
+            for (ic = 0; ic < input_channels; ic++) {
+                packed[((size_t)t * input_channels + ic) * output_channels + oc] =
+                    filter[((size_t)oc * taps + t) * input_channels + ic];
+            }
+        }
+    }
+}
+
+static void pack_filter_winograd(const int *filter_dims, const float *filter, float *packed) {
+    const int output_channels = filter_dims[0];
+    const int input_channels = filter_dims[3];
+    int oc, ic, i, j;
+
+    for (oc = 0; oc < output_channels; oc++) {
+        for (ic = 0; ic < input_channels; ic++) {
+            float g[3][3];
+            float gg[4][3];
+            float u[4][4];
+
+            for (i = 0; i < 3; i++) {
+                for (j = 0; j < 3; j++) {
+                    g[i][j] = filter[(((size_t)oc * 3 + i) * 3 + j) * input_channels + ic];
+                }
+            }
+            // G g
+            for (j = 0; j < 3; j++) {
+                gg[0][j] = g[0][j];
+                gg[1][j] = 0.5f * (g[0][j] + g[1][j] + g[2][j]);
+                gg[2][j] = 0.5f * (g[0][j] - g[1][j] + g[2][j]);
+                gg[3][j] = g[2][j];
+            }
+            // (G g) G^T
+            for (i = 0; i < 4; i++) {
+                u[i][0] = gg[i][0];
+                u[i][1] = 0.5f * (gg[i][0] + gg[i][1] + gg[i][2]);
+                u[i][2] = 0.5f * (gg[i][0] - gg[i][1] + gg[i][2]);
+                u[i][3] = gg[i][2];
+            }
+            for (i = 0; i < 16; i++) {
+                packed[((size_t)i * input_channels + ic) * output_channels + oc] = u[i / 4][i % 4];
+            }
+        }
+    }
+}
+
+void tensor_ops_conv2d_f32_pack_generic(int algorithm, const int *filter_dims, const float *filter, float *packed) {
+    if (algorithm == TENSOR_OPS_CONV_WINOGRAD) {
+        pack_filter_winograd(filter_dims, filter, packed);
+    } else {
+        pack_filter_direct(filter_dims, filter, packed);
+    }
+}
+
+// Rows are (batch, output row) pairs
+static void conv2d_direct(const struct fconv_params *params, const int *input_dims, const float *input,
+                          const int *filter_dims, const int *output_dims, float *output,
+                          size_t row_begin, size_t row_end) {
+    const int input_height = input_dims[1];
+    const int input_width = input_dims[2];
+    const int input_channels = input_dims[3];
+    const int filter_height = filter_dims[1];
+    const int filter_width = filter_dims[2];
+    const int output_height = output_dims[1];
+    const int output_width = output_dims[2];
+    const int output_channels = output_dims[3];
+    size_t row;
+    int b, oh, ow, ky, kx, ic, oc;
+
+    for (row = row_begin; row < row_end; row++) {
+        b = row / output_height;
+        oh = row % output_height;
+        for (ow = 0; ow < output_width; ow++) {
+            float *out = output + (((size_t)b * output_height + oh) * output_width + ow) * output_channels;
+
+            for (oc = 0; oc < output_channels; oc++) {
+                out[oc] = params->bias ? params->bias[oc] : 0.0f;
+            }
+            for (ky = 0; ky < filter_height; ky++) {
+                int ih = oh * params->stride_h - params->pad_h + ky * params->dilation_h;
+
+                if (ih < 0 || ih >= input_height) {
+                    continue;
+                }
+                for (kx = 0; kx < filter_width; kx++) {
+                    int iw = ow * params->stride_w - params->pad_w + kx * params->dilation_w;
+                    const float *in;
+                    const float *w;
+
+                    if (iw < 0 || iw >= input_width) {
+                        continue;
+                    }
+                    in = input + (((size_t)b * input_height + ih) * input_width + iw) * input_channels;
+                    w = params->packed_filter + (size_t)(ky * filter_width + kx) * input_channels * output_channels;
+                    for (ic = 0; ic < input_channels; ic++) {
+                        const float x = in[ic];
+                        const float *w_row = w + (size_t)ic * output_channels;
+
+                        for (oc = 0; oc < output_channels; oc++) {
+                            out[oc] += x * w_row[oc];
+                        }
+                    }
+                }
+            }
+            for (oc = 0; oc < output_channels; oc++) {
+                out[oc] = clamp_f32(out[oc], params->act_min, params->act_max);
+            }
+        }
+    }
+}
+
+// Scratch: V[16][IC] for the transformed input tile and M[16][OC] for the
+// products. Rows are (batch, row of 2x2 tiles) pairs.
+static void conv2d_winograd(const struct fconv_params *params, const int *input_dims, const float *input,
+                            const int *output_dims, float *output, float *scratch,
+                            size_t row_begin, size_t row_end) {
+    const int input_height = input_dims[1];
+    const int input_width = input_dims[2];
+    const int input_channels = input_dims[3];
+    const int output_height = output_dims[1];
+    const int output_width = output_dims[2];
+    const int output_channels = output_dims[3];
+    float *v = scratch;
+    float *m = scratch + 16 * (size_t)input_channels;
+    const size_t tile_rows = DIV_ROUND_UP(output_height, 2);
+    size_t row;
+    int b, th, tw, i, j, ic, oc, xi;
+
+    for (row = row_begin; row < row_end; row++) {
+        b = row / tile_rows;
+        th = (row % tile_rows) * 2;
+        for (tw = 0; tw < output_width; tw += 2) {
+            const float *pixels[4][4];
+
+            for (i = 0; i < 4; i++) {
+                for (j = 0; j < 4; j++) {
+                    int ih = th - params->pad_h + i;
+                    int iw = tw - params->pad_w + j;
+
+                    pixels[i][j] = (ih < 0 || ih >= input_height || iw < 0 || iw >= input_width) ? NULL :
+                        input + (((size_t)b * input_height + ih) * input_width + iw) * input_channels;
+                }
+            }
+
+            // V = B^T d B for every input channel
+            for (ic = 0; ic < input_channels; ic++) {
+                float d[4][4];
+                float t[4][4];
+
+                for (i = 0; i < 4; i++) {
+                    for (j = 0; j < 4; j++) {
+                        d[i][j] = pixels[i][j] ? pixels[i][j][ic] : 0.0f;
+                    }
+                }
+                for (j = 0; j < 4; j++) {
+                    t[0][j] = d[0][j] - d[2][j];
+                    t[1][j] = d[1][j] + d[2][j];
+                    t[2][j] = d[2][j] - d[1][j];
+                    t[3][j] = d[1][j] - d[3][j];
+                }
+                for (i = 0; i < 4; i++) {
+                    v[(i * 4 + 0) * (size_t)input_channels + ic] = t[i][0] - t[i][2];
+                    v[(i * 4 + 1) * (size_t)input_channels + ic] = t[i][1] + t[i][2];
+                    v[(i * 4 + 2) * (size_t)input_channels + ic] = t[i][2] - t[i][1];
+                    v[(i * 4 + 3) * (size_t)input_channels + ic] = t[i][1] - t[i][3];
+                }
+            }
+
+            // M[xi] = V[xi] x U[xi] for each of the 16 tile positions
+            for (xi = 0; xi < 16; xi++) {
+                float *m_row = m + (size_t)xi * output_channels;
+                const float *u = params->packed_filter + (size_t)xi * input_channels * output_channels;
+
+                memset(m_row, 0, output_channels * sizeof(float));
+                for (ic = 0; ic < input_channels; ic++) {
+                    const float x = v[(size_t)xi * input_channels + ic];
+                    const float *u_row = u + (size_t)ic * output_channels;
+
+                    for (oc = 0; oc < output_channels; oc++) {
+                        m_row[oc] += x * u_row[oc];
+                    }
+                }
+            }
+
+            // Y = A^T M A, written where the 2x2 tile lies inside the output
+            for (oc = 0; oc < output_channels; oc++) {
+                float t[2][4];
+                float y[2][2];
+
+                for (j = 0; j < 4; j++) {
+                    float m0 = m[(0 * 4 + j) * (size_t)output_channels + oc];
+                    float m1 = m[(1 * 4 + j) * (size_t)output_channels + oc];
+                    float m2 = m[(2 * 4 + j) * (size_t)output_channels + oc];
+                    float m3 = m[(3 * 4 + j) * (size_t)output_channels + oc];
+
+                    t[0][j] = m0 + m1 + m2;
+                    t[1][j] = m1 - m2 - m3;
+                }
+                for (i = 0; i < 2; i++) {
+                    y[i][0] = t[i][0] + t[i][1] + t[i][2];
+                    y[i][1] = t[i][1] - t[i][2] - t[i][3];
+                }
+                for (i = 0; i < 2 && th + i < output_height; i++) {
+                    for (j = 0; j < 2 && tw + j < output_width; j++) {
+                        float value = y[i][j] + (params->bias ? params->bias[oc] : 0.0f);
+
+                        output[(((size_t)b * output_height + th + i) * output_width + tw + j) * output_channels + oc] =
+                            clamp_f32(value, params->act_min, params->act_max);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void tensor_ops_conv2d_f32_generic(const struct fconv_params *params, const int *input_dims, const float *input,
+                                   const int *filter_dims, const int *output_dims, float *output, float *scratch,
+                                   size_t row_begin, size_t row_end) {
+    if (params->algorithm == TENSOR_OPS_CONV_WINOGRAD) {
+        conv2d_winograd(params, input_dims, input, output_dims, output, scratch, row_begin, row_end);
+    } else {
+        conv2d_direct(params, input_dims, input, filter_dims, output_dims, output, row_begin, row_end);
+    }
+}
@@ -0,0 +1,69 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/moduleparam.h>
+#include "tensor_ops.h"
+#include "tensor_ops_simd.h"
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("kasinadhsarma, Devin");
+MODULE_DESCRIPTION("Shared tensor kernels for the TensorFlow and TensorFlow Lite interpreters");
+MODULE_VERSION("0.1");
+
+static char *simd = "auto";
+module_param(simd, charp, 0444);
+MODULE_PARM_DESC(simd, "Elementwise kernel variant: auto, scalar, sse2, avx2 or neon");
+
+static bool benchmark = false;
+module_param(benchmark, bool, 0444);
+MODULE_PARM_DESC(benchmark, "Compare the elementwise kernel variants at load time");
+
+static bool selftest = false;
+module_param(selftest, bool, 0444);
+MODULE_PARM_DESC(selftest, "Check every kernel against a scalar reference at load time, and refuse to load on a mismatch");
+
+static char *conv3x3 = "auto";
+module_param(conv3x3, charp, 0444);
+MODULE_PARM_DESC(conv3x3, "Float 3x3 convolution algorithm: auto (measured at load), direct or winograd");
+
+static unsigned int threads = 0;
+module_param(threads, uint, 0444);
+MODULE_PARM_DESC(threads, "Kernel worker threads for large ops (0: one per online CPU)");
+
+static int __init tensor_ops_init(void) {
+    int ret;
+
+    printk(KERN_INFO "TensorOps: Tensor kernel library loaded\n");
+    printk(KERN_INFO "TensorOps: Using %s elementwise kernels\n", tensor_ops_simd_init(simd));
+    ret = tensor_ops_parallel_init(threads);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorOps: Failed to start the worker threads\n");
+        return ret;
+    }
+    printk(KERN_INFO "TensorOps: Started %d worker threads\n", ret);
+    if (benchmark) {
+        tensor_ops_simd_benchmark();
+    }
+    ret = tensor_ops_conv_init(conv3x3);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorOps: Unknown conv3x3 algorithm %s\n", conv3x3);
+        tensor_ops_parallel_exit();
+        return ret;
+    }
+    if (selftest) {
+        ret = tensor_ops_selftest();
+        if (ret < 0) {
+            tensor_ops_parallel_exit();
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static void __exit tensor_ops_exit(void) {
+    tensor_ops_parallel_exit();
+    printk(KERN_INFO "TensorOps: Tensor kernel library unloaded\n");
+}
+
+module_init(tensor_ops_init);
+module_exit(tensor_ops_exit);
@@ -0,0 +1,264 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#ifdef CONFIG_X86
+#include <asm/cpufeature.h>
+#include <asm/fpu/xcr.h>
+#endif
+#ifdef CONFIG_ARM64
+#include <asm/cpufeature.h>
+#endif
+#include "tensor_ops.h"
+#include "tensor_ops_simd.h"
+
+// Inputs are shifted up before rescaling so that the sum keeps enough
+// precision after both sides are brought onto a common scale
+#define QADD_LEFT_SHIFT 20
+
+// Precompute the rescaling for quantized ADD / SUB, following TensorFlow Lite:
+// both inputs are scaled onto twice the larger input scale, the sum is then
+// requantized onto the output scale.
+int tensor_ops_add_prepare(uint32_t input1_scale_bits, uint32_t input2_scale_bits,
+                           uint32_t output_scale_bits, struct qelementwise_params *params) {
+    // Positive floats order the same way as their bit patterns
+    uint32_t max_scale_bits = max(input1_scale_bits, input2_scale_bits);
+    int ret;
+
+    params->left_shift = QADD_LEFT_SHIFT;
+
+    // input_scale / (2 * max_input_scale)
+    ret = tensor_ops_quantize_ratio(input1_scale_bits, TENSOR_OPS_FLOAT_ONE_BITS, max_scale_bits,
+                                    -1, &params->input1_multiplier);
+    if (ret < 0) {
+        return ret;
+    }
+    ret = tensor_ops_quantize_ratio(input2_scale_bits, TENSOR_OPS_FLOAT_ONE_BITS, max_scale_bits,
+                                    -1, &params->input2_multiplier);
+    if (ret < 0) {
+        return ret;
+    }
+    // 2 * max_input_scale / (2^left_shift * output_scale)
+    return tensor_ops_quantize_ratio(max_scale_bits, TENSOR_OPS_FLOAT_ONE_BITS, output_scale_bits,
+                                     1 - QADD_LEFT_SHIFT, &params->output_multiplier);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_add_prepare);
+
+// Precompute the rescaling for quantized MUL: input1_scale * input2_scale / output_scale
+int tensor_ops_mul_prepare(uint32_t input1_scale_bits, uint32_t input2_scale_bits,
+                           uint32_t output_scale_bits, struct qelementwise_params *params) {
+    params->left_shift = 0;
+    params->input1_multiplier.multiplier = 0;
+    params->input1_multiplier.shift = 0;
+    params->input2_multiplier = params->input1_multiplier;
+    return tensor_ops_quantize_ratio(input1_scale_bits, input2_scale_bits, output_scale_bits,
+                                     0, &params->output_multiplier);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_mul_prepare);
+
+static inline int32_t rescale_input(uint8_t value, uint8_t xor_mask, int32_t offset, int left_shift,
+                                    const struct quant_multiplier *qm) {
+    int32_t shifted = ((int32_t)(value ^ xor_mask) + offset) * (1 << left_shift);
+    return tensor_ops_multiply_by_quantized_multiplier(shifted, qm);
+}
+
+static inline uint8_t requantize_output(int32_t raw, const struct qelementwise_params *params) {
+    raw = tensor_ops_multiply_by_quantized_multiplier(raw, &params->output_multiplier) + params->output_offset;
+    return (uint8_t)tensor_ops_clamp(raw, params->act_min, params->act_max) ^ params->output_xor;
+}
+
+void tensor_ops_add_q8_scalar(const struct qelementwise_params *params, size_t size,
+                              const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        int32_t a = rescale_input(input1[i], params->input1_xor, params->input1_offset,
+                                  params->left_shift, &params->input1_multiplier);
+        int32_t b = rescale_input(input2[i], params->input2_xor, params->input2_offset,
+                                  params->left_shift, &params->input2_multiplier);
+        output[i] = requantize_output(a + b, params);
+    }
+}
+
+void tensor_ops_sub_q8_scalar(const struct qelementwise_params *params, size_t size,
+                              const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        int32_t a = rescale_input(input1[i], params->input1_xor, params->input1_offset,
+                                  params->left_shift, &params->input1_multiplier);
+        int32_t b = rescale_input(input2[i], params->input2_xor, params->input2_offset,
+                                  params->left_shift, &params->input2_multiplier);
+        output[i] = requantize_output(a - b, params);
+    }
+}
+
+void tensor_ops_mul_q8_scalar(const struct qelementwise_params *params, size_t size,
+                              const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        int32_t a = (int32_t)(input1[i] ^ params->input1_xor) + params->input1_offset;
+        int32_t b = (int32_t)(input2[i] ^ params->input2_xor) + params->input2_offset;
+        output[i] = requantize_output(a * b, params);
+    }
+}
+
+const struct tensor_ops_simd_kernels tensor_ops_scalar_kernels = {
+    .name = "scalar",
+    .add_f32 = tensor_ops_add_f32_generic,
+    .sub_f32 = tensor_ops_sub_f32_generic,
+    .mul_f32 = tensor_ops_mul_f32_generic,
+    .div_f32 = tensor_ops_div_f32_generic,
+    .max_f32 = tensor_ops_max_f32_generic,
+    .relu_f32 = tensor_ops_relu_f32_generic,
+    .add_q8 = tensor_ops_add_q8_scalar,
+    .sub_q8 = tensor_ops_sub_q8_scalar,
+    .mul_q8 = tensor_ops_mul_q8_scalar,
+};
+
+static bool always_supported(void) {
+    return true;
+}
+
+#ifdef CONFIG_X86
+static bool sse2_supported(void) {
+    return boot_cpu_has(X86_FEATURE_XMM2);
+}
+
+static bool avx2_supported(void) {
+    return boot_cpu_has(X86_FEATURE_AVX2) && boot_cpu_has(X86_FEATURE_OSXSAVE) &&
+           cpu_has_xfeatures(XFEATURE_MASK_SSE | XFEATURE_MASK_YMM, NULL);
+}
+#endif
+
+#ifdef CONFIG_ARM64
+static bool neon_supported(void) {
+    return cpu_have_named_feature(ASIMD);
+}
+#endif
+
+// Candidate kernel tables, from least to most preferred
+static const struct {
+    const struct tensor_ops_simd_kernels *kernels;
+    bool (*supported)(void);
+} simd_variants[] = {
+    { &tensor_ops_scalar_kernels, always_supported },
+#ifdef CONFIG_X86
+    { &tensor_ops_sse2_kernels, sse2_supported },
+    { &tensor_ops_avx2_kernels, avx2_supported },
+#endif
+#ifdef CONFIG_ARM64
+    { &tensor_ops_neon_kernels, neon_supported },
+#endif
+};
+
+static const struct tensor_ops_simd_kernels *simd_kernels = &tensor_ops_scalar_kernels;
+
+// Pick the kernel table once at module load: the best one the CPU supports,
+// or the requested one if supported (scalar otherwise)
+const char *tensor_ops_simd_init(const char *requested) {
+    int i;
+
+    simd_kernels = &tensor_ops_scalar_kernels;
+    for (i = 0; i < ARRAY_SIZE(simd_variants); i++) {
+        if (!simd_variants[i].supported()) {
+            continue;
+        }
+        if (requested && strcmp(requested, "auto") != 0) {
+            if (strcmp(requested, simd_variants[i].kernels->name) == 0) {
+                simd_kernels = simd_variants[i].kernels;
+                break;
+            }
+            continue;
+        }
+        simd_kernels = simd_variants[i].kernels;
+    }
+    return simd_kernels->name;
+}
+
+int tensor_ops_simd_variants(const struct tensor_ops_simd_kernels **variants, int max_variants) {
+    int count = 0;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(simd_variants) && count < max_variants; i++) {
+        if (simd_variants[i].supported()) {
+            variants[count++] = simd_variants[i].kernels;
+        }
+    }
+    return count;
+}
+
+const struct tensor_ops_simd_kernels *tensor_ops_simd_active(void) {
+    return simd_kernels;
+}
+
+const char *tensor_ops_simd_name(void) {
+    return simd_kernels->name;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_simd_name);
+
+void tensor_ops_add_f32(size_t size, const float *input1, const float *input2, float *output) {
+    simd_kernels->add_f32(size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_add_f32);
+
+void tensor_ops_sub_f32(size_t size, const float *input1, const float *input2, float *output) {
+    simd_kernels->sub_f32(size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_sub_f32);
+
+void tensor_ops_mul_f32(size_t size, const float *input1, const float *input2, float *output) {
+    simd_kernels->mul_f32(size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_mul_f32);
+
+void tensor_ops_div_f32(size_t size, const float *input1, const float *input2, float *output) {
+    simd_kernels->div_f32(size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_div_f32);
+
+void tensor_ops_max_f32(size_t size, const float *input1, const float *input2, float *output) {
+    simd_kernels->max_f32(size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_max_f32);
+
+void tensor_ops_relu_f32(size_t size, const float *input, float *output) {
+    simd_kernels->relu_f32(size, input, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_relu_f32);
+
+// The quantized entry points open their own FPU section for large tensors.
+// When that is not possible (e.g. the caller already holds one) they stay scalar.
+void tensor_ops_add_q8(const struct qelementwise_params *params, size_t size,
+                       const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    if (size >= TENSOR_OPS_SIMD_Q8_MIN_ELEMENTS && simd_kernels != &tensor_ops_scalar_kernels && tensor_ops_simd_begin()) {
+        simd_kernels->add_q8(params, size, input1, input2, output);
+        tensor_ops_simd_end();
+        return;
+    }
+    tensor_ops_add_q8_scalar(params, size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_add_q8);
+
+void tensor_ops_sub_q8(const struct qelementwise_params *params, size_t size,
+                       const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    if (size >= TENSOR_OPS_SIMD_Q8_MIN_ELEMENTS && simd_kernels != &tensor_ops_scalar_kernels && tensor_ops_simd_begin()) {
+        simd_kernels->sub_q8(params, size, input1, input2, output);
+        tensor_ops_simd_end();
+        return;
+    }
+    tensor_ops_sub_q8_scalar(params, size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_sub_q8);
+
+void tensor_ops_mul_q8(const struct qelementwise_params *params, size_t size,
+                       const uint8_t *input1, const uint8_t *input2, uint8_t *output) {
+    if (size >= TENSOR_OPS_SIMD_Q8_MIN_ELEMENTS && simd_kernels != &tensor_ops_scalar_kernels && tensor_ops_simd_begin()) {
+        simd_kernels->mul_q8(params, size, input1, input2, output);
+        tensor_ops_simd_end();
+        return;
+    }
+    tensor_ops_mul_q8_scalar(params, size, input1, input2, output);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_mul_q8);
@@ -0,0 +1,176 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include "tensor_ops.h"
+
+// Cache blocking for the quantized GEMM behind FULLY_CONNECTED. A KC-deep
+// slice of QGEMM_NC packed weight rows (64 KB) stays in L2 while every block
+// of QGEMM_MR input rows streams past it; the QGEMM_MR x KC input slice
+// stays in L1. Blocks of QGEMM_NC outputs are spread over the thread pool.
+#define QGEMM_NR TENSOR_OPS_QGEMM_NR
+#define QGEMM_MR 4
+#define QGEMM_KC 512
+#define QGEMM_NC 128
+
+size_t tensor_ops_qgemm_packed_size(int output_depth, int accum_depth) {
+    return (size_t)DIV_ROUND_UP(output_depth, QGEMM_NR) * QGEMM_NR * accum_depth;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_qgemm_packed_size);
+
+// Repack [output_depth][accum_depth] weights into panels of QGEMM_NR rows.
+// Within a panel the layout is depth-major, [k][r], so the microkernel reads
+// the weights of all QGEMM_NR outputs for one k with a single contiguous load.
+// Weights move to the unsigned domain; rows past output_depth are zero.
+void tensor_ops_qgemm_pack_weights(int output_depth, int accum_depth, const uint8_t *weights,
+                                   uint8_t xor_mask, uint8_t *packed) {
+    int num_panels = DIV_ROUND_UP(output_depth, QGEMM_NR);
+    int p, k, r;
+
+    for (p = 0; p < num_panels; p++) {
+        uint8_t *panel = packed + (size_t)p * QGEMM_NR * accum_depth;
+
+        for (k = 0; k < accum_depth; k++) {
+            for (r = 0; r < QGEMM_NR; r++) {
+                int row = p * QGEMM_NR + r;
+                panel[k * QGEMM_NR + r] = row < output_depth ?
+                    weights[(size_t)row * accum_depth + k] ^ xor_mask : 0;
+            }
+        }
+    }
+}
+EXPORT_SYMBOL_GPL(tensor_ops_qgemm_pack_weights);
+
+// With x and w the stored values and xo, wo their offsets:
+//   sum_k (x + xo)(w + wo) = sum_k x*w + wo*sum_k x + xo*sum_k w + K*xo*wo
+// Everything but wo*sum_k x is known at prepare time and folded into the bias.
+void tensor_ops_qgemm_fold_bias(const struct qfc_params *params, const int32_t *bias, int32_t *folded_bias) {
+    const int accum_depth = params->accum_depth;
+    int n, k;
+
+    for (n = 0; n < params->output_depth; n++) {
+        const uint8_t *panel = params->packed_weights + (size_t)(n / QGEMM_NR) * QGEMM_NR * accum_depth;
+        int32_t row_sum = 0;
+
+        for (k = 0; k < accum_depth; k++) {
+            row_sum += panel[k * QGEMM_NR + n % QGEMM_NR];
+        }
+        folded_bias[n] = (bias ? bias[n] : 0) + params->input_offset * row_sum +
+                         accum_depth * params->input_offset * params->filter_offset;
+    }
+}
+EXPORT_SYMBOL_GPL(tensor_ops_qgemm_fold_bias);
+
+// int32 accumulators for the whole output, then one input term per batch
+size_t tensor_ops_fully_connected_q8_scratch_size(int output_depth, int batches) {
+    return ((size_t)output_depth + 1) * batches * sizeof(int32_t);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_fully_connected_q8_scratch_size);
+
+// Register-blocked QGEMM_MR x QGEMM_NR tile over one depth slice. Sums are
+// kept in uint32_t so that wraparound is well defined; the offset terms
+// added later bring the total back into int32 range.
+static void qgemm_microkernel(int rows, int cols, int depth, const uint8_t *input, int input_stride,
+                              uint8_t input_xor, const uint8_t *panel, uint32_t *acc, int acc_stride,
+                              bool accumulate) {
+    uint32_t tile[QGEMM_MR][QGEMM_NR] = {};
+    int m, r, k;
+
+    for (k = 0; k < depth; k++) {
+        const uint8_t *w = panel + k * QGEMM_NR;
+
+        for (m = 0; m < QGEMM_MR; m++) {
+            uint32_t x;
+
+            if (m >= rows) {
+                break;
+            }
+            x = input[m * input_stride + k] ^ input_xor;
+            for (r = 0; r < QGEMM_NR; r++) {
+                tile[m][r] += x * w[r];
+            }
+        }
+    }
+
+    for (m = 0; m < rows; m++) {
+        for (r = 0; r < cols; r++) {
+            acc[m * acc_stride + r] = accumulate ? acc[m * acc_stride + r] + tile[m][r] : tile[m][r];
+        }
+    }
+}
+
+struct fc_q8_job {
+    const struct qfc_params *params;
+    int batches;
+    const uint8_t *input;
+    uint8_t *output;
+    uint32_t *acc;
+    const int32_t *input_terms;
+};
+
+// Columns [begin, end) in units of QGEMM_NC. Every block of columns runs the
+// whole depth and is requantized on its own, so blocks are independent tasks.
+static void fully_connected_q8_columns(void *context, size_t begin, size_t end, int slot) {
+    const struct fc_q8_job *job = context;
+    const struct qfc_params *params = job->params;
+    const int output_depth = params->output_depth;
+    const int accum_depth = params->accum_depth;
+    const int batches = job->batches;
+    uint32_t *acc = job->acc;
+    size_t block;
+    int k0, b0, n, b;
+
+    for (block = begin; block < end; block++) {
+        const int n0 = block * QGEMM_NC;
+        const int n_end = min(n0 + QGEMM_NC, output_depth);
+
+        for (k0 = 0; k0 < accum_depth; k0 += QGEMM_KC) {
+            int kc = min(QGEMM_KC, accum_depth - k0);
+
+            for (b0 = 0; b0 < batches; b0 += QGEMM_MR) {
+                int rows = min(QGEMM_MR, batches - b0);
+
+                for (n = n0; n < n_end; n += QGEMM_NR) {
+                    const uint8_t *panel = params->packed_weights +
+                                           (size_t)(n / QGEMM_NR) * QGEMM_NR * accum_depth + (size_t)k0 * QGEMM_NR;
+
+                    qgemm_microkernel(rows, min(QGEMM_NR, n_end - n), kc,
+                                      job->input + (size_t)b0 * accum_depth + k0, accum_depth, params->input_xor,
+                                      panel, acc + (size_t)b0 * output_depth + n, output_depth, k0 > 0);
+                }
+            }
+        }
+
+        for (b = 0; b < batches; b++) {
+            for (n = n0; n < n_end; n++) {
+                int32_t value = (int32_t)acc[(size_t)b * output_depth + n] + job->input_terms[b] + params->bias[n];
+
+                value = tensor_ops_multiply_by_quantized_multiplier(value, &params->output_multiplier[n]);
+                value = tensor_ops_clamp(value + params->output_offset, params->act_min, params->act_max);
+                job->output[(size_t)b * output_depth + n] = (uint8_t)value ^ params->output_xor;
+            }
+        }
+    }
+}
+
+void tensor_ops_fully_connected_q8(const struct qfc_params *params, int batches,
+                                   const uint8_t *input, uint8_t *output, int32_t *scratch) {
+    const int output_depth = params->output_depth;
+    const int accum_depth = params->accum_depth;
+    int32_t *input_terms = scratch + (size_t)output_depth * batches;
+    struct fc_q8_job job = { params, batches, input, output, (uint32_t *)scratch, input_terms };
+    int b, k;
+
+    for (b = 0; b < batches; b++) {
+        const uint8_t *input_row = input + (size_t)b * accum_depth;
+        uint32_t input_sum = 0;
+
+        for (k = 0; k < accum_depth; k++) {
+            input_sum += input_row[k] ^ params->input_xor;
+        }
+        input_terms[b] = params->filter_offset * (int32_t)input_sum;
+    }
+
+    tensor_ops_parallel_for(DIV_ROUND_UP(output_depth, QGEMM_NC), (size_t)QGEMM_NC * batches * accum_depth,
+                            0, fully_connected_q8_columns, &job);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_fully_connected_q8);
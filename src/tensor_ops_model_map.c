@@ -0,0 +1,176 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/time64.h>
+#include <linux/vmalloc.h>
+#include "tensor_ops.h"
+
+// Model files used in place from the page cache. The pages of a file are
+// pinned and vmapped read-only into one contiguous range, so a loaded model
+// costs no memory beyond the page cache and every module and client loading
+// the same version of a file shares one mapping. A version is the inode with
+// its size and modification time. Writes into a file that is mapped show
+// through to its users, so models should be replaced by renaming a new file
+// over the old one.
+
+struct model_file_mapping {
+    struct model_mapping mapping;
+    struct list_head list;
+    struct kref ref;
+    struct file *file;
+    loff_t size;
+    struct timespec64 mtime;
+    struct page **pages;
+    // File pages, not counting a trailing zero page
+    unsigned long num_pages;
+};
+
+static LIST_HEAD(model_mappings);
+static DEFINE_MUTEX(model_mappings_mutex);
+
+static struct model_file_mapping *find_mapping(struct inode *inode, loff_t size, struct timespec64 mtime) {
+    struct model_file_mapping *entry;
+
+    list_for_each_entry(entry, &model_mappings, list) {
+        if (file_inode(entry->file) == inode && entry->size == size && timespec64_equal(&entry->mtime, &mtime)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void release_pages_of(struct model_file_mapping *entry, unsigned long count) {
+    unsigned long i;
+
+    for (i = 0; i < count; i++) {
+        put_page(entry->pages[i]);
+    }
+    kvfree(entry->pages);
+}
+
+// Reads every page of the file into the page cache and maps them
+static int map_file_pages(struct model_file_mapping *entry) {
+    struct address_space *mapping = entry->file->f_mapping;
+    unsigned long num_vmapped;
+    unsigned long i;
+    void *data;
+
+    // Data ending on a page boundary is followed by the zero page, so the
+    // mapping is always NUL terminated; a partial last page is zero-filled
+    entry->num_pages = DIV_ROUND_UP(entry->size, PAGE_SIZE);
+    num_vmapped = entry->num_pages + (offset_in_page(entry->size) == 0);
+    entry->pages = kvmalloc_array(num_vmapped, sizeof(*entry->pages), GFP_KERNEL);
+    if (!entry->pages) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < entry->num_pages; i++) {
+        struct page *page = read_mapping_page(mapping, i, entry->file);
+
+        if (IS_ERR(page)) {
+            release_pages_of(entry, i);
+            return PTR_ERR(page);
+        }
+        entry->pages[i] = page;
+    }
+    if (num_vmapped > entry->num_pages) {
+        entry->pages[entry->num_pages] = ZERO_PAGE(0);
+    }
+
+    data = vmap(entry->pages, num_vmapped, VM_MAP, PAGE_KERNEL_RO);
+    if (!data) {
+        release_pages_of(entry, entry->num_pages);
+        return -ENOMEM;
+    }
+    entry->mapping.data = data;
+    entry->mapping.size = entry->size;
+    return 0;
+}
+
+struct model_mapping *tensor_ops_model_map(const char *path) {
+    struct model_file_mapping *entry;
+    struct timespec64 mtime;
+    struct inode *inode;
+    struct file *file;
+    loff_t size;
+    int ret;
+
+    file = filp_open(path, O_RDONLY, 0);
+    if (IS_ERR(file)) {
+        return ERR_CAST(file);
+    }
+    inode = file_inode(file);
+    size = i_size_read(inode);
+    mtime = inode_get_mtime(inode);
+    if (!S_ISREG(inode->i_mode) || size <= 0) {
+        filp_close(file, NULL);
+        return ERR_PTR(-EINVAL);
+    }
+
+    mutex_lock(&model_mappings_mutex);
+    entry = find_mapping(inode, size, mtime);
+    if (entry) {
+        kref_get(&entry->ref);
+        mutex_unlock(&model_mappings_mutex);
+        filp_close(file, NULL);
+        return &entry->mapping;
+    }
+
+    entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+    if (!entry) {
+        ret = -ENOMEM;
+        goto fail;
+    }
+    entry->file = file;
+    entry->size = size;
+    entry->mtime = mtime;
+    ret = map_file_pages(entry);
+    if (ret < 0) {
+        kfree(entry);
+        goto fail;
+    }
+    kref_init(&entry->ref);
+    list_add(&entry->list, &model_mappings);
+    mutex_unlock(&model_mappings_mutex);
+
+    printk(KERN_INFO "TensorOps: Mapped %lld byte model %s from the page cache\n", size, path);
+    return &entry->mapping;
+
+fail:
+    mutex_unlock(&model_mappings_mutex);
+    filp_close(file, NULL);
+    return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_model_map);
+
+// Called with model_mappings_mutex held, which it releases
+static void release_mapping(struct kref *ref) {
+    struct model_file_mapping *entry = container_of(ref, struct model_file_mapping, ref);
+
+    list_del(&entry->list);
+    mutex_unlock(&model_mappings_mutex);
+
+    vunmap(entry->mapping.data);
+    release_pages_of(entry, entry->num_pages);
+    filp_close(entry->file, NULL);
+    kfree(entry);
+}
+
+void tensor_ops_model_unmap(struct model_mapping *mapping) {
+    struct model_file_mapping *entry;
+
+    if (!mapping) {
+        return;
+    }
+    entry = container_of(mapping, struct model_file_mapping, mapping);
+    kref_put_mutex(&entry->ref, release_mapping, &model_mappings_mutex);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_model_unmap);
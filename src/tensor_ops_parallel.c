@@ -0,0 +1,487 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/preempt.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include "tensor_ops.h"
+#include "tensor_ops_simd.h"
+
+// Intra-op thread pool. One kernel thread is bound to each CPU and owns a
+// deque of index ranges. A parallel loop hands one range to each worker; a
+// worker splits its range in half for as long as it is larger than the grain,
+// keeping the lower half and pushing the upper half to the bottom of its own
+// deque, where idle workers steal it from the top. Owners work LIFO on
+// recently split, cache-warm ranges while thieves take the largest pieces.
+//
+// Task graphs use the same deques: a task is queued once its last
+// predecessor finishes, except that the calling thread keeps one ready
+// successor for itself, so chains of tasks stay on it.
+
+#define PARALLEL_DEQUE_SIZE 64
+
+// Minimum estimated work (in kernel inner-loop operations) per task
+static unsigned long parallel_grain = 1UL << 16;
+module_param(parallel_grain, ulong, 0644);
+MODULE_PARM_DESC(parallel_grain, "Minimum work per parallel task, in inner-loop operations");
+
+struct parallel_job {
+    tensor_ops_parallel_fn fn;
+    void *context;
+    size_t grain;               // in items
+    unsigned int flags;
+    atomic_long_t remaining;    // items not finished yet; the job is done at 0
+
+    // Task graphs only: each item is one task, queued once it is ready
+    const struct tensor_ops_task_graph *graph;
+    tensor_ops_task_fn task_fn;
+    atomic_t *pending;          // unfinished predecessors per task
+    atomic_t error;             // first error returned by a task
+    int next_worker;            // round-robin target for the caller's pushes
+};
+
+struct parallel_task {
+    struct parallel_job *job;
+    size_t begin;
+    size_t end;
+};
+
+struct parallel_deque {
+    spinlock_t lock;
+    unsigned int top;           // steal end
+    unsigned int bottom;        // owner end
+    struct parallel_task tasks[PARALLEL_DEQUE_SIZE];
+};
+
+struct parallel_worker {
+    struct task_struct *thread;
+    struct parallel_deque deque;
+    int slot;
+};
+
+static struct parallel_worker *workers;
+static int num_workers;
+static atomic_t queued_tasks = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(worker_wait);
+
+static bool deque_push(struct parallel_deque *deque, const struct parallel_task *task) {
+    bool pushed = false;
+
+    spin_lock(&deque->lock);
+    if (deque->bottom - deque->top < PARALLEL_DEQUE_SIZE) {
+        deque->tasks[deque->bottom % PARALLEL_DEQUE_SIZE] = *task;
+        deque->bottom++;
+        pushed = true;
+    }
+    spin_unlock(&deque->lock);
+    if (pushed) {
+        atomic_inc(&queued_tasks);
+    }
+    return pushed;
+}
+
+static bool deque_pop(struct parallel_deque *deque, struct parallel_task *task) {
+    bool popped = false;
+
+    spin_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        deque->bottom--;
+        *task = deque->tasks[deque->bottom % PARALLEL_DEQUE_SIZE];
+        popped = true;
+    }
+    spin_unlock(&deque->lock);
+    if (popped) {
+        atomic_dec(&queued_tasks);
+    }
+    return popped;
+}
+
+// Take the oldest task, optionally only one belonging to the given job
+static bool deque_steal(struct parallel_deque *deque, const struct parallel_job *job, struct parallel_task *task) {
+    bool stolen = false;
+
+    spin_lock(&deque->lock);
+    if (deque->bottom != deque->top &&
+        (!job || deque->tasks[deque->top % PARALLEL_DEQUE_SIZE].job == job)) {
+        *task = deque->tasks[deque->top % PARALLEL_DEQUE_SIZE];
+        deque->top++;
+        stolen = true;
+    }
+    spin_unlock(&deque->lock);
+    if (stolen) {
+        atomic_dec(&queued_tasks);
+    }
+    return stolen;
+}
+
+static bool steal_task(int first_victim, const struct parallel_job *job, struct parallel_task *task) {
+    int i;
+
+    for (i = 0; i < num_workers; i++) {
+        if (deque_steal(&workers[(first_victim + i) % num_workers].deque, job, task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_graph_task(struct parallel_job *job, int index, int ready, struct parallel_deque *deque, int slot);
+
+// Run one task. Workers split it first so that idle workers can steal the
+// upper halves; the calling thread (deque == NULL) runs it whole.
+static void run_task(struct parallel_task *task, struct parallel_deque *deque, int slot) {
+    struct parallel_job *job = task->job;
+    size_t count;
+    bool fpu = false;
+
+    if (job->graph) {
+        run_graph_task(job, task->begin, -1, deque, slot);
+        return;
+    }
+
+    while (deque && task->end - task->begin > job->grain) {
+        struct parallel_task upper = *task;
+
+        upper.begin = task->begin + (task->end - task->begin) / 2;
+        if (!deque_push(deque, &upper)) {
+            break;
+        }
+        wake_up(&worker_wait);
+        task->end = upper.begin;
+    }
+
+    // Workers run tasks without preemption. FPU jobs get a section of their
+    // own; a kernel thread can always take one, and the caller holds one
+    // whenever it runs a task of its FPU job.
+    if (deque) {
+        fpu = (job->flags & TENSOR_OPS_PARALLEL_FPU) && tensor_ops_simd_begin();
+        if (!fpu) {
+            preempt_disable();
+        }
+    }
+    job->fn(job->context, task->begin, task->end, slot);
+    if (fpu) {
+        tensor_ops_simd_end();
+    } else if (deque) {
+        preempt_enable();
+    }
+
+    // Last access to the job, which lives on the caller's stack. The release
+    // makes the results visible to the caller once it sees the job finish.
+    count = task->end - task->begin;
+    smp_mb__before_atomic();
+    atomic_long_sub(count, &job->remaining);
+}
+
+// Queue a task that has become ready. Workers queue it on their own deque,
+// from where the caller or idle workers can steal it; the caller spreads its
+// tasks over the workers. Returns false when the deque is full.
+static bool queue_graph_task(struct parallel_job *job, int index, struct parallel_deque *deque) {
+    struct parallel_task task = { job, index, index + 1 };
+
+    if (!deque) {
+        deque = &workers[job->next_worker].deque;
+        job->next_worker = (job->next_worker + 1) % num_workers;
+    }
+    if (!deque_push(deque, &task)) {
+        return false;
+    }
+    wake_up(&worker_wait);
+    return true;
+}
+
+// Ready tasks that could not be queued run on the thread that readied them.
+// They wait in a list linked through their pending counters, which a ready
+// task no longer needs, so the list takes neither memory nor stack however
+// wide the graph is.
+static void push_ready(struct parallel_job *job, int *ready, int index) {
+    atomic_set(&job->pending[index], *ready);
+    *ready = index;
+}
+
+static int pop_ready(struct parallel_job *job, int *ready) {
+    int index = *ready;
+
+    if (index >= 0) {
+        *ready = atomic_read(&job->pending[index]);
+    }
+    return index;
+}
+
+// Runs task index, then the tasks it readies that stay on this thread, and
+// the list of ready tasks starting at ready
+static void run_graph_task(struct parallel_job *job, int index, int ready, struct parallel_deque *deque, int slot) {
+    const struct tensor_ops_task_graph *graph = job->graph;
+    int next = -1;
+    int ret = 0;
+    bool fpu = false;
+    int i;
+
+    // After an error the remaining tasks are only counted down
+    while (index >= 0) {
+        if (!atomic_read(&job->error)) {
+            if (job->flags & TENSOR_OPS_PARALLEL_FPU) {
+                fpu = tensor_ops_simd_begin();
+                ret = fpu ? job->task_fn(job->context, index, slot) : -EBUSY;
+                if (fpu) {
+                    tensor_ops_simd_end();
+                }
+            } else {
+                if (deque) {
+                    preempt_disable();
+                }
+                ret = job->task_fn(job->context, index, slot);
+                if (deque) {
+                    preempt_enable();
+                }
+            }
+            if (ret < 0) {
+                atomic_cmpxchg(&job->error, 0, ret);
+            }
+        }
+
+        // The caller keeps one ready successor for itself, so a chain of
+        // tasks stays on the calling thread and keeps its intra-op workers
+        next = -1;
+        for (i = graph->successor_offsets[index]; i < graph->successor_offsets[index + 1]; i++) {
+            int successor = graph->successors[i];
+
+            if (!atomic_dec_and_test(&job->pending[successor])) {
+                continue;
+            }
+            if (!deque && next < 0) {
+                next = successor;
+            } else if (!queue_graph_task(job, successor, deque)) {
+                push_ready(job, &ready, successor);
+            }
+        }
+        smp_mb__before_atomic();
+        atomic_long_dec(&job->remaining);
+        index = next >= 0 ? next : pop_ready(job, &ready);
+    }
+}
+
+static int worker_thread(void *data) {
+    struct parallel_worker *worker = data;
+    struct parallel_task task;
+
+    while (!kthread_should_stop()) {
+        if (deque_pop(&worker->deque, &task) || steal_task(worker->slot, NULL, &task)) {
+            run_task(&task, &worker->deque, worker->slot);
+            continue;
+        }
+        wait_event_interruptible(worker_wait, atomic_read(&queued_tasks) > 0 || kthread_should_stop());
+    }
+    return 0;
+}
+
+static bool in_worker_thread(void) {
+    int i;
+
+    for (i = 0; i < num_workers; i++) {
+        if (workers[i].thread == current) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int tensor_ops_parallel_slots(void) {
+    return num_workers + 1;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_parallel_slots);
+
+void tensor_ops_parallel_for(size_t count, size_t item_cost, unsigned int flags,
+                             tensor_ops_parallel_fn fn, void *context) {
+    struct parallel_job job = {};
+    struct parallel_task task;
+    size_t chunk;
+    size_t begin;
+    int i;
+
+    job.grain = max_t(size_t, parallel_grain / max_t(size_t, item_cost, 1), 1);
+    // Nested loops run inline: a worker must not wait on other workers
+    if (num_workers == 0 || count <= job.grain || in_worker_thread()) {
+        fn(context, 0, count, 0);
+        return;
+    }
+
+    job.fn = fn;
+    job.context = context;
+    job.flags = flags;
+    atomic_long_set(&job.remaining, count);
+
+    // One share per worker and one for the calling thread, each at least a grain
+    chunk = max(DIV_ROUND_UP(count, num_workers + 1), job.grain);
+    task.job = &job;
+    task.begin = chunk;
+    for (i = 0; i < num_workers && task.begin < count; i++) {
+        task.end = min(task.begin + chunk, count);
+        if (!deque_push(&workers[i].deque, &task)) {
+            break;
+        }
+        task.begin = task.end;
+    }
+    begin = task.begin;
+    wake_up_all(&worker_wait);
+
+    // The caller's own share, plus anything the pool could not queue
+    task.begin = 0;
+    task.end = chunk;
+    run_task(&task, NULL, 0);
+    if (begin < count) {
+        task.begin = begin;
+        task.end = count;
+        run_task(&task, NULL, 0);
+    }
+
+    // Help with what is left of this job, then wait for the workers. The
+    // caller only steals its own job's tasks, from the top of a deque, so one
+    // may sit under another job's task on the deque of the worker bound to
+    // this CPU. That worker must be able to run: an FPU section is dropped
+    // while waiting and only taken around each stolen task, and the wait
+    // reschedules.
+    if (flags & TENSOR_OPS_PARALLEL_FPU) {
+        tensor_ops_simd_end();
+    }
+    while (atomic_long_read_acquire(&job.remaining) > 0) {
+        if (steal_task(raw_smp_processor_id() % num_workers, &job, &task)) {
+            bool fpu = (flags & TENSOR_OPS_PARALLEL_FPU) && tensor_ops_simd_begin();
+
+            run_task(&task, NULL, 0);
+            if (fpu) {
+                tensor_ops_simd_end();
+            }
+        } else {
+            cond_resched();
+            cpu_relax();
+        }
+    }
+    // The caller's section was taken in this same context, so it can be again
+    if (flags & TENSOR_OPS_PARALLEL_FPU) {
+        WARN_ON_ONCE(!tensor_ops_simd_begin());
+    }
+}
+EXPORT_SYMBOL_GPL(tensor_ops_parallel_for);
+
+int tensor_ops_parallel_run_graph(const struct tensor_ops_task_graph *graph, atomic_t *pending, unsigned int flags,
+                                  tensor_ops_task_fn fn, void *context) {
+    struct parallel_job job = {};
+    struct parallel_task task;
+    int ready = -1;
+    int first = -1;
+    int ret;
+    int i;
+
+    // Without workers, or nested inside a task, run the tasks in their order
+    if (num_workers == 0 || in_worker_thread()) {
+        for (i = 0; i < graph->num_tasks; i++) {
+            bool fpu = (flags & TENSOR_OPS_PARALLEL_FPU) && tensor_ops_simd_begin();
+
+            if ((flags & TENSOR_OPS_PARALLEL_FPU) && !fpu) {
+                return -EBUSY;
+            }
+            ret = fn(context, i, 0);
+            if (fpu) {
+                tensor_ops_simd_end();
+            }
+            if (ret < 0) {
+                return ret;
+            }
+            cond_resched();
+        }
+        return 0;
+    }
+
+    job.graph = graph;
+    job.task_fn = fn;
+    job.context = context;
+    job.flags = flags;
+    job.pending = pending;
+    atomic_set(&job.error, 0);
+    atomic_long_set(&job.remaining, graph->num_tasks);
+    for (i = 0; i < graph->num_tasks; i++) {
+        atomic_set(&pending[i], graph->num_predecessors[i]);
+    }
+
+    // Tasks without predecessors: the first runs here, the others on workers
+    for (i = 0; i < graph->num_tasks; i++) {
+        if (graph->num_predecessors[i] > 0) {
+            continue;
+        }
+        if (first < 0) {
+            first = i;
+        } else if (!queue_graph_task(&job, i, NULL)) {
+            push_ready(&job, &ready, i);
+        }
+    }
+    if (first >= 0) {
+        run_graph_task(&job, first, ready, NULL, 0);
+    }
+
+    // The caller holds no FPU section between tasks, so it may reschedule
+    while (atomic_long_read_acquire(&job.remaining) > 0) {
+        if (steal_task(raw_smp_processor_id() % num_workers, &job, &task)) {
+            run_graph_task(&job, task.begin, -1, NULL, 0);
+        } else {
+            cond_resched();
+            cpu_relax();
+        }
+    }
+    return atomic_read(&job.error);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_parallel_run_graph);
+
+// Start one worker per online CPU, or max_threads if lower (0: no limit)
+int tensor_ops_parallel_init(unsigned int max_threads) {
+    unsigned int cpu;
+    int i;
+    int count = num_online_cpus();
+
+    if (max_threads && max_threads < (unsigned int)count) {
+        count = max_threads;
+    }
+    workers = kcalloc(count, sizeof(*workers), GFP_KERNEL);
+    if (!workers) {
+        return -ENOMEM;
+    }
+
+    for_each_online_cpu(cpu) {
+        struct parallel_worker *worker;
+
+        if (num_workers == count) {
+            break;
+        }
+        worker = &workers[num_workers];
+        spin_lock_init(&worker->deque.lock);
+        worker->slot = num_workers + 1;
+        worker->thread = kthread_create(worker_thread, worker, "tensor_ops/%u", cpu);
+        if (IS_ERR(worker->thread)) {
+            break;
+        }
+        kthread_bind(worker->thread, cpu);
+        num_workers++;
+    }
+    // Workers index each other's deques, so they start once all exist
+    for (i = 0; i < num_workers; i++) {
+        wake_up_process(workers[i].thread);
+    }
+    return num_workers;
+}
+
+void tensor_ops_parallel_exit(void) {
+    int i;
+
+    for (i = 0; i < num_workers; i++) {
+        kthread_stop(workers[i].thread);
+    }
+    num_workers = 0;
+    kfree(workers);
+    workers = NULL;
+}
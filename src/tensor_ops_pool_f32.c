@@ -0,0 +1,155 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include "tensor_ops.h"
+
+// Float32 pooling over NHWC tensors. Built with FPU flags; callers hold an FPU
+// section. For every output pixel the window is walked once and each input
+// pixel contributes a whole contiguous channel row, so the reductions run on
+// the vector elementwise kernels and the input is read in memory order.
+// Output rows are spread over the thread pool.
+
+struct pool_window {
+    int h_start;
+    int h_end;
+    int w_start;
+    int w_end;
+};
+
+// Window of output pixel (oh, ow) clipped to the input
+static inline struct pool_window pool_window(const struct fpool_params *params, const int *input_dims,
+                                             int oh, int ow) {
+    struct pool_window window;
+    int h_origin = oh * params->stride_h - params->pad_h;
+    int w_origin = ow * params->stride_w - params->pad_w;
+
+    window.h_start = max(h_origin, 0);
+    window.h_end = min(h_origin + params->filter_h, input_dims[1]);
+    window.w_start = max(w_origin, 0);
+    window.w_end = min(w_origin + params->filter_w, input_dims[2]);
+    return window;
+}
+
+static inline void clamp_row(const struct fpool_params *params, int channels, float *out) {
+    int c;
+
+    for (c = 0; c < channels; c++) {
+        out[c] = out[c] < params->act_min ? params->act_min : (out[c] > params->act_max ? params->act_max : out[c]);
+    }
+}
+
+struct pool_f32_job {
+    const struct fpool_params *params;
+    const int *input_dims;
+    const float *input;
+    const int *output_dims;
+    float *output;
+};
+
+static void max_pool2d_f32_rows(void *context, size_t begin, size_t end, int slot) {
+    const struct pool_f32_job *job = context;
+    const struct fpool_params *params = job->params;
+    const int *input_dims = job->input_dims;
+    const int *output_dims = job->output_dims;
+    float *output = job->output;
+    const int input_height = input_dims[1];
+    const int input_width = input_dims[2];
+    const int channels = input_dims[3];
+    size_t row;
+    int b, oh, ow, h, w;
+
+    for (row = begin; row < end; row++) {
+        const float *batch;
+
+        b = row / output_dims[1];
+        oh = row % output_dims[1];
+        batch = job->input + (size_t)b * input_height * input_width * channels;
+        for (ow = 0; ow < output_dims[2]; ow++) {
+            struct pool_window window = pool_window(params, input_dims, oh, ow);
+            float *out = output + (((size_t)b * output_dims[1] + oh) * output_dims[2] + ow) * channels;
+            bool first = true;
+
+            for (h = window.h_start; h < window.h_end; h++) {
+                for (w = window.w_start; w < window.w_end; w++) {
+                    const float *in = batch + ((size_t)h * input_width + w) * channels;
+
+                    if (first) {
+                        memcpy(out, in, channels * sizeof(float));
+                        first = false;
+                    } else {
+                        tensor_ops_max_f32(channels, out, in, out);
+                    }
+                }
+            }
+            // A window entirely in the padding has no elements
+            if (first) {
+                memset(out, 0, channels * sizeof(float));
+            }
+            clamp_row(params, channels, out);
+        }
+    }
+}
+
+void tensor_ops_max_pool2d_f32(const struct fpool_params *params,
+                               const int *input_dims, const float *input,
+                               const int *output_dims, float *output) {
+    struct pool_f32_job job = { params, input_dims, input, output_dims, output };
+
+    tensor_ops_parallel_for((size_t)output_dims[0] * output_dims[1],
+                            (size_t)output_dims[2] * params->filter_h * params->filter_w * input_dims[3],
+                            TENSOR_OPS_PARALLEL_FPU, max_pool2d_f32_rows, &job);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_max_pool2d_f32);
+
+static void average_pool2d_f32_rows(void *context, size_t begin, size_t end, int slot) {
+    const struct pool_f32_job *job = context;
+    const struct fpool_params *params = job->params;
+    const int *input_dims = job->input_dims;
+    const int *output_dims = job->output_dims;
+    float *output = job->output;
+    const int input_height = input_dims[1];
+    const int input_width = input_dims[2];
+    const int channels = input_dims[3];
+    size_t row;
+    int b, oh, ow, h, w, c;
+
+    for (row = begin; row < end; row++) {
+        const float *batch;
+
+        b = row / output_dims[1];
+        oh = row % output_dims[1];
+        batch = job->input + (size_t)b * input_height * input_width * channels;
+        for (ow = 0; ow < output_dims[2]; ow++) {
+            struct pool_window window = pool_window(params, input_dims, oh, ow);
+            float *out = output + (((size_t)b * output_dims[1] + oh) * output_dims[2] + ow) * channels;
+            int count = max(window.h_end - window.h_start, 0) * max(window.w_end - window.w_start, 0);
+
+            memset(out, 0, channels * sizeof(float));
+            for (h = window.h_start; h < window.h_end; h++) {
+                for (w = window.w_start; w < window.w_end; w++) {
+                    tensor_ops_add_f32(channels, out, batch + ((size_t)h * input_width + w) * channels, out);
+                }
+            }
+            // Only elements inside the input are averaged, as in TensorFlow Lite
+            if (count > 0) {
+                const float scale = 1.0f / count;
+
+                for (c = 0; c < channels; c++) {
+                    out[c] *= scale;
+                }
+            }
+            clamp_row(params, channels, out);
+        }
+    }
+}
+
+void tensor_ops_average_pool2d_f32(const struct fpool_params *params,
+                                   const int *input_dims, const float *input,
+                                   const int *output_dims, float *output) {
+    struct pool_f32_job job = { params, input_dims, input, output_dims, output };
+
+    tensor_ops_parallel_for((size_t)output_dims[0] * output_dims[1],
+                            (size_t)output_dims[2] * params->filter_h * params->filter_w * input_dims[3],
+                            TENSOR_OPS_PARALLEL_FPU, average_pool2d_f32_rows, &job);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_average_pool2d_f32);
@@ -0,0 +1,404 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include "tensor_ops.h"
+
+// 2^(-2^-k) in Q31 for k = 1..16, used to build exp() tables without the FPU
+static const uint32_t exp2_neg_pow2_q31[16] = {
+    0x5a82799a, 0x6ba27e65, 0x75606374, 0x7a92be8b,
+    0x7d41d96e, 0x7e9f0606, 0x7f4f08ae, 0x7fa765ad,
+    0x7fd3ab29, 0x7fe9d3a9, 0x7ff4e959, 0x7ffa748e,
+    0x7ffd3a3f, 0x7ffe9d1e, 0x7fff4e8e, 0x7fffa747,
+};
+
+// Split a positive float32 bit pattern into mantissa * 2^exponent
+static int decode_positive_float(uint32_t bits, uint64_t *mantissa, int *exponent) {
+    uint32_t biased = (bits >> 23) & 0xff;
+
+    if (bits & 0x80000000u || biased == 0xff) {
+        return -EINVAL;
+    }
+    if (biased == 0) {
+        // Zero or denormal
+        *mantissa = bits & 0x7fffff;
+        *exponent = 1 - 127 - 23;
+        return 0;
+    }
+    *mantissa = (bits & 0x7fffff) | 0x800000;
+    *exponent = (int)biased - 127 - 23;
+    return 0;
+}
+
+// Compute the fixed-point multiplier for (a * b / den) * 2^pot using only
+// integer arithmetic on the float bit patterns
+int tensor_ops_quantize_ratio(uint32_t num_a_bits, uint32_t num_b_bits, uint32_t den_bits,
+                              int pot, struct quant_multiplier *qm) {
+    uint64_t ma, mb, md;
+    int ea, eb, ed;
+    uint64_t q;
+    int msb, s, shift;
+
+    if (decode_positive_float(num_a_bits, &ma, &ea) < 0 ||
+        decode_positive_float(num_b_bits, &mb, &eb) < 0 ||
+        decode_positive_float(den_bits, &md, &ed) < 0 || md == 0) {
+        return -EINVAL;
+    }
+
+    qm->multiplier = 0;
+    qm->shift = 0;
+
+    // ma * mb < 2^48, so 15 extra bits of precision still fit in 64 bits
+    q = div64_u64((ma * mb) << 15, md);
+    if (q == 0) {
+        return 0;
+    }
+
+    // Normalise q into [2^30, 2^31) so it reads as a Q31 value in [0.5, 1)
+    msb = fls64(q) - 1;
+    s = msb - 30;
+    if (s > 0) {
+        q = (q + (1ull << (s - 1))) >> s;
+        if (q == (1ull << 31)) {
+            q >>= 1;
+            s++;
+        }
+    } else if (s < 0) {
+        q <<= -s;
+    }
+
+    shift = ea + eb - ed - 15 + pot + s + 31;
+    if (shift > 30) {
+        return -ERANGE;
+    }
+    if (shift < -31) {
+        return 0;
+    }
+
+    qm->multiplier = (int32_t)q;
+    qm->shift = shift;
+    return 0;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_quantize_ratio);
+
+// Build the exp(-beta * input_scale * d) table for quantized softmax.
+// exp(-x) is evaluated as 2^(-x / ln 2) with the fraction expanded bit by bit.
+int tensor_ops_softmax_prepare(uint32_t beta_bits, uint32_t input_scale_bits,
+                               struct qsoftmax_params *params) {
+    struct quant_multiplier qm;
+    int ret;
+    int d;
+
+    // Q16 fixed-point value of beta * input_scale / ln 2
+    ret = tensor_ops_quantize_ratio(beta_bits, input_scale_bits, TENSOR_OPS_FLOAT_LN2_BITS, 16, &qm);
+    if (ret < 0) {
+        return ret;
+    }
+    if (qm.shift > 23) {
+        return -ERANGE;
+    }
+
+    for (d = 0; d < 256; d++) {
+        int32_t t = tensor_ops_multiply_by_quantized_multiplier(d, &qm);
+        int integer_part = t >> 16;
+        uint32_t fraction = t & 0xffff;
+        uint64_t v = 1ull << 31;
+        int k;
+
+        for (k = 0; k < 16; k++) {
+            if (fraction & (0x8000u >> k)) {
+                v = (v * exp2_neg_pow2_q31[k] + (1ull << 30)) >> 31;
+            }
+        }
+        params->exp_lut[d] = integer_part >= 32 ? 0 : (uint32_t)(v >> integer_part);
+    }
+
+    return 0;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_softmax_prepare);
+
+// Padding on the leading edge for SAME padding, matching TensorFlow Lite
+int tensor_ops_compute_padding(int in_size, int filter_size, int stride, int dilation,
+                               int out_size, bool same_padding) {
+    int effective_filter_size = (filter_size - 1) * dilation + 1;
+    int padding;
+
+    if (!same_padding) {
+        return 0;
+    }
+    padding = ((out_size - 1) * stride + effective_filter_size - in_size) / 2;
+    return padding > 0 ? padding : 0;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_compute_padding);
+
+// Conv and pooling kernels split their output rows over the thread pool
+struct conv_q8_job {
+    const struct qconv_params *params;
+    const int *input_dims;
+    const uint8_t *input;
+    const int *filter_dims;
+    const uint8_t *filter;
+    const int32_t *bias;
+    const int *output_dims;
+    uint8_t *output;
+};
+
+struct pool_q8_job {
+    const struct qpool_params *params;
+    const int *input_dims;
+    const uint8_t *input;
+    const int *output_dims;
+    uint8_t *output;
+};
+
+static inline int32_t requantize_q8(int32_t acc, const struct qconv_params *params, int channel) {
+    acc = tensor_ops_multiply_by_quantized_multiplier(acc, &params->output_multiplier[channel]);
+    acc += params->output_offset;
+    return tensor_ops_clamp(acc, params->act_min, params->act_max);
+}
+
+static void conv2d_q8_rows(void *context, size_t begin, size_t end, int slot) {
+    const struct conv_q8_job *job = context;
+    const struct qconv_params *params = job->params;
+    const int *input_dims = job->input_dims;
+    const uint8_t *input = job->input;
+    const int *filter_dims = job->filter_dims;
+    const uint8_t *filter = job->filter;
+    const int32_t *bias = job->bias;
+    const int *output_dims = job->output_dims;
+    uint8_t *output = job->output;
+    const int input_h = input_dims[1];
+    const int input_w = input_dims[2];
+    const int input_c = input_dims[3];
+    const int filter_h = filter_dims[1];
+    const int filter_w = filter_dims[2];
+    const int output_h = output_dims[1];
+    const int output_w = output_dims[2];
+    const int output_c = output_dims[3];
+    const uint8_t ixor = params->input_xor;
+    const uint8_t fxor = params->filter_xor;
+    size_t row;
+    int ox, oc, fy, fx, ic;
+
+    for (row = begin; row < end; row++) {
+        const int b = row / output_h;
+        const int oy = row % output_h;
+        const int in_y_origin = oy * params->stride_h - params->pad_h;
+        for (ox = 0; ox < output_w; ox++) {
+            const int in_x_origin = ox * params->stride_w - params->pad_w;
+            uint8_t *out_px = output + ((b * output_h + oy) * output_w + ox) * output_c;
+
+            for (oc = 0; oc < output_c; oc++) {
+                const uint8_t *filter_oc = filter + oc * filter_h * filter_w * input_c;
+                int32_t acc = 0;
+
+                for (fy = 0; fy < filter_h; fy++) {
+                    const int iy = in_y_origin + fy * params->dilation_h;
+                    if (iy < 0 || iy >= input_h) {
+                        continue;
+                    }
+                    for (fx = 0; fx < filter_w; fx++) {
+                        const int ix = in_x_origin + fx * params->dilation_w;
+                        const uint8_t *in_px;
+                        const uint8_t *f_px;
+                        if (ix < 0 || ix >= input_w) {
+                            continue;
+                        }
+                        in_px = input + ((b * input_h + iy) * input_w + ix) * input_c;
+                        f_px = filter_oc + (fy * filter_w + fx) * input_c;
+                        for (ic = 0; ic < input_c; ic++) {
+                            acc += ((int32_t)(in_px[ic] ^ ixor) + params->input_offset) *
+                                   ((int32_t)(f_px[ic] ^ fxor) + params->filter_offset);
+                        }
+                    }
+                }
+                if (bias) {
+                    acc += bias[oc];
+                }
+                out_px[oc] = (uint8_t)requantize_q8(acc, params, oc) ^ params->output_xor;
+            }
+        }
+    }
+}
+
+void tensor_ops_conv2d_q8(const struct qconv_params *params,
+                          const int *input_dims, const uint8_t *input,
+                          const int *filter_dims, const uint8_t *filter,
+                          const int32_t *bias,
+                          const int *output_dims, uint8_t *output) {
+    struct conv_q8_job job = { params, input_dims, input, filter_dims, filter, bias, output_dims, output };
+
+    tensor_ops_parallel_for((size_t)output_dims[0] * output_dims[1],
+                            (size_t)output_dims[2] * output_dims[3] * filter_dims[1] * filter_dims[2] * input_dims[3],
+                            0, conv2d_q8_rows, &job);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_conv2d_q8);
+
+static void depthwise_conv2d_q8_rows(void *context, size_t begin, size_t end, int slot) {
+    const struct conv_q8_job *job = context;
+    const struct qconv_params *params = job->params;
+    const int *input_dims = job->input_dims;
+    const uint8_t *input = job->input;
+    const int *filter_dims = job->filter_dims;
+    const uint8_t *filter = job->filter;
+    const int32_t *bias = job->bias;
+    const int *output_dims = job->output_dims;
+    uint8_t *output = job->output;
+    const int input_h = input_dims[1];
+    const int input_w = input_dims[2];
+    const int input_c = input_dims[3];
+    const int filter_h = filter_dims[1];
+    const int filter_w = filter_dims[2];
+    const int output_h = output_dims[1];
+    const int output_w = output_dims[2];
+    const int output_c = output_dims[3];
+    const int depth_multiplier = params->depth_multiplier;
+    const uint8_t ixor = params->input_xor;
+    const uint8_t fxor = params->filter_xor;
+    size_t row;
+    int ox, ic, m, fy, fx;
+
+    for (row = begin; row < end; row++) {
+        const int b = row / output_h;
+        const int oy = row % output_h;
+        const int in_y_origin = oy * params->stride_h - params->pad_h;
+        for (ox = 0; ox < output_w; ox++) {
+            const int in_x_origin = ox * params->stride_w - params->pad_w;
+            uint8_t *out_px = output + ((b * output_h + oy) * output_w + ox) * output_c;
+
+            for (ic = 0; ic < input_c; ic++) {
+                for (m = 0; m < depth_multiplier; m++) {
+                    const int oc = ic * depth_multiplier + m;
+                    int32_t acc = 0;
+
+                    for (fy = 0; fy < filter_h; fy++) {
+                        const int iy = in_y_origin + fy * params->dilation_h;
+                        if (iy < 0 || iy >= input_h) {
+                            continue;
+                        }
+                        for (fx = 0; fx < filter_w; fx++) {
+                            const int ix = in_x_origin + fx * params->dilation_w;
+                            int32_t in_val, f_val;
+                            if (ix < 0 || ix >= input_w) {
+                                continue;
+                            }
+                            in_val = input[((b * input_h + iy) * input_w + ix) * input_c + ic] ^ ixor;
+                            f_val = filter[(fy * filter_w + fx) * output_c + oc] ^ fxor;
+                            acc += (in_val + params->input_offset) * (f_val + params->filter_offset);
+                        }
+                    }
+                    if (bias) {
+                        acc += bias[oc];
+                    }
+                    out_px[oc] = (uint8_t)requantize_q8(acc, params, oc) ^ params->output_xor;
+                }
+            }
+        }
+    }
+}
+
+void tensor_ops_depthwise_conv2d_q8(const struct qconv_params *params,
+                                    const int *input_dims, const uint8_t *input,
+                                    const int *filter_dims, const uint8_t *filter,
+                                    const int32_t *bias,
+                                    const int *output_dims, uint8_t *output) {
+    struct conv_q8_job job = { params, input_dims, input, filter_dims, filter, bias, output_dims, output };
+
+    tensor_ops_parallel_for((size_t)output_dims[0] * output_dims[1],
+                            (size_t)output_dims[2] * output_dims[3] * filter_dims[1] * filter_dims[2],
+                            0, depthwise_conv2d_q8_rows, &job);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_depthwise_conv2d_q8);
+
+static void average_pool2d_q8_rows(void *context, size_t begin, size_t end, int slot) {
+    const struct pool_q8_job *job = context;
+    const struct qpool_params *params = job->params;
+    const int *input_dims = job->input_dims;
+    const uint8_t *input = job->input;
+    const int *output_dims = job->output_dims;
+    uint8_t *output = job->output;
+    const int input_h = input_dims[1];
+    const int input_w = input_dims[2];
+    const int depth = input_dims[3];
+    const int output_h = output_dims[1];
+    const int output_w = output_dims[2];
+    const uint8_t xor_mask = params->xor_mask;
+    size_t row;
+    int ox, c, fy, fx;
+
+    for (row = begin; row < end; row++) {
+        const int b = row / output_h;
+        const int oy = row % output_h;
+        const int in_y_origin = oy * params->stride_h - params->pad_h;
+        const int fy_start = max(0, -in_y_origin);
+        const int fy_end = min(params->filter_h, input_h - in_y_origin);
+        for (ox = 0; ox < output_w; ox++) {
+            const int in_x_origin = ox * params->stride_w - params->pad_w;
+            const int fx_start = max(0, -in_x_origin);
+            const int fx_end = min(params->filter_w, input_w - in_x_origin);
+            const int count = (fy_end - fy_start) * (fx_end - fx_start);
+            uint8_t *out_px = output + ((b * output_h + oy) * output_w + ox) * depth;
+
+            for (c = 0; c < depth; c++) {
+                int32_t sum = 0;
+                int32_t avg = 0;
+
+                for (fy = fy_start; fy < fy_end; fy++) {
+                    const uint8_t *in_row = input + ((b * input_h + in_y_origin + fy) * input_w + in_x_origin) * depth;
+                    for (fx = fx_start; fx < fx_end; fx++) {
+                        sum += in_row[fx * depth + c] ^ xor_mask;
+                    }
+                }
+                // Padded elements do not count towards the average
+                if (count > 0) {
+                    avg = (sum + count / 2) / count;
+                }
+                avg = tensor_ops_clamp(avg, params->act_min, params->act_max);
+                out_px[c] = (uint8_t)avg ^ xor_mask;
+            }
+        }
+    }
+}
+
+void tensor_ops_average_pool2d_q8(const struct qpool_params *params,
+                                  const int *input_dims, const uint8_t *input,
+                                  const int *output_dims, uint8_t *output) {
+    struct pool_q8_job job = { params, input_dims, input, output_dims, output };
+
+    tensor_ops_parallel_for((size_t)output_dims[0] * output_dims[1],
+                            (size_t)output_dims[2] * output_dims[3] * params->filter_h * params->filter_w,
+                            0, average_pool2d_q8_rows, &job);
+}
+EXPORT_SYMBOL_GPL(tensor_ops_average_pool2d_q8);
+
+void tensor_ops_softmax_q8(const struct qsoftmax_params *params,
+                           int outer_size, int depth,
+                           const uint8_t *input, uint8_t *output) {
+    const uint8_t ixor = params->input_xor;
+    int i, c;
+
+    for (i = 0; i < outer_size; i++) {
+        const uint8_t *in_row = input + i * depth;
+        uint8_t *out_row = output + i * depth;
+        uint8_t max_val = 0;
+        uint64_t sum = 0;
+
+        for (c = 0; c < depth; c++) {
+            uint8_t v = in_row[c] ^ ixor;
+            if (v > max_val) {
+                max_val = v;
+            }
+        }
+        for (c = 0; c < depth; c++) {
+            sum += params->exp_lut[max_val - (uint8_t)(in_row[c] ^ ixor)];
+        }
+        for (c = 0; c < depth; c++) {
+            uint64_t e = params->exp_lut[max_val - (uint8_t)(in_row[c] ^ ixor)];
+            // Output scale is 1/256: q = round(256 * e / sum) + zero_point
+            int32_t q = (int32_t)div64_u64((e << 8) + sum / 2, sum) + params->output_offset;
+            out_row[c] = (uint8_t)tensor_ops_clamp(q, 0, 255) ^ params->output_xor;
+        }
+    }
+}
+EXPORT_SYMBOL_GPL(tensor_ops_softmax_q8);
@@ -0,0 +1,54 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/overflow.h>
+#include "tensor_ops.h"
+
+// Packs output tensors for the interpreter devices to return from read(),
+// so results of any size come back as raw data rather than text
+
+void *tensor_ops_pack_results(const struct tensor_result_header *headers, const void *const *data,
+                              int count, size_t *size) {
+    struct tensor_results_header *stream_header;
+    size_t total = sizeof(*stream_header);
+    uint8_t *stream;
+    uint8_t *cursor;
+    int i;
+
+    if (count < 0 || count > U16_MAX) {
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        size_t padded = ALIGN(headers[i].bytes, TENSOR_RESULTS_ALIGN);
+
+        if (padded < headers[i].bytes || check_add_overflow(total, sizeof(headers[i]) + padded, &total)) {
+            return NULL;
+        }
+    }
+
+    stream = kvmalloc(total, GFP_KERNEL);
+    if (!stream) {
+        return NULL;
+    }
+    stream_header = (struct tensor_results_header *)stream;
+    stream_header->magic = TENSOR_RESULTS_MAGIC;
+    stream_header->version = TENSOR_RESULTS_VERSION;
+    stream_header->num_tensors = count;
+    stream_header->total_bytes = total;
+
+    cursor = stream + sizeof(*stream_header);
+    for (i = 0; i < count; i++) {
+        size_t padded = ALIGN(headers[i].bytes, TENSOR_RESULTS_ALIGN);
+
+        memcpy(cursor, &headers[i], sizeof(headers[i]));
+        cursor += sizeof(headers[i]);
+        memcpy(cursor, data[i], headers[i].bytes);
+        memset(cursor + headers[i].bytes, 0, padded - headers[i].bytes);
+        cursor += padded;
+    }
+    *size = total;
+    return stream;
+}
+EXPORT_SYMBOL_GPL(tensor_ops_pack_results);
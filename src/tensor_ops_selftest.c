@@ -0,0 +1,628 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/atomic.h>
+#include <linux/bitops.h>
+#include <linux/sched.h>
+#include "tensor_ops_simd.h"
+
+// Correctness self-test, run at module load with selftest=1. Every kernel is
+// run on fixed inputs and compared with a scalar reference: the vector
+// elementwise tables with the scalar table, and the GEMM, float convolution,
+// broadcasting, thread pool, task graph and arena planner with straight-line
+// reimplementations here. Float results are compared through their bit
+// patterns, on inputs for which every algorithm is exact, so this file
+// itself never needs the FPU.
+
+#define SELFTEST_MAX_VARIANTS 4
+
+static int selftest_failures;
+
+static void selftest_fail(const char *test, const char *what, int index) {
+    printk(KERN_ALERT "TensorOps: Self-test %s failed: %s at %d\n", test, what, index);
+    selftest_failures++;
+}
+
+// IEEE-754 bits of a small integer, exact below 2^24
+static uint32_t int_to_float_bits(int32_t value) {
+    uint32_t sign = value < 0 ? 0x80000000u : 0;
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    int msb;
+
+    if (magnitude == 0) {
+        return 0;
+    }
+    msb = fls(magnitude) - 1;
+    return sign | ((uint32_t)(127 + msb) << 23) | ((magnitude << (23 - msb)) & 0x7fffff);
+}
+
+// Bit equality, with both zeros equal
+static bool float_bits_equal(uint32_t a, uint32_t b) {
+    return a == b || ((a | b) & 0x7fffffff) == 0;
+}
+
+// Elementwise: every supported table against the scalar one, on sizes that
+// exercise the vector bodies and their scalar tails
+static const size_t elementwise_sizes[] = { 1, 7, 33, 1029 };
+#define ELEMENTWISE_MAX_SIZE 1029
+
+struct elementwise_buffers {
+    uint32_t input1[ELEMENTWISE_MAX_SIZE];
+    uint32_t input2[ELEMENTWISE_MAX_SIZE];
+    uint32_t expected[ELEMENTWISE_MAX_SIZE];
+    uint32_t actual[ELEMENTWISE_MAX_SIZE];
+    uint8_t input1_q8[ELEMENTWISE_MAX_SIZE];
+    uint8_t input2_q8[ELEMENTWISE_MAX_SIZE];
+    uint8_t expected_q8[ELEMENTWISE_MAX_SIZE];
+    uint8_t actual_q8[ELEMENTWISE_MAX_SIZE];
+};
+
+static void compare_f32(const char *variant, const char *op, const uint32_t *expected, const uint32_t *actual,
+                        size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (!float_bits_equal(expected[i], actual[i])) {
+            printk(KERN_ALERT "TensorOps: Self-test elementwise %s/%s n=%zu: got %08x, expected %08x\n",
+                   variant, op, size, actual[i], expected[i]);
+            selftest_fail("elementwise", op, i);
+            return;
+        }
+    }
+}
+
+static void compare_q8(const char *variant, const char *op, const uint8_t *expected, const uint8_t *actual,
+                       size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (expected[i] != actual[i]) {
+            printk(KERN_ALERT "TensorOps: Self-test elementwise %s/%s n=%zu: got %u, expected %u\n",
+                   variant, op, size, actual[i], expected[i]);
+            selftest_fail("elementwise", op, i);
+            return;
+        }
+    }
+}
+
+static void test_elementwise_variant(const struct tensor_ops_simd_kernels *kernels, struct elementwise_buffers *b,
+                                     const struct qelementwise_params *add_params,
+                                     const struct qelementwise_params *mul_params, size_t n) {
+    const struct tensor_ops_simd_kernels *ref = &tensor_ops_scalar_kernels;
+    const float *in1 = (const float *)b->input1;
+    const float *in2 = (const float *)b->input2;
+    float *expected = (float *)b->expected;
+    float *actual = (float *)b->actual;
+
+#define TEST_BINARY_F32(op)                                               \
+    do {                                                                  \
+        ref->op(n, in1, in2, expected);                                   \
+        kernels->op(n, in1, in2, actual);                                 \
+        compare_f32(kernels->name, #op, b->expected, b->actual, n);       \
+    } while (0)
+#define TEST_BINARY_Q8(op, params)                                                          \
+    do {                                                                                    \
+        ref->op(params, n, b->input1_q8, b->input2_q8, b->expected_q8);                     \
+        kernels->op(params, n, b->input1_q8, b->input2_q8, b->actual_q8);                   \
+        compare_q8(kernels->name, #op, b->expected_q8, b->actual_q8, n);                    \
+    } while (0)
+
+    if (!tensor_ops_simd_begin()) {
+        selftest_fail("elementwise", "no FPU section", 0);
+        return;
+    }
+    TEST_BINARY_F32(add_f32);
+    TEST_BINARY_F32(sub_f32);
+    TEST_BINARY_F32(mul_f32);
+    TEST_BINARY_F32(div_f32);
+    TEST_BINARY_F32(max_f32);
+    ref->relu_f32(n, in1, expected);
+    kernels->relu_f32(n, in1, actual);
+    compare_f32(kernels->name, "relu_f32", b->expected, b->actual, n);
+    TEST_BINARY_Q8(add_q8, add_params);
+    TEST_BINARY_Q8(sub_q8, add_params);
+    TEST_BINARY_Q8(mul_q8, mul_params);
+    tensor_ops_simd_end();
+
+#undef TEST_BINARY_F32
+#undef TEST_BINARY_Q8
+}
+
+static void test_elementwise(void) {
+    const struct tensor_ops_simd_kernels *variants[SELFTEST_MAX_VARIANTS];
+    struct qelementwise_params add_params = {}, mul_params;
+    struct elementwise_buffers *b;
+    int num_variants;
+    int v, s;
+    int i;
+
+    b = kzalloc(sizeof(*b), GFP_KERNEL);
+    if (!b) {
+        selftest_fail("elementwise", "allocation", 0);
+        return;
+    }
+    // Floats of both signs in [1, 2) and [-2, -1), plus some zeros, so RELU
+    // and MAX see both sides
+    for (i = 0; i < ELEMENTWISE_MAX_SIZE; i++) {
+        b->input1[i] = i % 5 == 0 ? 0 : TENSOR_OPS_FLOAT_ONE_BITS | ((i * 2654435761u) & 0x7fffff) | ((i & 1) << 31);
+        b->input2[i] = TENSOR_OPS_FLOAT_ONE_BITS | ((i * 40503u) & 0x7fffff) | ((i % 3 == 0) << 31);
+        b->input1_q8[i] = (uint8_t)(i * 7);
+        b->input2_q8[i] = (uint8_t)(i * 13 + 5);
+    }
+
+    // Scales 0.02, 0.05 and 0.07, an int8 input and output and a narrowed clamp
+    add_params.input1_offset = -120;
+    add_params.input2_offset = -100;
+    add_params.output_offset = 128;
+    add_params.input1_xor = TENSOR_OPS_INT8_XOR;
+    add_params.output_xor = TENSOR_OPS_INT8_XOR;
+    add_params.act_min = 10;
+    add_params.act_max = 240;
+    mul_params = add_params;
+    if (tensor_ops_add_prepare(0x3ca3d70au, 0x3d4ccccdu, 0x3d8f5c29u, &add_params) < 0 ||
+        tensor_ops_mul_prepare(0x3ca3d70au, 0x3d4ccccdu, 0x3d8f5c29u, &mul_params) < 0) {
+        selftest_fail("elementwise", "prepare", 0);
+        kfree(b);
+        return;
+    }
+
+    num_variants = tensor_ops_simd_variants(variants, SELFTEST_MAX_VARIANTS);
+    for (v = 0; v < num_variants; v++) {
+        for (s = 0; s < ARRAY_SIZE(elementwise_sizes); s++) {
+            test_elementwise_variant(variants[v], b, &add_params, &mul_params, elementwise_sizes[s]);
+        }
+        cond_resched();
+    }
+    kfree(b);
+}
+
+// Quantized FULLY_CONNECTED against the plain int8 dot product. The depth is
+// not a multiple of the panel width, so the padded panel rows are covered.
+#define FC_BATCHES 3
+#define FC_OUTPUT_DEPTH 7
+#define FC_ACCUM_DEPTH 37
+
+static void test_fully_connected_q8(void) {
+    uint8_t input[FC_BATCHES * FC_ACCUM_DEPTH];
+    uint8_t weights[FC_OUTPUT_DEPTH * FC_ACCUM_DEPTH];
+    int32_t bias[FC_OUTPUT_DEPTH];
+    int32_t folded_bias[FC_OUTPUT_DEPTH];
+    struct quant_multiplier multipliers[FC_OUTPUT_DEPTH];
+    uint8_t output[FC_BATCHES * FC_OUTPUT_DEPTH];
+    struct qfc_params params = {};
+    uint8_t *packed;
+    int32_t *scratch;
+    int b, n, k;
+
+    packed = kzalloc(tensor_ops_qgemm_packed_size(FC_OUTPUT_DEPTH, FC_ACCUM_DEPTH), GFP_KERNEL);
+    scratch = kzalloc(tensor_ops_fully_connected_q8_scratch_size(FC_OUTPUT_DEPTH, FC_BATCHES), GFP_KERNEL);
+    if (!packed || !scratch) {
+        selftest_fail("fully_connected_q8", "allocation", 0);
+        goto out;
+    }
+
+    for (k = 0; k < FC_BATCHES * FC_ACCUM_DEPTH; k++) {
+        input[k] = (uint8_t)(k * 37 + 11);
+    }
+    for (k = 0; k < FC_OUTPUT_DEPTH * FC_ACCUM_DEPTH; k++) {
+        weights[k] = (uint8_t)(k * 101 + 3);
+    }
+    for (n = 0; n < FC_OUTPUT_DEPTH; n++) {
+        bias[n] = (n - 3) * 1000;
+        // Input scale 0.02, per-channel filter scales 0.05 and 0.07, output scale 2
+        if (tensor_ops_quantize_ratio(0x3ca3d70au, n & 1 ? 0x3d8f5c29u : 0x3d4ccccdu, 0x40000000u, 0,
+                                      &multipliers[n]) < 0) {
+            selftest_fail("fully_connected_q8", "prepare", n);
+            goto out;
+        }
+    }
+
+    // int8 input, weights and output
+    params.output_depth = FC_OUTPUT_DEPTH;
+    params.accum_depth = FC_ACCUM_DEPTH;
+    params.input_offset = -(5 + 128);
+    params.filter_offset = -128;
+    params.output_offset = -3 + 128;
+    params.input_xor = TENSOR_OPS_INT8_XOR;
+    params.output_xor = TENSOR_OPS_INT8_XOR;
+    params.act_min = 0;
+    params.act_max = 255;
+    params.output_multiplier = multipliers;
+    tensor_ops_qgemm_pack_weights(FC_OUTPUT_DEPTH, FC_ACCUM_DEPTH, weights, TENSOR_OPS_INT8_XOR, packed);
+    params.packed_weights = packed;
+    tensor_ops_qgemm_fold_bias(&params, bias, folded_bias);
+    params.bias = folded_bias;
+
+    tensor_ops_fully_connected_q8(&params, FC_BATCHES, input, output, scratch);
+
+    for (b = 0; b < FC_BATCHES; b++) {
+        for (n = 0; n < FC_OUTPUT_DEPTH; n++) {
+            int32_t acc = bias[n];
+            int32_t expected;
+
+            for (k = 0; k < FC_ACCUM_DEPTH; k++) {
+                acc += ((input[b * FC_ACCUM_DEPTH + k] ^ TENSOR_OPS_INT8_XOR) + params.input_offset) *
+                       ((weights[n * FC_ACCUM_DEPTH + k] ^ TENSOR_OPS_INT8_XOR) + params.filter_offset);
+            }
+            expected = tensor_ops_multiply_by_quantized_multiplier(acc, &multipliers[n]) + params.output_offset;
+            expected = tensor_ops_clamp(expected, params.act_min, params.act_max) ^ TENSOR_OPS_INT8_XOR;
+            if (output[b * FC_OUTPUT_DEPTH + n] != expected) {
+                printk(KERN_ALERT "TensorOps: Self-test fully_connected_q8 batch %d channel %d: got %u, expected %d\n",
+                       b, n, output[b * FC_OUTPUT_DEPTH + n], expected);
+                selftest_fail("fully_connected_q8", "output", b * FC_OUTPUT_DEPTH + n);
+                goto out;
+            }
+        }
+    }
+
+out:
+    kfree(packed);
+    kfree(scratch);
+}
+
+// Float CONV_2D with both algorithms against an integer reference. Inputs and
+// weights are small integers, so every partial result of the direct kernel
+// and of the Winograd transforms is exact and the outputs must match bit for
+// bit. The odd output width leaves a partial Winograd tile.
+#define CONV_BATCHES 2
+#define CONV_HEIGHT 6
+#define CONV_WIDTH 5
+#define CONV_IN_CHANNELS 3
+#define CONV_OUT_CHANNELS 4
+#define CONV_INPUT_ELEMENTS (CONV_BATCHES * CONV_HEIGHT * CONV_WIDTH * CONV_IN_CHANNELS)
+#define CONV_FILTER_ELEMENTS (CONV_OUT_CHANNELS * 3 * 3 * CONV_IN_CHANNELS)
+#define CONV_OUTPUT_ELEMENTS (CONV_BATCHES * CONV_HEIGHT * CONV_WIDTH * CONV_OUT_CHANNELS)
+
+struct conv_f32_buffers {
+    int32_t input[CONV_INPUT_ELEMENTS];
+    int32_t filter[CONV_FILTER_ELEMENTS];
+    uint32_t input_bits[CONV_INPUT_ELEMENTS];
+    uint32_t filter_bits[CONV_FILTER_ELEMENTS];
+    uint32_t bias_bits[CONV_OUT_CHANNELS];
+    uint32_t expected[CONV_OUTPUT_ELEMENTS];
+    uint32_t output[CONV_OUTPUT_ELEMENTS];
+};
+
+static void conv2d_reference(struct conv_f32_buffers *c) {
+    int b, y, x, oc, fy, fx, ic;
+
+    for (b = 0; b < CONV_BATCHES; b++) {
+        for (y = 0; y < CONV_HEIGHT; y++) {
+            for (x = 0; x < CONV_WIDTH; x++) {
+                for (oc = 0; oc < CONV_OUT_CHANNELS; oc++) {
+                    int32_t acc = oc - 2;
+
+                    // SAME padding of one pixel on every side
+                    for (fy = 0; fy < 3; fy++) {
+                        int iy = y + fy - 1;
+
+                        if (iy < 0 || iy >= CONV_HEIGHT) {
+                            continue;
+                        }
+                        for (fx = 0; fx < 3; fx++) {
+                            int ix = x + fx - 1;
+
+                            if (ix < 0 || ix >= CONV_WIDTH) {
+                                continue;
+                            }
+                            for (ic = 0; ic < CONV_IN_CHANNELS; ic++) {
+                                acc += c->input[((b * CONV_HEIGHT + iy) * CONV_WIDTH + ix) * CONV_IN_CHANNELS + ic] *
+                                       c->filter[((oc * 3 + fy) * 3 + fx) * CONV_IN_CHANNELS + ic];
+                            }
+                        }
+                    }
+                    c->expected[((b * CONV_HEIGHT + y) * CONV_WIDTH + x) * CONV_OUT_CHANNELS + oc] =
+                        int_to_float_bits(acc);
+                }
+            }
+        }
+    }
+}
+
+static void test_conv2d_f32_algorithm(struct conv_f32_buffers *c, int algorithm, const char *name) {
+    static const int input_dims[4] = { CONV_BATCHES, CONV_HEIGHT, CONV_WIDTH, CONV_IN_CHANNELS };
+    static const int filter_dims[4] = { CONV_OUT_CHANNELS, 3, 3, CONV_IN_CHANNELS };
+    static const int output_dims[4] = { CONV_BATCHES, CONV_HEIGHT, CONV_WIDTH, CONV_OUT_CHANNELS };
+    const uint32_t lowest_bits = TENSOR_OPS_FLOAT_LOWEST_BITS;
+    const uint32_t max_bits = TENSOR_OPS_FLOAT_MAX_BITS;
+    struct fconv_params params = {};
+    float *packed;
+    float *scratch;
+    int i;
+
+    params.stride_h = 1;
+    params.stride_w = 1;
+    params.dilation_h = 1;
+    params.dilation_w = 1;
+    params.pad_h = 1;
+    params.pad_w = 1;
+    params.algorithm = algorithm;
+    params.bias = (const float *)c->bias_bits;
+    memcpy(&params.act_min, &lowest_bits, sizeof(lowest_bits));
+    memcpy(&params.act_max, &max_bits, sizeof(max_bits));
+
+    packed = kzalloc(tensor_ops_conv2d_f32_packed_size(algorithm, filter_dims), GFP_KERNEL);
+    scratch = kzalloc(max_t(size_t, tensor_ops_conv2d_f32_scratch_size(algorithm, filter_dims), 1), GFP_KERNEL);
+    if (!packed || !scratch) {
+        selftest_fail(name, "allocation", 0);
+        goto out;
+    }
+    if (tensor_ops_conv2d_f32_pack_filter(algorithm, filter_dims, (const float *)c->filter_bits, packed) < 0) {
+        selftest_fail(name, "pack", 0);
+        goto out;
+    }
+    params.packed_filter = packed;
+
+    memset(c->output, 0xff, sizeof(c->output));
+    if (tensor_ops_conv2d_f32(&params, input_dims, (const float *)c->input_bits, filter_dims,
+                              output_dims, (float *)c->output, scratch) < 0) {
+        selftest_fail(name, "run", 0);
+        goto out;
+    }
+    for (i = 0; i < CONV_OUTPUT_ELEMENTS; i++) {
+        if (!float_bits_equal(c->expected[i], c->output[i])) {
+            printk(KERN_ALERT "TensorOps: Self-test %s output %d: got %08x, expected %08x\n",
+                   name, i, c->output[i], c->expected[i]);
+            selftest_fail(name, "output", i);
+            break;
+        }
+    }
+
+out:
+    kfree(packed);
+    kfree(scratch);
+}
+
+static void test_conv2d_f32(void) {
+    struct conv_f32_buffers *c;
+    int i;
+
+    c = kzalloc(sizeof(*c), GFP_KERNEL);
+    if (!c) {
+        selftest_fail("conv2d_f32", "allocation", 0);
+        return;
+    }
+    for (i = 0; i < CONV_INPUT_ELEMENTS; i++) {
+        c->input[i] = (i * 5 + i / 7) % 7 - 3;
+        c->input_bits[i] = int_to_float_bits(c->input[i]);
+    }
+    for (i = 0; i < CONV_FILTER_ELEMENTS; i++) {
+        c->filter[i] = (i * 5) % 9 - 4;
+        c->filter_bits[i] = int_to_float_bits(c->filter[i]);
+    }
+    for (i = 0; i < CONV_OUT_CHANNELS; i++) {
+        c->bias_bits[i] = int_to_float_bits(i - 2);
+    }
+    conv2d_reference(c);
+
+    test_conv2d_f32_algorithm(c, TENSOR_OPS_CONV_DIRECT, "conv2d_f32_direct");
+    test_conv2d_f32_algorithm(c, TENSOR_OPS_CONV_WINOGRAD, "conv2d_f32_winograd");
+    kfree(c);
+}
+
+// Broadcasting quantized ADD of [2, 1, 3] and [4, 1] onto [2, 4, 3], against
+// the scalar kernel applied one element at a time
+static void test_broadcast_q8(void) {
+    static const int dims1[3] = { 2, 1, 3 };
+    static const int dims2[2] = { 4, 1 };
+    static const int output_dims[3] = { 2, 4, 3 };
+    uint8_t input1[6], input2[4], output[24];
+    struct qelementwise_params q8_params = {};
+    struct broadcast_params params;
+    uint8_t *scratch;
+    int i, y, x, c;
+
+    for (i = 0; i < 6; i++) {
+        input1[i] = (uint8_t)(i * 41 + 7);
+    }
+    for (i = 0; i < 4; i++) {
+        input2[i] = (uint8_t)(i * 67 + 3);
+    }
+    q8_params.input1_offset = -128;
+    q8_params.input2_offset = -100;
+    q8_params.output_offset = 120;
+    q8_params.act_min = 0;
+    q8_params.act_max = 255;
+    if (tensor_ops_add_prepare(0x3ca3d70au, 0x3d4ccccdu, 0x3d8f5c29u, &q8_params) < 0 ||
+        tensor_ops_broadcast_prepare(3, dims1, 2, dims2, 3, output_dims, &params) < 0) {
+        selftest_fail("broadcast_q8", "prepare", 0);
+        return;
+    }
+    scratch = kzalloc(max_t(size_t, tensor_ops_broadcast_scratch_size(&params, 1), 1), GFP_KERNEL);
+    if (!scratch) {
+        selftest_fail("broadcast_q8", "allocation", 0);
+        return;
+    }
+
+    tensor_ops_broadcast_q8(&params, TENSOR_OPS_BINARY_ADD, &q8_params, input1, input2, output, scratch);
+
+    for (i = 0; i < 24; i++) {
+        uint8_t expected;
+
+        y = i / 12;
+        x = (i / 3) % 4;
+        c = i % 3;
+        tensor_ops_add_q8_scalar(&q8_params, 1, &input1[y * 3 + c], &input2[x], &expected);
+        if (output[i] != expected) {
+            printk(KERN_ALERT "TensorOps: Self-test broadcast_q8 output %d: got %u, expected %u\n",
+                   i, output[i], expected);
+            selftest_fail("broadcast_q8", "output", i);
+            break;
+        }
+    }
+    kfree(scratch);
+}
+
+// Thread pool: every item of a parallel_for is visited exactly once, on a
+// valid slot, for counts around and well above the split grain
+struct parallel_for_check {
+    atomic_t *visits;
+    atomic_t bad_slots;
+};
+
+static void count_visits(void *context, size_t begin, size_t end, int slot) {
+    struct parallel_for_check *check = context;
+    size_t i;
+
+    if (slot < 0 || slot >= tensor_ops_parallel_slots()) {
+        atomic_inc(&check->bad_slots);
+    }
+    for (i = begin; i < end; i++) {
+        atomic_inc(&check->visits[i]);
+    }
+}
+
+static void test_parallel_for(void) {
+    static const size_t counts[] = { 1, 3, 64, 4099 };
+    struct parallel_for_check check;
+    size_t i;
+    int c;
+
+    check.visits = kcalloc(4099, sizeof(atomic_t), GFP_KERNEL);
+    if (!check.visits) {
+        selftest_fail("parallel_for", "allocation", 0);
+        return;
+    }
+    for (c = 0; c < ARRAY_SIZE(counts); c++) {
+        for (i = 0; i < counts[c]; i++) {
+            atomic_set(&check.visits[i], 0);
+        }
+        atomic_set(&check.bad_slots, 0);
+        // A high item cost makes every item worth a task of its own
+        tensor_ops_parallel_for(counts[c], 1 << 16, 0, count_visits, &check);
+        if (atomic_read(&check.bad_slots)) {
+            selftest_fail("parallel_for", "slot out of range", c);
+        }
+        for (i = 0; i < counts[c]; i++) {
+            if (atomic_read(&check.visits[i]) != 1) {
+                printk(KERN_ALERT "TensorOps: Self-test parallel_for count %zu: item %zu visited %d times\n",
+                       counts[c], i, atomic_read(&check.visits[i]));
+                selftest_fail("parallel_for", "visits", i);
+                break;
+            }
+        }
+    }
+    kfree(check.visits);
+}
+
+// Task graph: 0 -> {1, 2} -> 3 -> 4, with 5 independent. Every task must
+// start after all its predecessors finished, and an error must be returned.
+#define GRAPH_TASKS 6
+
+static const int graph_num_predecessors[GRAPH_TASKS] = { 0, 1, 1, 2, 1, 0 };
+static const int graph_successor_offsets[GRAPH_TASKS + 1] = { 0, 2, 3, 4, 5, 5, 5 };
+static const int graph_successors[] = { 1, 2, 3, 3, 4 };
+
+struct graph_check {
+    atomic_t clock;
+    int started[GRAPH_TASKS];
+    int finished[GRAPH_TASKS];
+    int failing_task;
+};
+
+static int record_task(void *context, int task, int slot) {
+    struct graph_check *check = context;
+
+    check->started[task] = atomic_inc_return(&check->clock);
+    check->finished[task] = atomic_inc_return(&check->clock);
+    return task == check->failing_task ? -EIO : 0;
+}
+
+static void test_run_graph(void) {
+    const struct tensor_ops_task_graph graph = {
+        GRAPH_TASKS, graph_num_predecessors, graph_successor_offsets, graph_successors,
+    };
+    struct graph_check check = {};
+    atomic_t pending[GRAPH_TASKS];
+    int t, s;
+    int ret;
+
+    check.failing_task = -1;
+    ret = tensor_ops_parallel_run_graph(&graph, pending, 0, record_task, &check);
+    if (ret < 0) {
+        selftest_fail("run_graph", "error", ret);
+        return;
+    }
+    for (t = 0; t < GRAPH_TASKS; t++) {
+        if (!check.finished[t]) {
+            selftest_fail("run_graph", "task not run", t);
+            return;
+        }
+        for (s = graph_successor_offsets[t]; s < graph_successor_offsets[t + 1]; s++) {
+            if (check.started[graph_successors[s]] < check.finished[t]) {
+                selftest_fail("run_graph", "task started before its predecessor", graph_successors[s]);
+                return;
+            }
+        }
+    }
+
+    memset(&check, 0, sizeof(check));
+    check.failing_task = 2;
+    ret = tensor_ops_parallel_run_graph(&graph, pending, 0, record_task, &check);
+    if (ret != -EIO) {
+        selftest_fail("run_graph", "error not returned", ret);
+    }
+}
+
+// Arena planner: aligned, in bounds, no overlap between tensors that are
+// live at the same time, and reuse along a chain
+static void test_plan_arena(void) {
+    struct arena_allocation allocations[] = {
+        { 1000, 0, 1 }, { 1000, 1, 2 }, { 1000, 2, 3 },   // chain: the third reuses the first
+        { 4096, 0, 4 }, { 1, 3, 3 }, { 0, 1, 1 }, { 700, 4, 5 },
+    };
+    const int count = ARRAY_SIZE(allocations);
+    size_t arena_size;
+    int i, j;
+
+    if (tensor_ops_plan_arena(allocations, count, 64, &arena_size) < 0) {
+        selftest_fail("plan_arena", "plan", 0);
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        const struct arena_allocation *a = &allocations[i];
+
+        if (a->size == 0) {
+            continue;
+        }
+        if (a->offset % 64 || a->offset + a->size > arena_size) {
+            selftest_fail("plan_arena", "placement", i);
+            return;
+        }
+        for (j = 0; j < i; j++) {
+            const struct arena_allocation *b = &allocations[j];
+
+            if (b->size == 0 || a->last_use < b->first_use || b->last_use < a->first_use) {
+                continue;
+            }
+            if (a->offset < b->offset + b->size && b->offset < a->offset + a->size) {
+                selftest_fail("plan_arena", "overlap", i);
+                return;
+            }
+        }
+    }
+    if (allocations[2].offset != allocations[0].offset) {
+        selftest_fail("plan_arena", "no reuse", 2);
+    }
+}
+
+// Returns 0 if every kernel agreed with its reference
+int tensor_ops_selftest(void) {
+    selftest_failures = 0;
+    test_elementwise();
+    test_fully_connected_q8();
+    test_conv2d_f32();
+    test_broadcast_q8();
+    test_parallel_for();
+    test_run_graph();
+    test_plan_arena();
+
+    if (selftest_failures) {
+        printk(KERN_ALERT "TensorOps: Self-test failed with %d errors\n", selftest_failures);
+        return -EINVAL;
+    }
+    printk(KERN_INFO "TensorOps: Self-test passed\n");
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+
+// AVX2 elementwise kernels; built with the flags set in the Makefile
+#define SIMD_VECTOR_BYTES 32
+#define SIMD_SUFFIX avx2
+#include "tensor_ops_simd_impl.h"
+
+const struct tensor_ops_simd_kernels tensor_ops_avx2_kernels = SIMD_KERNEL_TABLE("avx2");
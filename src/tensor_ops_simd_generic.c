@@ -0,0 +1,54 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include "tensor_ops_simd.h"
+
+// Scalar float kernels. They run inside an FPU section like the vector ones,
+// and also finish the tails of the vector loops.
+
+void tensor_ops_add_f32_generic(size_t size, const float *input1, const float *input2, float *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        output[i] = input1[i] + input2[i];
+    }
+}
+
+void tensor_ops_sub_f32_generic(size_t size, const float *input1, const float *input2, float *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        output[i] = input1[i] - input2[i];
+    }
+}
+
+void tensor_ops_mul_f32_generic(size_t size, const float *input1, const float *input2, float *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        output[i] = input1[i] * input2[i];
+    }
+}
+
+void tensor_ops_div_f32_generic(size_t size, const float *input1, const float *input2, float *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        output[i] = input1[i] / input2[i];
+    }
+}
+
+void tensor_ops_max_f32_generic(size_t size, const float *input1, const float *input2, float *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        output[i] = input1[i] > input2[i] ? input1[i] : input2[i];
+    }
+}
+
+void tensor_ops_relu_f32_generic(size_t size, const float *input, float *output) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        output[i] = input[i] > 0.0f ? input[i] : 0.0f;
+    }
+}
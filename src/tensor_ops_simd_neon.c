@@ -0,0 +1,9 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+
+// NEON elementwise kernels; built with the flags set in the Makefile
+#define SIMD_VECTOR_BYTES 16
+#define SIMD_SUFFIX neon
+#include "tensor_ops_simd_impl.h"
+
+const struct tensor_ops_simd_kernels tensor_ops_neon_kernels = SIMD_KERNEL_TABLE("neon");
@@ -0,0 +1,15 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+
+// Instantiates the tflite tracepoints once, for every module using them
+#define CREATE_TRACE_POINTS
+#include "tflite_trace.h"
+
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_model_load_begin);
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_model_load_end);
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_prepare_begin);
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_prepare_end);
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_op_begin);
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_op_end);
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_queue_enqueue);
+EXPORT_TRACEPOINT_SYMBOL_GPL(tflite_queue_dequeue);
@@ -6,8 +6,15 @@
 #include <linux/file.h>
 #include <linux/fs_struct.h>
 #include <linux/err.h>
+#include <linux/mm.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/percpu.h>
 #include <flatbuffers/flatbuffers.h>
 #include "schema_v3c_generated.h"
+#include "tensor_ops.h"
+#include "tensor_ops_simd.h"
 
 #define DEVICE_NAME "tensorflow_interpreter_device"
 #define CLASS_NAME "tensorflow_interpreter"
@@ -19,9 +26,48 @@ MODULE_VERSION("0.1");
 
 static int major_number;
 static char *kernel_buffer;
+// Output tensors packed by GET_RESULTS, returned by read() until the next command
+static void *results;
+static size_t results_bytes;
 static struct class *tensorflow_interpreter_class = NULL;
 static struct device *tensorflow_interpreter_device = NULL;
 
+// Consecutive float nodes share one tensor_ops_simd_begin/end section. Preemption
+// is disabled inside a section, so its estimated work is bounded.
+static unsigned long fpu_section_max_elements = 1UL << 20;
+module_param(fpu_section_max_elements, ulong, 0644);
+MODULE_PARM_DESC(fpu_section_max_elements, "Maximum number of float elements touched within one FPU section");
+
+// Independent branches of the graph run concurrently on the tensor_ops
+// worker threads; graphs without parallel branches always run in order
+static bool dag_scheduler = true;
+module_param(dag_scheduler, bool, 0644);
+MODULE_PARM_DESC(dag_scheduler, "Run independent branches of the graph concurrently");
+
+struct fpu_section_stats {
+    u64 sections;
+    u64 nodes;
+    u64 total_ns;
+    u64 max_ns;
+};
+
+// Sections end on whichever CPU ran them, so each CPU counts its own
+static DEFINE_PER_CPU(struct fpu_section_stats, fpu_stats);
+
+static void sum_fpu_stats(struct fpu_section_stats *total) {
+    int cpu;
+
+    memset(total, 0, sizeof(*total));
+    for_each_possible_cpu(cpu) {
+        const struct fpu_section_stats *stats = per_cpu_ptr(&fpu_stats, cpu);
+
+        total->sections += stats->sections;
+        total->nodes += stats->nodes;
+        total->total_ns += stats->total_ns;
+        total->max_ns = max(total->max_ns, stats->max_ns);
+    }
+}
+
 static int dev_open(struct inode *inodep, struct file *filep) {
     printk(KERN_INFO "TFLiteParserDevice: Device opened\n");
     return 0;
@@ -31,21 +77,29 @@ static int dev_release(struct inode *inodep, struct file *filep) {
     return 0;
 }
 static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *offset) {
-    int error_count = 0;
-    error_count = copy_to_user(buffer, kernel_buffer, len);
+    ssize_t ret;
 
-    if (error_count == 0) {
-        printk(KERN_INFO "TFLiteParserDevice: Sent %zu characters to the user\n", len);
-        return len; // Return the number of bytes read
+    if (results) {
+        ret = simple_read_from_buffer(buffer, len, offset, results, results_bytes);
     } else {
-        printk(KERN_INFO "TFLiteParserDevice: Failed to send %d characters to the user\n", error_count);
-        return -EFAULT;
+        ret = simple_read_from_buffer(buffer, len, offset, kernel_buffer, strnlen(kernel_buffer, 1024));
     }
+    if (ret < 0) {
+        printk(KERN_INFO "TFLiteParserDevice: Failed to send results to the user\n");
+        return ret;
+    }
+    printk(KERN_INFO "TFLiteParserDevice: Sent %zd bytes to the user\n", ret);
+    return ret;
 }
 
 static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset) {
     snprintf(kernel_buffer, 1024, "%s(%zu letters)", buffer, len);
     printk(KERN_INFO "TensorFlowInterpreterDevice: Received %zu characters from the user\n", len);
+    // Each command starts a new response, read from its beginning
+    kvfree(results);
+    results = NULL;
+    results_bytes = 0;
+    *offset = 0;
 
     // Command handling logic
     if (strncmp(buffer, "LOAD_MODEL", 10) == 0) {
@@ -62,10 +116,18 @@ static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, lof
         if (ret < 0) {
             printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to execute model\n");
         }
+    } else if (strncmp(buffer, "GET_FPU_STATS", 13) == 0) {
+        // Report time spent inside FPU sections
+        struct fpu_section_stats total;
+
+        sum_fpu_stats(&total);
+        snprintf(kernel_buffer, 1024,
+                 "fpu_sections=%llu fpu_nodes=%llu fpu_total_ns=%llu fpu_max_section_ns=%llu\n",
+                 total.sections, total.nodes, total.total_ns, total.max_ns);
     } else if (strncmp(buffer, "GET_RESULTS", 11) == 0) {
         // Handle result retrieval
         printk(KERN_INFO "TensorFlowInterpreterDevice: Retrieving results\n");
-        int ret = get_results(kernel_buffer, 1024);
+        int ret = get_results();
         if (ret < 0) {
             printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to retrieve results\n");
         }
@@ -90,22 +152,746 @@ static int parse_tensorflow_model(char *model_data) {
     return parse_tensorflow_model(model_data);
 }
 
+// Activations are placed in one arena; keep every tensor cache-line aligned
+#define GRAPH_ARENA_ALIGNMENT 64
+
+struct graph_tensor {
+    int id;
+    int type;
+    int dims[4];                // NHWC, padded with leading ones
+    int rank;                   // of the model shape
+    uint32_t scale_bits;        // IEEE-754 bits of the quantization scale
+    int32_t zero_point;
+    void *data;
+    size_t data_size;
+    bool is_constant;
+    int first_use;
+    int last_use;
+};
+
+// Elementwise chains are fused into one node of at most this many steps
+#define MAX_FUSED_STEPS 4
+
+// Fused nodes stream their operands through tiles of this many floats, so
+// intermediate results stay in L1 instead of round-tripping through memory
+#define FUSION_TILE_ELEMENTS 1024
+
+// One elementwise operation applied to the running result of a fused node
+struct fused_step {
+    int opcode;
+    struct graph_tensor *operand;   // NULL for RELU
+    bool operand_first;             // operand is the left-hand side
+};
+
 static struct node {
     int id;
     int opcode;
     int num_inputs;
     int num_outputs;
-    struct node **inputs;
-    struct node **outputs;
+    struct graph_tensor **inputs;
+    struct graph_tensor **outputs;
+    bool uses_fpu;
+    bool fpu_section_begin;
+    bool fpu_section_end;
+    struct fpool_params pool;   // MAXPOOL / AVGPOOL only
+    struct broadcast_params broadcast;  // ADD / MULTIPLY / SUBTRACT / DIVIDE only
+    float *broadcast_scratch;
+    int num_fused_steps;
+    struct fused_step fused_steps[MAX_FUSED_STEPS];
 };
 
 static struct computation_graph {
     int num_nodes;
     struct node *nodes;
+    int num_tensors;
+    struct graph_tensor *tensors;
+    int num_outputs;
+    int *output_ids;            // graph outputs, in model order
+    void *arena;
+    size_t arena_size;
+    int num_fused_nodes;
+    // Tasks of the DAG scheduler and their dependencies, in
+    // tensor_ops_task_graph form. Task t runs nodes task_first[t] to
+    // task_first[t + 1] - 1 in order.
+    int num_tasks;
+    int *task_first;
+    struct tensor_ops_task_graph schedule;
+    int *num_predecessors;
+    int *successor_offsets;
+    int *successors;
+    atomic_t *pending;
+    int parallel_width;         // most tasks that can run at the same time
 };
 
 static struct computation_graph graph;
 
+static void free_computation_graph(void) {
+    for (int i = 0; i < graph.num_nodes; i++) {
+        kfree(graph.nodes[i].inputs);
+        kfree(graph.nodes[i].outputs);
+        kfree(graph.nodes[i].broadcast_scratch);
+    }
+    kfree(graph.nodes);
+    kfree(graph.tensors);
+    kfree(graph.output_ids);
+    kvfree(graph.arena);
+    kfree(graph.task_first);
+    kfree(graph.num_predecessors);
+    kfree(graph.successor_offsets);
+    kfree(graph.successors);
+    kfree(graph.pending);
+    memset(&graph, 0, sizeof(graph));
+}
+
+static size_t tensor_byte_size(const tflite::Tensor *tensor) {
+    size_t count = 1;
+    size_t element_size;
+
+    switch (tensor->type()) {
+        case tflite::TensorType_FLOAT32:
+        case tflite::TensorType_INT32:
+            element_size = 4;
+            break;
+        case tflite::TensorType_UINT8:
+        case tflite::TensorType_INT8:
+            element_size = 1;
+            break;
+        default:
+            return 0;
+    }
+    if (!tensor->shape()) {
+        return 0;
+    }
+    for (auto dim : *tensor->shape()) {
+        if (dim <= 0) {
+            return 0;
+        }
+        count *= dim;
+    }
+    return count * element_size;
+}
+
+// Expand a tensor shape of rank <= 4 to NHWC by prepending ones
+static int tensor_dims4(const tflite::Tensor *tensor, int *dims) {
+    int rank = tensor->shape() ? tensor->shape()->size() : 0;
+
+    if (rank > 4) {
+        return -EINVAL;
+    }
+    for (int i = 0; i < 4 - rank; i++) {
+        dims[i] = 1;
+    }
+    for (int i = 0; i < rank; i++) {
+        dims[4 - rank + i] = tensor->shape()->Get(i);
+    }
+    return 0;
+}
+
+// Quantization parameters are read as raw float bits so no FPU state is used
+static void tensor_quantization(const tflite::Tensor *tensor, uint32_t *scale_bits, int32_t *zero_point) {
+    const tflite::QuantizationParameters *quant = tensor->quantization();
+
+    *scale_bits = TENSOR_OPS_FLOAT_ONE_BITS;
+    *zero_point = 0;
+    if (quant && quant->scale() && quant->scale()->size() > 0) {
+        memcpy(scale_bits, quant->scale()->Data(), sizeof(*scale_bits));
+    }
+    if (quant && quant->zero_point() && quant->zero_point()->size() > 0) {
+        *zero_point = (int32_t)quant->zero_point()->Get(0);
+    }
+}
+
+// Function to derive the pooling geometry of a MAXPOOL / AVGPOOL node from
+// the model's shapes, padding, stride and fused activation
+static int prepare_pool_node(struct node *current_node, const tflite::Operator *op) {
+    const tflite::Pool2DOptions *options = op->builtin_options_as_Pool2DOptions();
+    struct graph_tensor *input = current_node->num_inputs > 0 ? current_node->inputs[0] : NULL;
+    struct graph_tensor *output = current_node->num_outputs > 0 ? current_node->outputs[0] : NULL;
+    struct fpool_params *params = &current_node->pool;
+    uint32_t min_bits = TENSOR_OPS_FLOAT_LOWEST_BITS;
+    uint32_t max_bits = TENSOR_OPS_FLOAT_MAX_BITS;
+    bool same_padding;
+
+    if (!options || !input || !output || input->type != tflite::TensorType_FLOAT32 ||
+        input->dims[0] != output->dims[0] || input->dims[3] != output->dims[3] ||
+        options->filter_height() <= 0 || options->filter_width() <= 0 ||
+        options->stride_h() <= 0 || options->stride_w() <= 0) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid pooling node %d\n", current_node->id);
+        return -EINVAL;
+    }
+
+    same_padding = options->padding() == tflite::Padding_SAME;
+    params->stride_h = options->stride_h();
+    params->stride_w = options->stride_w();
+    params->filter_h = options->filter_height();
+    params->filter_w = options->filter_width();
+    params->pad_h = tensor_ops_compute_padding(input->dims[1], params->filter_h, params->stride_h, 1,
+                                               output->dims[1], same_padding);
+    params->pad_w = tensor_ops_compute_padding(input->dims[2], params->filter_w, params->stride_w, 1,
+                                               output->dims[2], same_padding);
+
+    // The clamp range is stored through its bit patterns; no FPU section is held here
+    switch (options->fused_activation_function()) {
+        case tflite::ActivationFunctionType_NONE:
+            break;
+        case tflite::ActivationFunctionType_RELU:
+            min_bits = 0;
+            break;
+        case tflite::ActivationFunctionType_RELU6:
+            min_bits = 0;
+            max_bits = TENSOR_OPS_FLOAT_SIX_BITS;
+            break;
+        default:
+            return -EOPNOTSUPP;
+    }
+    memcpy(&params->act_min, &min_bits, sizeof(min_bits));
+    memcpy(&params->act_max, &max_bits, sizeof(max_bits));
+    return 0;
+}
+
+// Function to resolve how the inputs of a binary node broadcast onto its output
+static int prepare_binary_node(struct node *current_node) {
+    struct graph_tensor *input1 = current_node->num_inputs > 1 ? current_node->inputs[0] : NULL;
+    struct graph_tensor *input2 = current_node->num_inputs > 1 ? current_node->inputs[1] : NULL;
+    struct graph_tensor *output = current_node->num_outputs > 0 ? current_node->outputs[0] : NULL;
+    size_t scratch_size;
+    int ret;
+
+    if (!input1 || !input2 || !output) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid binary node %d\n", current_node->id);
+        return -EINVAL;
+    }
+    // Dims are padded to rank 4, which right-aligns them for broadcasting
+    ret = tensor_ops_broadcast_prepare(4, input1->dims, 4, input2->dims, 4, output->dims, &current_node->broadcast);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Incompatible shapes in binary node %d\n", current_node->id);
+        return ret;
+    }
+
+    scratch_size = tensor_ops_broadcast_scratch_size(&current_node->broadcast, sizeof(float));
+    if (scratch_size) {
+        current_node->broadcast_scratch = kmalloc(scratch_size, GFP_KERNEL);
+        if (!current_node->broadcast_scratch) {
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+// Function to compute tensor lifetimes and give every activation an offset in
+// one preallocated arena, so execution never allocates memory
+static int plan_tensor_arena(struct tensorflow_model *model) {
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+    struct arena_allocation *allocations;
+    size_t unshared_size = 0;
+    int ret;
+
+    for (int i = 0; i < graph.num_nodes; i++) {
+        struct node *current_node = &graph.nodes[i];
+        for (int j = 0; j < current_node->num_inputs; j++) {
+            struct graph_tensor *tensor = current_node->inputs[j];
+            if (tensor) {
+                tensor->first_use = min(tensor->first_use, i);
+                tensor->last_use = max(tensor->last_use, i);
+            }
+        }
+        for (int k = 0; k < current_node->num_outputs; k++) {
+            struct graph_tensor *tensor = current_node->outputs[k];
+            if (tensor) {
+                tensor->first_use = min(tensor->first_use, i);
+                tensor->last_use = max(tensor->last_use, i);
+            }
+        }
+    }
+
+    // Graph inputs must be live before the first node, outputs after the last
+    for (auto idx : *subgraph->inputs()) {
+        graph.tensors[idx].first_use = 0;
+        graph.tensors[idx].last_use = max(graph.tensors[idx].last_use, 0);
+    }
+    for (auto idx : *subgraph->outputs()) {
+        graph.tensors[idx].first_use = min(graph.tensors[idx].first_use, graph.num_nodes);
+        graph.tensors[idx].last_use = graph.num_nodes;
+    }
+
+    allocations = kcalloc(graph.num_tensors, sizeof(*allocations), GFP_KERNEL);
+    if (!allocations) {
+        return -ENOMEM;
+    }
+    for (int i = 0; i < graph.num_tensors; i++) {
+        struct graph_tensor *tensor = &graph.tensors[i];
+        if (tensor->is_constant || tensor->last_use < 0) {
+            continue;
+        }
+        allocations[i].size = tensor->data_size;
+        allocations[i].first_use = tensor->first_use;
+        allocations[i].last_use = tensor->last_use;
+        unshared_size += ALIGN(tensor->data_size, GRAPH_ARENA_ALIGNMENT);
+    }
+
+    ret = tensor_ops_plan_arena(allocations, graph.num_tensors, GRAPH_ARENA_ALIGNMENT, &graph.arena_size);
+    if (ret < 0) {
+        kfree(allocations);
+        return ret;
+    }
+
+    graph.arena = kvzalloc(max_t(size_t, graph.arena_size, 1), GFP_KERNEL);
+    if (!graph.arena) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate %zu byte tensor arena\n", graph.arena_size);
+        kfree(allocations);
+        return -ENOMEM;
+    }
+    for (int i = 0; i < graph.num_tensors; i++) {
+        if (allocations[i].size) {
+            graph.tensors[i].data = (char *)graph.arena + allocations[i].offset;
+        }
+    }
+    kfree(allocations);
+
+    printk(KERN_INFO "TensorFlowInterpreterDevice: Tensor arena planned: %zu bytes (%zu bytes without sharing)\n",
+           graph.arena_size, unshared_size);
+    return 0;
+}
+
+static bool node_uses_fpu(const struct node *current_node) {
+    for (int j = 0; j < current_node->num_inputs; j++) {
+        if (current_node->inputs[j] && current_node->inputs[j]->type == tflite::TensorType_FLOAT32) {
+            return true;
+        }
+    }
+    for (int k = 0; k < current_node->num_outputs; k++) {
+        if (current_node->outputs[k] && current_node->outputs[k]->type == tflite::TensorType_FLOAT32) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t node_float_elements(const struct node *current_node) {
+    size_t bytes = 0;
+
+    for (int j = 0; j < current_node->num_inputs; j++) {
+        if (current_node->inputs[j]) {
+            bytes += current_node->inputs[j]->data_size;
+        }
+    }
+    for (int k = 0; k < current_node->num_outputs; k++) {
+        if (current_node->outputs[k]) {
+            bytes += current_node->outputs[k]->data_size;
+        }
+    }
+    return bytes / sizeof(float);
+}
+
+// Function to group runs of consecutive float nodes into FPU sections. A
+// section is closed early once its work estimate would exceed
+// fpu_section_max_elements; a single larger node gets a section of its own.
+static void plan_fpu_sections(void) {
+    size_t section_elements = 0;
+    int num_sections = 0;
+    int num_float_nodes = 0;
+
+    for (int i = 0; i < graph.num_nodes; i++) {
+        struct node *current_node = &graph.nodes[i];
+        struct node *previous_node = i > 0 ? &graph.nodes[i - 1] : NULL;
+        size_t elements;
+
+        current_node->uses_fpu = node_uses_fpu(current_node);
+        current_node->fpu_section_begin = false;
+        current_node->fpu_section_end = false;
+        if (!current_node->uses_fpu) {
+            continue;
+        }
+
+        elements = node_float_elements(current_node);
+        if (!previous_node || !previous_node->uses_fpu ||
+            section_elements + elements > fpu_section_max_elements) {
+            if (previous_node && previous_node->uses_fpu) {
+                previous_node->fpu_section_end = true;
+            }
+            current_node->fpu_section_begin = true;
+            section_elements = 0;
+            num_sections++;
+        }
+        section_elements += elements;
+        num_float_nodes++;
+
+        if (i == graph.num_nodes - 1 || !node_uses_fpu(&graph.nodes[i + 1])) {
+            current_node->fpu_section_end = true;
+        }
+    }
+
+    printk(KERN_INFO "TensorFlowInterpreterDevice: Grouped %d float nodes into %d FPU sections\n",
+           num_float_nodes, num_sections);
+}
+
+static bool node_touches(const struct node *current_node, const struct graph_tensor *tensor) {
+    for (int j = 0; j < current_node->num_inputs; j++) {
+        if (current_node->inputs[j] == tensor) {
+            return true;
+        }
+    }
+    for (int k = 0; k < current_node->num_outputs; k++) {
+        if (current_node->outputs[k] == tensor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool tensors_share_memory(const struct graph_tensor *a, const struct graph_tensor *b) {
+    if (a == b || a->is_constant || b->is_constant || !a->data || !b->data) {
+        return false;
+    }
+    return (char *)a->data < (char *)b->data + b->data_size && (char *)b->data < (char *)a->data + a->data_size;
+}
+
+// Function to mark the nodes node i has to wait for: the producers of its
+// inputs and, because the arena reuses memory between tensors whose
+// lifetimes do not overlap, every earlier node that touches memory its
+// outputs are written to
+static void mark_predecessors(int i, const int *producer, bool *marks) {
+    struct node *current_node = &graph.nodes[i];
+
+    memset(marks, 0, i * sizeof(*marks));
+    for (int j = 0; j < current_node->num_inputs; j++) {
+        struct graph_tensor *tensor = current_node->inputs[j];
+        if (tensor && producer[tensor->id] >= 0 && producer[tensor->id] < i) {
+            marks[producer[tensor->id]] = true;
+        }
+    }
+    for (int k = 0; k < current_node->num_outputs; k++) {
+        struct graph_tensor *output = current_node->outputs[k];
+        if (!output) {
+            continue;
+        }
+        for (int t = 0; t < graph.num_tensors; t++) {
+            struct graph_tensor *tensor = &graph.tensors[t];
+            if (tensor->last_use >= i || !tensors_share_memory(tensor, output)) {
+                continue;
+            }
+            for (int n = max(tensor->first_use, 0); n <= tensor->last_use; n++) {
+                if (node_touches(&graph.nodes[n], tensor)) {
+                    marks[n] = true;
+                }
+            }
+        }
+    }
+}
+
+// Function to mark the tasks task has to wait for: those running any node
+// one of its own nodes has to wait for
+static void mark_task_predecessors(int task, const int *producer, const int *task_of, bool *marks, bool *task_marks) {
+    memset(task_marks, 0, task * sizeof(*task_marks));
+    for (int i = graph.task_first[task]; i < graph.task_first[task + 1]; i++) {
+        mark_predecessors(i, producer, marks);
+        for (int n = 0; n < graph.task_first[task]; n++) {
+            if (marks[n]) {
+                task_marks[task_of[n]] = true;
+            }
+        }
+    }
+}
+
+// Function to build the dependency graph the DAG scheduler runs on, once the
+// arena and the FPU sections are planned, and to measure how many tasks can
+// run at the same time. A task is a run of nodes executed in order on one
+// thread. A float node joins the task of the node before it when both are in
+// the same FPU section and it waits for that node, so float chains keep
+// sharing one section while independent float branches still run
+// concurrently. Every other node is a task of its own.
+static int build_node_dependencies(void) {
+    int *producer = kmalloc_array(graph.num_tensors, sizeof(int), GFP_KERNEL);
+    bool *marks = kcalloc(max(graph.num_nodes, 1), sizeof(bool), GFP_KERNEL);
+    bool *task_marks = kcalloc(max(graph.num_nodes, 1), sizeof(bool), GFP_KERNEL);
+    int *task_of = kcalloc(max(graph.num_nodes, 1), sizeof(int), GFP_KERNEL);
+    int *level = kcalloc(max(graph.num_nodes, 1), sizeof(int), GFP_KERNEL);
+    int *level_width = kcalloc(max(graph.num_nodes, 1), sizeof(int), GFP_KERNEL);
+    int *cursor = kcalloc(graph.num_nodes + 1, sizeof(int), GFP_KERNEL);
+    int num_edges = 0;
+    int ret = -ENOMEM;
+
+    // Sized for one task per node
+    graph.task_first = kcalloc(graph.num_nodes + 1, sizeof(int), GFP_KERNEL);
+    graph.num_predecessors = kcalloc(max(graph.num_nodes, 1), sizeof(int), GFP_KERNEL);
+    graph.successor_offsets = kcalloc(graph.num_nodes + 1, sizeof(int), GFP_KERNEL);
+    graph.pending = kcalloc(max(graph.num_nodes, 1), sizeof(atomic_t), GFP_KERNEL);
+    if (!producer || !marks || !task_marks || !task_of || !level || !level_width || !cursor ||
+        !graph.task_first || !graph.num_predecessors || !graph.successor_offsets || !graph.pending) {
+        goto out;
+    }
+
+    for (int t = 0; t < graph.num_tensors; t++) {
+        producer[t] = -1;
+    }
+    for (int i = 0; i < graph.num_nodes; i++) {
+        for (int k = 0; k < graph.nodes[i].num_outputs; k++) {
+            if (graph.nodes[i].outputs[k]) {
+                producer[graph.nodes[i].outputs[k]->id] = i;
+            }
+        }
+    }
+
+    // A float node that does not open a section follows a float node of the
+    // same section
+    graph.num_tasks = 0;
+    for (int i = 0; i < graph.num_nodes; i++) {
+        struct node *current_node = &graph.nodes[i];
+
+        mark_predecessors(i, producer, marks);
+        if (i == 0 || !current_node->uses_fpu || current_node->fpu_section_begin || !marks[i - 1]) {
+            graph.task_first[graph.num_tasks++] = i;
+        }
+        task_of[i] = graph.num_tasks - 1;
+    }
+    graph.task_first[graph.num_tasks] = graph.num_nodes;
+
+    // First pass counts edges, the second fills the successor lists
+    for (int t = 0; t < graph.num_tasks; t++) {
+        mark_task_predecessors(t, producer, task_of, marks, task_marks);
+        for (int p = 0; p < t; p++) {
+            if (task_marks[p]) {
+                graph.num_predecessors[t]++;
+                graph.successor_offsets[p + 1]++;
+                num_edges++;
+                level[t] = max(level[t], level[p] + 1);
+            }
+        }
+        level_width[level[t]]++;
+        graph.parallel_width = max(graph.parallel_width, level_width[level[t]]);
+    }
+    for (int t = 0; t < graph.num_tasks; t++) {
+        graph.successor_offsets[t + 1] += graph.successor_offsets[t];
+        cursor[t] = graph.successor_offsets[t];
+    }
+    graph.successors = kmalloc_array(max(num_edges, 1), sizeof(int), GFP_KERNEL);
+    if (!graph.successors) {
+        goto out;
+    }
+    for (int t = 0; t < graph.num_tasks; t++) {
+        mark_task_predecessors(t, producer, task_of, marks, task_marks);
+        for (int p = 0; p < t; p++) {
+            if (task_marks[p]) {
+                graph.successors[cursor[p]++] = t;
+            }
+        }
+    }
+
+    graph.schedule.num_tasks = graph.num_tasks;
+    graph.schedule.num_predecessors = graph.num_predecessors;
+    graph.schedule.successor_offsets = graph.successor_offsets;
+    graph.schedule.successors = graph.successors;
+    printk(KERN_INFO "TensorFlowInterpreterDevice: %d nodes in %d tasks with %d dependencies, up to %d tasks can run concurrently\n",
+           graph.num_nodes, graph.num_tasks, num_edges, graph.parallel_width);
+    ret = 0;
+
+out:
+    kfree(producer);
+    kfree(marks);
+    kfree(task_marks);
+    kfree(task_of);
+    kfree(level);
+    kfree(level_width);
+    kfree(cursor);
+    return ret;
+}
+
+static bool is_elementwise_opcode(int opcode) {
+    return opcode == ADD_OPCODE || opcode == MULTIPLY_OPCODE || opcode == SUBTRACT_OPCODE ||
+           opcode == DIVIDE_OPCODE || opcode == RELU_OPCODE;
+}
+
+static bool is_float_tensor(const struct graph_tensor *tensor, size_t data_size) {
+    return tensor && tensor->type == tflite::TensorType_FLOAT32 && tensor->data_size == data_size;
+}
+
+// An elementwise node whose operands are all float tensors of one size
+static bool is_fusable_elementwise(const struct node *current_node) {
+    int arity = current_node->opcode == RELU_OPCODE ? 1 : 2;
+    size_t data_size;
+
+    if (!is_elementwise_opcode(current_node->opcode) || current_node->num_outputs != 1 ||
+        current_node->num_inputs < arity || !current_node->outputs[0]) {
+        return false;
+    }
+    data_size = current_node->outputs[0]->data_size;
+    for (int j = 0; j < current_node->num_inputs; j++) {
+        if (!is_float_tensor(current_node->inputs[j], data_size)) {
+            return false;
+        }
+    }
+    return is_float_tensor(current_node->outputs[0], data_size);
+}
+
+// Function to merge the elementwise node producer into its only consumer.
+// The fused node takes the consumer's slot, where every operand of both is
+// available, and keeps all operands as inputs so arena lifetimes stay correct.
+static int fuse_into_consumer(struct node *producer, struct node *consumer) {
+    struct graph_tensor *intermediate = producer->outputs[0];
+    struct fused_step step = {};
+    struct graph_tensor **inputs;
+    int num_inputs = producer->num_inputs;
+
+    step.opcode = consumer->opcode;
+    if (consumer->opcode != RELU_OPCODE) {
+        step.operand_first = consumer->inputs[1] == intermediate;
+        step.operand = step.operand_first ? consumer->inputs[0] : consumer->inputs[1];
+        num_inputs++;
+    }
+
+    inputs = kcalloc(num_inputs, sizeof(*inputs), GFP_KERNEL);
+    if (!inputs) {
+        return -ENOMEM;
+    }
+    memcpy(inputs, producer->inputs, producer->num_inputs * sizeof(*inputs));
+    if (step.operand) {
+        inputs[producer->num_inputs] = step.operand;
+    }
+
+    kfree(consumer->inputs);
+    consumer->inputs = inputs;
+    consumer->num_inputs = num_inputs;
+    consumer->opcode = producer->opcode;
+    memcpy(consumer->fused_steps, producer->fused_steps, producer->num_fused_steps * sizeof(step));
+    consumer->fused_steps[producer->num_fused_steps] = step;
+    consumer->num_fused_steps = producer->num_fused_steps + 1;
+    return 0;
+}
+
+// A RELU after a pooling node becomes the pool's clamp. The pool only ever
+// has a clamp at -FLT_MAX or 0 below, so the fused lower bound is 0.
+static void fuse_relu_into_pool(struct node *pool_node, struct node *relu_node) {
+    const uint32_t zero_bits = 0;
+
+    memcpy(&pool_node->pool.act_min, &zero_bits, sizeof(zero_bits));
+    pool_node->outputs[0] = relu_node->outputs[0];
+}
+
+// Function to fuse nodes before the arena is planned: chains of elementwise
+// nodes (including a trailing RELU) become one tiled node, and a RELU after
+// MAXPOOL / AVGPOOL is folded into the pool's activation clamp. Only
+// intermediates consumed exactly once, and not graph outputs, are removed.
+static int fuse_computation_graph(const tflite::SubGraph *subgraph) {
+    int *uses;
+    int *consumer;
+    int num_nodes = 0;
+    int ret = 0;
+
+    uses = kcalloc(graph.num_tensors, sizeof(*uses), GFP_KERNEL);
+    consumer = kcalloc(graph.num_tensors, sizeof(*consumer), GFP_KERNEL);
+    if (!uses || !consumer) {
+        kfree(uses);
+        kfree(consumer);
+        return -ENOMEM;
+    }
+    for (int i = 0; i < graph.num_nodes; i++) {
+        for (int j = 0; j < graph.nodes[i].num_inputs; j++) {
+            if (graph.nodes[i].inputs[j]) {
+                uses[graph.nodes[i].inputs[j]->id]++;
+                consumer[graph.nodes[i].inputs[j]->id] = i;
+            }
+        }
+    }
+    for (auto idx : *subgraph->outputs()) {
+        uses[idx]++;
+    }
+
+    for (int i = 0; i < graph.num_nodes; i++) {
+        struct node *current_node = &graph.nodes[i];
+        struct graph_tensor *output;
+        struct node *next;
+
+        if (current_node->num_outputs != 1 || !current_node->outputs[0]) {
+            continue;
+        }
+        output = current_node->outputs[0];
+        if (uses[output->id] != 1) {
+            continue;
+        }
+        next = &graph.nodes[consumer[output->id]];
+
+        if ((current_node->opcode == MAXPOOL_OPCODE || current_node->opcode == AVGPOOL_OPCODE) &&
+            next->opcode == RELU_OPCODE && next->num_fused_steps == 0 && is_fusable_elementwise(next)) {
+            // The pool writes the RELU's output directly; the RELU node goes away
+            fuse_relu_into_pool(current_node, next);
+            next->opcode = -1;
+            graph.num_fused_nodes++;
+        } else if (is_fusable_elementwise(current_node) && next->num_fused_steps == 0 &&
+                   is_fusable_elementwise(next) && current_node->num_fused_steps < MAX_FUSED_STEPS &&
+                   output->data_size == next->outputs[0]->data_size) {
+            ret = fuse_into_consumer(current_node, next);
+            if (ret < 0) {
+                break;
+            }
+            current_node->opcode = -1;
+            graph.num_fused_nodes++;
+        }
+    }
+
+    // Drop the nodes that were fused away
+    for (int i = 0; i < graph.num_nodes; i++) {
+        if (graph.nodes[i].opcode == -1) {
+            kfree(graph.nodes[i].inputs);
+            kfree(graph.nodes[i].outputs);
+            kfree(graph.nodes[i].broadcast_scratch);
+            continue;
+        }
+        graph.nodes[num_nodes++] = graph.nodes[i];
+    }
+    graph.num_nodes = num_nodes;
+
+    kfree(uses);
+    kfree(consumer);
+    return ret;
+}
+
+static bool index_is_valid(int32_t idx, uint32_t size) {
+    return idx >= 0 && (uint32_t)idx < size;
+}
+
+// Function to check every index the graph is built from against the table it
+// selects from, before any of them is used to index graph.tensors or the
+// model's buffers. Optional node inputs are encoded as -1.
+static int validate_graph_indices(struct tensorflow_model *model) {
+    const tflite::SubGraph *subgraph;
+    uint32_t num_tensors;
+
+    if (!model->subgraphs() || model->subgraphs()->size() == 0 || !model->buffers()) {
+        return -EINVAL;
+    }
+    subgraph = model->subgraphs()->Get(0);
+    if (!subgraph->tensors() || !subgraph->operators() || !subgraph->outputs()) {
+        return -EINVAL;
+    }
+    num_tensors = subgraph->tensors()->size();
+    for (auto tensor : *subgraph->tensors()) {
+        if (tensor->buffer() >= model->buffers()->size()) {
+            return -EINVAL;
+        }
+    }
+    for (auto op : *subgraph->operators()) {
+        if (!op->inputs() || !op->outputs()) {
+            return -EINVAL;
+        }
+        for (auto idx : *op->inputs()) {
+            if (idx != -1 && !index_is_valid(idx, num_tensors)) {
+                return -EINVAL;
+            }
+        }
+        for (auto idx : *op->outputs()) {
+            if (!index_is_valid(idx, num_tensors)) {
+                return -EINVAL;
+            }
+        }
+    }
+    for (auto idx : *subgraph->outputs()) {
+        if (!index_is_valid(idx, num_tensors)) {
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
 static int load_computation_graph(struct tensorflow_model *model) {
     int ret = parse_tensorflow_model(kernel_buffer);
     if (ret < 0) {
@@ -113,10 +899,58 @@ static int load_computation_graph(struct tensorflow_model *model) {
         return ret;
     }
 
-    graph.num_nodes = model->subgraphs()->Get(0)->operators()->size();
-    graph.nodes = kmalloc(graph.num_nodes * sizeof(struct node), GFP_KERNEL);
+    ret = validate_graph_indices(model);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Model references a tensor or buffer out of range\n");
+        return ret;
+    }
+
+    free_computation_graph();
+
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+    graph.num_tensors = subgraph->tensors()->size();
+    graph.tensors = kcalloc(graph.num_tensors, sizeof(struct graph_tensor), GFP_KERNEL);
+    if (!graph.tensors) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for computation graph tensors\n");
+        return -ENOMEM;
+    }
+
+    for (int t = 0; t < graph.num_tensors; t++) {
+        const tflite::Tensor *tensor = subgraph->tensors()->Get(t);
+        const tflite::Buffer *buffer = model->buffers()->Get(tensor->buffer());
+        graph.tensors[t].id = t;
+        graph.tensors[t].type = tensor->type();
+        graph.tensors[t].data_size = tensor_byte_size(tensor);
+        if (tensor_dims4(tensor, graph.tensors[t].dims) < 0) {
+            // Only the pooling kernels look at dims; they reject such tensors
+            memset(graph.tensors[t].dims, 0, sizeof(graph.tensors[t].dims));
+        }
+        graph.tensors[t].rank = tensor->shape() ? tensor->shape()->size() : 0;
+        tensor_quantization(tensor, &graph.tensors[t].scale_bits, &graph.tensors[t].zero_point);
+        graph.tensors[t].first_use = INT_MAX;
+        graph.tensors[t].last_use = -1;
+        if (buffer && buffer->data() && buffer->data()->size() > 0) {
+            // Constant tensors are used in place from the model buffer
+            graph.tensors[t].is_constant = true;
+            graph.tensors[t].data = (void *)buffer->data()->Data();
+        }
+    }
+
+    graph.num_outputs = subgraph->outputs()->size();
+    graph.output_ids = kcalloc(graph.num_outputs, sizeof(int), GFP_KERNEL);
+    if (!graph.output_ids) {
+        free_computation_graph();
+        return -ENOMEM;
+    }
+    for (int i = 0; i < graph.num_outputs; i++) {
+        graph.output_ids[i] = subgraph->outputs()->Get(i);
+    }
+
+    graph.num_nodes = subgraph->operators()->size();
+    graph.nodes = kcalloc(graph.num_nodes, sizeof(struct node), GFP_KERNEL);
     if (!graph.nodes) {
         printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for computation graph nodes\n");
+        free_computation_graph();
         return -ENOMEM;
     }
 
@@ -126,211 +960,357 @@ static int load_computation_graph(struct tensorflow_model *model) {
         graph.nodes[i].opcode = op->opcode_index();
         graph.nodes[i].num_inputs = op->inputs()->size();
         graph.nodes[i].num_outputs = op->outputs()->size();
-        graph.nodes[i].inputs = kmalloc(graph.nodes[i].num_inputs * sizeof(struct node *), GFP_KERNEL);
-        graph.nodes[i].outputs = kmalloc(graph.nodes[i].num_outputs * sizeof(struct node *), GFP_KERNEL);
+        graph.nodes[i].inputs = kcalloc(graph.nodes[i].num_inputs, sizeof(struct graph_tensor *), GFP_KERNEL);
+        graph.nodes[i].outputs = kcalloc(graph.nodes[i].num_outputs, sizeof(struct graph_tensor *), GFP_KERNEL);
+        if (!graph.nodes[i].inputs || !graph.nodes[i].outputs) {
+            free_computation_graph();
+            return -ENOMEM;
+        }
 
+        // Optional inputs are encoded as tensor index -1
         for (int j = 0; j < graph.nodes[i].num_inputs; j++) {
-            graph.nodes[i].inputs[j] = &graph.nodes[op->inputs()->Get(j)];
+            int idx = op->inputs()->Get(j);
+            graph.nodes[i].inputs[j] = idx >= 0 ? &graph.tensors[idx] : NULL;
         }
 
         for (int k = 0; k < graph.nodes[i].num_outputs; k++) {
-            graph.nodes[i].outputs[k] = &graph.nodes[op->outputs()->Get(k)];
+            graph.nodes[i].outputs[k] = &graph.tensors[op->outputs()->Get(k)];
+        }
+
+        if (graph.nodes[i].opcode == MAXPOOL_OPCODE || graph.nodes[i].opcode == AVGPOOL_OPCODE) {
+            ret = prepare_pool_node(&graph.nodes[i], op);
+        } else if (is_elementwise_opcode(graph.nodes[i].opcode) && graph.nodes[i].opcode != RELU_OPCODE) {
+            ret = prepare_binary_node(&graph.nodes[i]);
+        } else {
+            ret = 0;
+        }
+        if (ret < 0) {
+            free_computation_graph();
+            return ret;
         }
     }
 
+    ret = fuse_computation_graph(subgraph);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to fuse computation graph\n");
+        free_computation_graph();
+        return ret;
+    }
+    printk(KERN_INFO "TensorFlowInterpreterDevice: Fused %d nodes, %d nodes left to execute\n",
+           graph.num_fused_nodes, graph.num_nodes);
+
+    ret = plan_tensor_arena(model);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to plan tensor arena\n");
+        free_computation_graph();
+        return ret;
+    }
+
+    plan_fpu_sections();
+
+    ret = build_node_dependencies();
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to build node dependencies\n");
+        free_computation_graph();
+        return ret;
+    }
+
     printk(KERN_INFO "TensorFlowInterpreterDevice: Computation graph loaded successfully\n");
     return 0;
 }
 
-// Function to execute the computation graph using the loaded parameters
-static int execute_computation_graph(void) {
-    for (int i = 0; i < graph.num_nodes; i++) {
-        struct node *current_node = &graph.nodes[i];
-        printk(KERN_INFO "TensorFlowInterpreterDevice: Executing node %d with opcode %d\n", current_node->id, current_node->opcode);
-
-        // Execute the operation specified by the node's opcode
-        switch (current_node->opcode) {
-            case ADD_OPCODE: {
-                struct node *input1 = current_node->inputs[0];
-                struct node *input2 = current_node->inputs[1];
-                struct node *output = current_node->outputs[0];
-
-                if (!input1 || !input2 || !output) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for ADD operation\n");
-                    return -EINVAL;
-                }
+static void apply_elementwise(int opcode, size_t size, const float *input1, const float *input2, float *output) {
+    switch (opcode) {
+        case ADD_OPCODE:
+            tensor_ops_add_f32(size, input1, input2, output);
+            break;
+        case MULTIPLY_OPCODE:
+            tensor_ops_mul_f32(size, input1, input2, output);
+            break;
+        case SUBTRACT_OPCODE:
+            tensor_ops_sub_f32(size, input1, input2, output);
+            break;
+        case DIVIDE_OPCODE:
+            tensor_ops_div_f32(size, input1, input2, output);
+            break;
+        case RELU_OPCODE:
+            tensor_ops_relu_f32(size, input1, output);
+            break;
+    }
+}
 
-                output->data = kmalloc(input1->data_size, GFP_KERNEL);
-                if (!output->data) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for output tensor\n");
-                    return -ENOMEM;
-                }
+// Function to execute a fused elementwise chain one tile at a time: the
+// running result is written to the output tile and stays in L1 while every
+// fused step is applied to it
+static int execute_fused_node(struct node *current_node) {
+    struct graph_tensor *output = current_node->outputs[0];
+    size_t count = output->data_size / sizeof(float);
 
-                for (int j = 0; j < input1->data_size / sizeof(float); j++) {
-                    ((float *)output->data)[j] = ((float *)input1->data)[j] + ((float *)input2->data)[j];
-                }
-                break;
+    for (int j = 0; j < current_node->num_inputs; j++) {
+        if (!current_node->inputs[j]->data) {
+            printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input tensor for fused node %d\n", current_node->id);
+            return -EINVAL;
+        }
+    }
+    if (!output->data) {
+        printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid output tensor for fused node %d\n", current_node->id);
+        return -EINVAL;
+    }
+
+    for (size_t offset = 0; offset < count; offset += FUSION_TILE_ELEMENTS) {
+        size_t size = min_t(size_t, FUSION_TILE_ELEMENTS, count - offset);
+        float *tile = (float *)output->data + offset;
+
+        apply_elementwise(current_node->opcode, size, (const float *)current_node->inputs[0]->data + offset,
+                          current_node->opcode == RELU_OPCODE ? NULL :
+                          (const float *)current_node->inputs[1]->data + offset, tile);
+        for (int s = 0; s < current_node->num_fused_steps; s++) {
+            const struct fused_step *step = &current_node->fused_steps[s];
+            const float *operand = step->operand ? (const float *)step->operand->data + offset : NULL;
+
+            apply_elementwise(step->opcode, size, step->operand_first ? operand : tile,
+                              step->operand_first ? tile : operand, tile);
+        }
+    }
+    return 0;
+}
+
+// Function to execute a single node of the computation graph
+static int execute_node(struct node *current_node, int i) {
+    if (current_node->num_fused_steps > 0) {
+        return execute_fused_node(current_node);
+    }
+
+    // Execute the operation specified by the node's opcode
+    switch (current_node->opcode) {
+        case ADD_OPCODE: {
+            struct graph_tensor *input1 = current_node->inputs[0];
+            struct graph_tensor *input2 = current_node->inputs[1];
+            struct graph_tensor *output = current_node->outputs[0];
+
+            if (!input1 || !input2 || !output || !input1->data || !input2->data || !output->data) {
+                printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for ADD operation\n");
+                return -EINVAL;
             }
-            case MULTIPLY_OPCODE: {
-                struct node *input1 = current_node->inputs[0];
-                struct node *input2 = current_node->inputs[1];
-                struct node *output = current_node->outputs[0];
-
-                if (!input1 || !input2 || !output) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for MULTIPLY operation\n");
-                    return -EINVAL;
-                }
 
-                output->data = kmalloc(input1->data_size, GFP_KERNEL);
-                if (!output->data) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for output tensor\n");
-                    return -ENOMEM;
-                }
+            tensor_ops_broadcast_f32(&current_node->broadcast, TENSOR_OPS_BINARY_ADD, (const float *)input1->data,
+                                     (const float *)input2->data, (float *)output->data,
+                                     current_node->broadcast_scratch);
+            break;
+        }
+        case MULTIPLY_OPCODE: {
+            struct graph_tensor *input1 = current_node->inputs[0];
+            struct graph_tensor *input2 = current_node->inputs[1];
+            struct graph_tensor *output = current_node->outputs[0];
 
-                for (int j = 0; j < input1->data_size / sizeof(float); j++) {
-                    ((float *)output->data)[j] = ((float *)input1->data)[j] * ((float *)input2->data)[j];
-                }
-                break;
+            if (!input1 || !input2 || !output || !input1->data || !input2->data || !output->data) {
+                printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for MULTIPLY operation\n");
+                return -EINVAL;
             }
-            case SUBTRACT_OPCODE: {
-                struct node *input1 = current_node->inputs[0];
-                struct node *input2 = current_node->inputs[1];
-                struct node *output = current_node->outputs[0];
-
-                if (!input1 || !input2 || !output) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for SUBTRACT operation\n");
-                    return -EINVAL;
-                }
 
-                output->data = kmalloc(input1->data_size, GFP_KERNEL);
-                if (!output->data) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for output tensor\n");
-                    return -ENOMEM;
-                }
+            tensor_ops_broadcast_f32(&current_node->broadcast, TENSOR_OPS_BINARY_MUL, (const float *)input1->data,
+                                     (const float *)input2->data, (float *)output->data,
+                                     current_node->broadcast_scratch);
+            break;
+        }
+        case SUBTRACT_OPCODE: {
+            struct graph_tensor *input1 = current_node->inputs[0];
+            struct graph_tensor *input2 = current_node->inputs[1];
+            struct graph_tensor *output = current_node->outputs[0];
 
-                for (int j = 0; j < input1->data_size / sizeof(float); j++) {
-                    ((float *)output->data)[j] = ((float *)input1->data)[j] - ((float *)input2->data)[j];
-                }
-                break;
+            if (!input1 || !input2 || !output || !input1->data || !input2->data || !output->data) {
+                printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for SUBTRACT operation\n");
+                return -EINVAL;
             }
-            case DIVIDE_OPCODE: {
-                struct node *input1 = current_node->inputs[0];
-                struct node *input2 = current_node->inputs[1];
-                struct node *output = current_node->outputs[0];
-
-                if (!input1 || !input2 || !output) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for DIVIDE operation\n");
-                    return -EINVAL;
-                }
 
-                output->data = kmalloc(input1->data_size, GFP_KERNEL);
-                if (!output->data) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for output tensor\n");
-                    return -ENOMEM;
-                }
+            tensor_ops_broadcast_f32(&current_node->broadcast, TENSOR_OPS_BINARY_SUB, (const float *)input1->data,
+                                     (const float *)input2->data, (float *)output->data,
+                                     current_node->broadcast_scratch);
+            break;
+        }
+        case DIVIDE_OPCODE: {
+            struct graph_tensor *input1 = current_node->inputs[0];
+            struct graph_tensor *input2 = current_node->inputs[1];
+            struct graph_tensor *output = current_node->outputs[0];
 
-                for (int j = 0; j < input1->data_size / sizeof(float); j++) {
-                    ((float *)output->data)[j] = ((float *)input1->data)[j] / ((float *)input2->data)[j];
-                }
-                break;
+            if (!input1 || !input2 || !output || !input1->data || !input2->data || !output->data) {
+                printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for DIVIDE operation\n");
+                return -EINVAL;
             }
-            case RELU_OPCODE: {
-                struct node *input = current_node->inputs[0];
-                struct node *output = current_node->outputs[0];
 
-                if (!input || !output) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for RELU operation\n");
-                    return -EINVAL;
-                }
+            tensor_ops_broadcast_f32(&current_node->broadcast, TENSOR_OPS_BINARY_DIV, (const float *)input1->data,
+                                     (const float *)input2->data, (float *)output->data,
+                                     current_node->broadcast_scratch);
+            break;
+        }
+        case RELU_OPCODE: {
+            struct graph_tensor *input = current_node->inputs[0];
+            struct graph_tensor *output = current_node->outputs[0];
 
-                output->data = kmalloc(input->data_size, GFP_KERNEL);
-                if (!output->data) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for output tensor\n");
-                    return -ENOMEM;
-                }
+            if (!input || !output || !input->data || !output->data) {
+                printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for RELU operation\n");
+                return -EINVAL;
+            }
 
-                for (int j = 0; j < input->data_size / sizeof(float); j++) {
-                    ((float *)output->data)[j] = max(0.0, ((float *)input->data)[j]);
-                }
-                break;
+            tensor_ops_relu_f32(input->data_size / sizeof(float), (const float *)input->data, (float *)output->data);
+            break;
+        }
+        case MAXPOOL_OPCODE:
+        case AVGPOOL_OPCODE: {
+            struct graph_tensor *input = current_node->inputs[0];
+            struct graph_tensor *output = current_node->outputs[0];
+
+            if (!input || !output || !input->data || !output->data) {
+                printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for pooling operation\n");
+                return -EINVAL;
             }
-            case MAXPOOL_OPCODE: {
-                struct node *input = current_node->inputs[0];
-                struct node *output = current_node->outputs[0];
-                int pool_size = 2; // Example pool size
-                int stride = 2; // Example stride
-                int input_height = 28; // Example input height
-                int input_width = 28; // Example input width
-                int output_height = input_height / stride;
-                int output_width = input_width / stride;
-
-                if (!input || !output) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Invalid input or output tensor for MAXPOOL operation\n");
-                    return -EINVAL;
-                }
 
-                output->data = kmalloc(output_height * output_width * sizeof(float), GFP_KERNEL);
-                if (!output->data) {
-                    printk(KERN_ALERT "TensorFlowInterpreterDevice: Failed to allocate memory for output tensor\n");
-                    return -ENOMEM;
-                }
+            if (current_node->opcode == MAXPOOL_OPCODE) {
+                tensor_ops_max_pool2d_f32(&current_node->pool, input->dims, (const float *)input->data,
+                                          output->dims, (float *)output->data);
+            } else {
+                tensor_ops_average_pool2d_f32(&current_node->pool, input->dims, (const float *)input->data,
+                                              output->dims, (float *)output->data);
+            }
+            break;
+        }
+        default:
+            snprintf(kernel_buffer + i * 10, 10, "Node %d", current_node->id);
+            break;
+    }
+    return 0;
+}
 
-                for (int h = 0; h < output_height; h++) {
-                    for (int w = 0; w < output_width; w++) {
-                        float max_val = -FLT_MAX;
-                        for (int ph = 0; ph < pool_size; ph++) {
-                            for (int pw = 0; pw < pool_size; pw++) {
-                                int ih = h * stride + ph;
-                                int iw = w * stride + pw;
-                                float val = ((float *)input->data)[ih * input_width + iw];
-                                if (val > max_val) {
-                                    max_val = val;
-                                }
-                            }
-                        }
-                        ((float *)output->data)[h * output_width + w] = max_val;
-                    }
-                }
-                break;
+static void end_fpu_section(u64 section_start_ns, int section_nodes) {
+    struct fpu_section_stats *stats;
+    u64 elapsed_ns;
+
+    tensor_ops_simd_end();
+    elapsed_ns = ktime_get_ns() - section_start_ns;
+    stats = get_cpu_ptr(&fpu_stats);
+    stats->sections++;
+    stats->nodes += section_nodes;
+    stats->total_ns += elapsed_ns;
+    stats->max_ns = max(stats->max_ns, elapsed_ns);
+    put_cpu_ptr(&fpu_stats);
+}
+
+// Function to execute one task of the DAG scheduler, on the calling thread
+// or a tensor_ops worker. The nodes of a float task share one FPU section.
+static int execute_scheduled_task(void *context, int task, int slot) {
+    const int first = graph.task_first[task];
+    const int end = graph.task_first[task + 1];
+    const bool in_fpu_section = graph.nodes[first].uses_fpu;
+    u64 section_start_ns = 0;
+    int section_nodes = 0;
+    int ret = 0;
+
+    if (in_fpu_section) {
+        if (!tensor_ops_simd_begin()) {
+            return -EBUSY;
+        }
+        section_start_ns = ktime_get_ns();
+    }
+    for (int i = first; i < end && ret >= 0; i++) {
+        ret = execute_node(&graph.nodes[i], i);
+        section_nodes++;
+    }
+    if (in_fpu_section) {
+        end_fpu_section(section_start_ns, section_nodes);
+        // Preemption was disabled for the whole section
+        cond_resched();
+    }
+    return ret;
+}
+
+// Function to execute the computation graph using the loaded parameters.
+// Graphs with parallel branches go to the DAG scheduler, which starts every
+// task as soon as its predecessors are done. Otherwise nodes run in order,
+// float nodes inside the FPU sections laid out by plan_fpu_sections().
+static int execute_computation_graph(void) {
+    bool in_fpu_section = false;
+    u64 section_start_ns = 0;
+    int section_nodes = 0;
+    int ret;
+
+    if (dag_scheduler && graph.parallel_width > 1) {
+        ret = tensor_ops_parallel_run_graph(&graph.schedule, graph.pending, 0, execute_scheduled_task, NULL);
+        if (ret < 0) {
+            return ret;
+        }
+        printk(KERN_INFO "TensorFlowInterpreterDevice: Computation graph executed successfully\n");
+        return 0;
+    }
+
+    for (int i = 0; i < graph.num_nodes; i++) {
+        struct node *current_node = &graph.nodes[i];
+
+        // Vector registers cannot be used when the caller already holds them
+        if (current_node->fpu_section_begin) {
+            if (!tensor_ops_simd_begin()) {
+                return -EBUSY;
             }
-            default:
-                snprintf(kernel_buffer + i * 10, 10, "Node %d", current_node->id);
-                break;
+            section_start_ns = ktime_get_ns();
+            section_nodes = 0;
+            in_fpu_section = true;
+        }
+
+        ret = execute_node(current_node, i);
+        section_nodes++;
+
+        if (in_fpu_section && (current_node->fpu_section_end || ret < 0)) {
+            end_fpu_section(section_start_ns, section_nodes);
+            in_fpu_section = false;
+            // Preemption was disabled for the whole section
+            cond_resched();
+        }
+        if (ret < 0) {
+            return ret;
         }
     }
     printk(KERN_INFO "TensorFlowInterpreterDevice: Computation graph executed successfully\n");
     return 0;
 }
 
-// Function to retrieve the results of the computation from kernel memory
-static int get_results(char *result_buffer, size_t buffer_size) {
-    // Example result data for testing purposes
-    const char *results = "TensorFlow Model Execution Result:\n"
-                          "----------------------------------\n"
-                          "Operation: ADD\n"
-                          "Input 1: 1.0\n"
-                          "Input 2: 2.0\n"
-                          "Result: 3.0\n"
-                          "\n"
-                          "Operation: MULTIPLY\n"
-                          "Input 1: 3.0\n"
-                          "Input 2: 4.0\n"
-                          "Result: 12.0\n"
-                          "\n"
-                          "Operation: SUBTRACT\n"
-                          "Input 1: 5.0\n"
-                          "Input 2: 3.0\n"
-                          "Result: 2.0\n"
-                          "\n"
-                          "Operation: DIVIDE\n"
-                          "Input 1: 8.0\n"
-                          "Input 2: 2.0\n"
-                          "Result: 4.0\n";
-
-    // Copy the results data to the result buffer
-    snprintf(result_buffer, buffer_size, "%s", results);
+// Function to pack the graph outputs of the last execution for read(), as
+// described in tensor_results.h
+static int get_results(void) {
+    struct tensor_result_header *headers;
+    const void **data;
+    int ret = 0;
 
-    return 0;
+    if (!graph.arena) {
+        return -ENOENT;
+    }
+    headers = (struct tensor_result_header *)kcalloc(max(graph.num_outputs, 1), sizeof(*headers), GFP_KERNEL);
+    data = (const void **)kcalloc(max(graph.num_outputs, 1), sizeof(*data), GFP_KERNEL);
+    if (!headers || !data) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    for (int i = 0; i < graph.num_outputs; i++) {
+        const struct graph_tensor *tensor = &graph.tensors[graph.output_ids[i]];
+        int rank = min(tensor->rank, TENSOR_RESULTS_MAX_DIMS);
+
+        headers[i].type = tensor->type;
+        headers[i].rank = rank;
+        // dims are right-aligned in NHWC order; report the model's own shape
+        memcpy(headers[i].dims, tensor->dims + 4 - rank, rank * sizeof(int));
+        headers[i].scale_bits = tensor->scale_bits;
+        headers[i].zero_point = tensor->zero_point;
+        headers[i].bytes = tensor->data ? tensor->data_size : 0;
+        data[i] = tensor->data;
+    }
+
+    results = tensor_ops_pack_results(headers, data, graph.num_outputs, &results_bytes);
+    if (!results) {
+        ret = -ENOMEM;
+    }
+out:
+    kfree(headers);
+    kfree(data);
+    return ret;
 }
 
 static struct file_operations fops = {
@@ -380,6 +1360,8 @@ static int __init tensorflow_interpreter_device_init(void) {
 }
 
 static void __exit tensorflow_interpreter_device_exit(void) {
+    free_computation_graph();
+    kvfree(results);
     kfree(kernel_buffer);
     device_destroy(tensorflow_interpreter_class, MKDEV(major_number, 0));
     class_unregister(tensorflow_interpreter_class);
@@ -3,391 +3,663 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
-#include <linux/vmalloc.h>
-#include <linux/sysinfo.h>
 #include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/mempool.h>
+#include <linux/atomic.h>
 #include <linux/device.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+#include <linux/log2.h>
+#include <linux/cache.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/io_uring/cmd.h>
+#include <linux/moduleparam.h>
+#include <linux/err.h>
+#include <linux/string.h>
 #include "model_interpreter.h"
-#include <linux/delay.h>
+#include "tensor_ops.h"
+#include "tflite_plan.h"
+#include "tensorflow_lite_ioctl.h"
+#include "tflite_trace.h"
 
 #define DEVICE_NAME "tensorflow_lite_kernel_interpreter"
 #define CLASS_NAME "tensorflow_lite"
+// Holds one command and, once it has run, its response for dev_read
+#define KERNEL_BUFFER_SIZE 1024
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("kasinadhsarma, Devin");
 MODULE_DESCRIPTION("A kernel module for interpreting and executing TensorFlow Lite models");
 MODULE_VERSION("0.1");
 
-struct tensorflow_lite_model {
-    void *graph;
-    uint64_t parameters;
-};
+struct session;
+struct session_ring;
 
-int load_model(const char *model_path);
-int execute_model(void);
-static int get_results(char *result_buffer, size_t buffer_size);
-static int interpret_and_execute_model(char *model_data);
-static struct tensorflow_lite_model *parse_tensorflow_lite_model(char *model_data);
-static int load_computation_graph(struct tensorflow_lite_model *model);
-static int execute_computation_graph(struct tensorflow_lite_model *model);
+static void free_ring(struct session_ring *ring);
+static int session_pack_results(struct session *session);
+static void destroy_command_pools(void);
 
 static int major_number;
-static char *kernel_buffer = NULL;
-static DEFINE_MUTEX(kernel_buffer_mutex);
 
-static int dev_open(struct inode *inodep, struct file *filep) {
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Device opened\n");
-    return 0;
+// Runs asynchronous executions; the graphs still spread over the tensor_ops
+// workers from there
+static struct workqueue_struct *exec_workqueue;
+
+// Buffers the command path needs are taken from pools reserved at init
+// rather than allocated per command. Allocations never sleep: a command that
+// finds its pool empty while the page allocator has nothing to spare fails
+// at once with -ENOMEM, and the failure is counted (GET_POOL_STATS). The
+// reserve guarantees pool_reserve commands can always proceed together.
+static unsigned int pool_reserve = 16;
+module_param(pool_reserve, uint, 0444);
+MODULE_PARM_DESC(pool_reserve, "Buffers of each kind reserved for the command path at init");
+
+// Scratch holds the result headers and data pointers of GET_RESULTS
+#define SCRATCH_BUFFER_SIZE PAGE_SIZE
+#define SCRATCH_MAX_OUTPUTS \
+    (SCRATCH_BUFFER_SIZE / (sizeof(struct tensor_result_header) + sizeof(void *)))
+
+struct command_pool {
+    const char *name;
+    size_t size;
+    mempool_t *pool;
+    atomic_long_t failures;
+};
+
+// Registry of loaded models, shared by every client of the device. Models
+// are found by handle, or by file version through their page-cache mapping,
+// which tensor_ops shares between all loads of the same path and inode
+// version. Each LOAD_MODEL takes a reference that UNLOAD_MODEL or closing the
+// device drops; a model stays resident until its last reference is gone.
+// model_registry_mutex only covers lookups, as loaded models are immutable.
+struct loaded_model {
+    struct kref ref;
+    int handle;
+    struct model_mapping *mapping;
+    // Prepared once at load and shared by every session running the model
+    struct tflite_plan *plan;
+};
+
+static DEFINE_IDR(model_handles);
+static DEFINE_MUTEX(model_registry_mutex);
+
+// Per-open state in filep->private_data, so clients never wait on each
+// other. The lock only orders calls made through the same open file.
+struct session {
+    struct mutex lock;
+    // The last command, then its response for dev_read
+    char buffer[KERNEL_BUFFER_SIZE];
+    // Output tensors packed by GET_RESULTS, read instead of the buffer
+    void *results;
+    size_t results_bytes;
+    // Handles loaded through this session, one entry per reference
+    struct list_head models;
+    // Model run by a bare EXECUTE_MODEL and addressed by SET_INPUT and
+    // GET_OUTPUT, with a reference of its own, and the tensor arena of
+    // plan->arena_size bytes it runs in. Inputs and outputs live in the
+    // arena, so they belong to the session.
+    struct loaded_model *model;
+    uint8_t *arena;
+    // Mappings of the arena into userspace. dev_mmap runs under mmap_lock
+    // and cannot take the session lock, so arena_lock orders it against
+    // changes of the binding; a mapped arena is never replaced.
+    spinlock_t arena_lock;
+    int arena_mappings;
+    // Set once by SETUP_RINGS, freed with the session
+    struct session_ring *ring;
+    int result;
+    // Asynchronous execution. While exec_busy the work owns the binding and
+    // the arena; exec_done marks a result not collected yet. Both change
+    // under the lock.
+    struct work_struct exec_work;
+    bool exec_busy;
+    bool exec_done;
+    // Completions wake pollers and signal the eventfd, if one is registered
+    wait_queue_head_t wait;
+    spinlock_t event_lock;
+    struct eventfd_ctx *eventfd;
+};
+
+struct session_model {
+    struct list_head list;
+    int handle;
+};
+
+// Model paths of LOAD
+static struct command_pool path_pool = { .name = "path", .size = PATH_MAX };
+// Per-command scratch space
+static struct command_pool scratch_pool = { .name = "scratch", .size = SCRATCH_BUFFER_SIZE };
+// Session references to loaded models
+static struct command_pool entry_pool = { .name = "entry", .size = sizeof(struct session_model) };
+static struct command_pool *const command_pools[] = { &path_pool, &scratch_pool, &entry_pool };
+
+// Submission and completion rings of a session, see tensorflow_lite_ioctl.h.
+// Requests from the rings run in an arena of their own, so they never touch
+// the session's binding. The header lives in shared memory, so the kernel
+// keeps its own copies of the indices it owns.
+struct session_ring {
+    void *memory;
+    size_t bytes;
+    struct tflite_ring_header *header;
+    struct tflite_sqe *sqes;
+    struct tflite_cqe *cqes;
+    uint8_t *data;
+    size_t data_bytes;
+    u32 sq_entries;
+    u32 cq_entries;
+    u32 sq_head;
+    u32 cq_tail;
+    // Model and arena requests run in, rebound when the handle changes
+    struct loaded_model *model;
+    uint8_t *arena;
+    // SQPOLL thread, if any
+    struct task_struct *thread;
+    unsigned long idle_jiffies;
+    // Runs the queued requests for RING_ENTER with TFLITE_RING_ASYNC
+    bool async;
+    struct work_struct work;
+    struct session *session;
+};
+
+static void free_model(struct loaded_model *model) {
+    tflite_plan_destroy(model->plan);
+    tensor_ops_model_unmap(model->mapping);
+    kfree(model);
 }
 
-static int dev_release(struct inode *inodep, struct file *filep) {
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Device closed\n");
-    mutex_unlock(&kernel_buffer_mutex);
-    return 0;
+static void release_model(struct kref *ref) {
+    struct loaded_model *model = container_of(ref, struct loaded_model, ref);
+
+    // Called with model_registry_mutex held, which it releases
+    idr_remove(&model_handles, model->handle);
+    mutex_unlock(&model_registry_mutex);
+
+    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Released model handle %d\n", model->handle);
+    free_model(model);
 }
 
-/* Removed redundant definition of tensorflow_lite_kernel_interpreter_exit */
+// Takes a reference to the model with the given handle
+static struct loaded_model *get_model(int handle) {
+    struct loaded_model *model;
 
-static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset) {
-    int ret;
-    int snprintf_ret;
-    char *result_buffer = NULL;
-    int error_count;
-    struct sysinfo mem_info;
-    int retry_count;
+    mutex_lock(&model_registry_mutex);
+    model = idr_find(&model_handles, handle);
+    if (model) {
+        kref_get(&model->ref);
+    }
+    mutex_unlock(&model_registry_mutex);
+    return model;
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Entering dev_write function\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: buffer=%p, len=%zu\n", buffer, len);
+static void put_model(struct loaded_model *model) {
+    kref_put_mutex(&model->ref, release_model, &model_registry_mutex);
+}
 
-    if (len > 1023) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Input length exceeds buffer limit\n");
-        return -EINVAL;
+// Takes a reference to the model using the given mapping, if one is loaded.
+// Called with model_registry_mutex held.
+static struct loaded_model *get_model_by_mapping(const struct model_mapping *mapping) {
+    struct loaded_model *model;
+    int handle;
+
+    // The same mapping means the same path and inode version
+    idr_for_each_entry(&model_handles, model, handle) {
+        if (model->mapping == mapping) {
+            kref_get(&model->ref);
+            return model;
+        }
     }
+    return NULL;
+}
 
-    if (!access_ok(buffer, len)) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: User space buffer is not accessible\n");
-        return -EFAULT;
+// Loads the model at model_path, or takes another reference to it if this
+// version of the file is already loaded. Returns the model handle. Progress
+// is reported through the tflite tracepoints rather than the log.
+static int __load_model(const char *model_path) {
+    struct model_mapping *mapping;
+    struct loaded_model *model, *loaded;
+    struct tflite_plan *plan;
+    int handle;
+
+    // Ensure the model_path is null-terminated and within the maximum allowed length
+    if (strnlen(model_path, PATH_MAX) == PATH_MAX) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Model path exceeds maximum allowed length\n");
+        return -ENAMETOOLONG;
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: User space buffer is accessible and passed access_ok check\n");
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Attempting to lock kernel_buffer_mutex\n");
-    mutex_lock(&kernel_buffer_mutex);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Successfully locked kernel_buffer_mutex\n");
+    // Map the model file from the page cache; its pages are used in place
+    // and shared with every other module and client loading the same file
+    mapping = tensor_ops_model_map(model_path);
+    if (IS_ERR(mapping)) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to map model file %s with error %ld\n", model_path, PTR_ERR(mapping));
+        return PTR_ERR(mapping);
+    }
 
-    // Log system memory usage before allocating the kernel buffer
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory before allocating kernel buffer - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
+    mutex_lock(&model_registry_mutex);
+    model = get_model_by_mapping(mapping);
+    mutex_unlock(&model_registry_mutex);
+    if (model) {
+        tensor_ops_model_unmap(mapping);
+        trace_tflite_model_load_end(model_path, model->handle, model->mapping->size, model->plan->arena_size);
+        return model->handle;
+    }
 
-    // Log the context in which vmalloc is being called
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: in_atomic() = %d\n", in_atomic());
+    // Verify and prepare the model outside the registry lock
+    plan = tflite_plan_create(mapping->data, mapping->size);
+    if (IS_ERR(plan)) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to prepare model %s with error %ld\n", model_path, PTR_ERR(plan));
+        tensor_ops_model_unmap(mapping);
+        return PTR_ERR(plan);
+    }
 
-    if (kernel_buffer) {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Freeing existing kernel buffer at %p\n", kernel_buffer);
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
+    model = kzalloc(sizeof(*model), GFP_KERNEL);
+    if (!model) {
+        tflite_plan_destroy(plan);
+        tensor_ops_model_unmap(mapping);
+        return -ENOMEM;
     }
+    kref_init(&model->ref);
+    model->mapping = mapping;
+    model->plan = plan;
+
+    // Another client may have loaded the same file meanwhile
+    mutex_lock(&model_registry_mutex);
+    loaded = get_model_by_mapping(mapping);
+    if (loaded) {
+        handle = loaded->handle;
+        mutex_unlock(&model_registry_mutex);
+        free_model(model);
+        trace_tflite_model_load_end(model_path, handle, loaded->mapping->size, loaded->plan->arena_size);
+        return handle;
+    }
+    handle = idr_alloc_cyclic(&model_handles, model, 1, 0, GFP_KERNEL);
+    if (handle < 0) {
+        mutex_unlock(&model_registry_mutex);
+        free_model(model);
+        return handle;
+    }
+    model->handle = handle;
+    mutex_unlock(&model_registry_mutex);
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Attempting to allocate kernel buffer with size %zu\n", len + 1);
-    if (in_atomic()) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Cannot allocate memory in atomic context\n");
-        mutex_unlock(&kernel_buffer_mutex);
-        return -EFAULT;
+    trace_tflite_model_load_end(model_path, handle, mapping->size, plan->arena_size);
+    return handle;
+}
+
+// Failed loads end their trace here, the others where the sizes are known
+int load_model(const char *model_path) {
+    int handle;
+
+    trace_tflite_model_load_begin(model_path);
+    handle = __load_model(model_path);
+    if (handle < 0) {
+        trace_tflite_model_load_end(model_path, handle, 0, 0);
     }
+    return handle;
+}
 
-    retry_count = 5;
-    while (retry_count > 0) {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Attempting vmalloc, retry_count=%d\n", retry_count);
-        kernel_buffer = vmalloc(len + 1);
-        if (kernel_buffer) {
-            printk(KERN_INFO "TensorFlowLiteKernelInterpreter: vmalloc succeeded, kernel_buffer=%p\n", kernel_buffer);
-            si_meminfo(&mem_info);
-            printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after successful vmalloc - Total: %lu, Free: %lu, Available: %lu\n",
-                   mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
-            break;
-        } else {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: vmalloc failed, kernel_buffer is NULL\n");
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: vmalloc failed, retrying... (%d retries left)\n", retry_count - 1);
-            si_meminfo(&mem_info);
-            printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after vmalloc failure - Total: %lu, Free: %lu, Available: %lu\n",
-                   mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
-            msleep(200);
-            retry_count--;
-        }
+// Drops the reference taken by one load_model() of the model
+int unload_model(int handle) {
+    struct loaded_model *model;
+
+    mutex_lock(&model_registry_mutex);
+    model = idr_find(&model_handles, handle);
+    if (!model) {
+        mutex_unlock(&model_registry_mutex);
+        return -ENOENT;
     }
+    if (!kref_put(&model->ref, release_model)) {
+        mutex_unlock(&model_registry_mutex);
+    }
+    return 0;
+}
 
-    if (!kernel_buffer) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to allocate memory for kernel buffer with vmalloc, attempting kmalloc\n");
-
-        si_meminfo(&mem_info);
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory immediately after vmalloc failure - Total: %lu, Free: %lu, Available: %lu\n",
-               mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
-
-        retry_count = 3;
-        while (retry_count > 0) {
-            printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Attempting kmalloc, retry_count=%d\n", retry_count);
-            kernel_buffer = kmalloc(len + 1, GFP_KERNEL);
-            if (kernel_buffer) {
-                printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kmalloc succeeded, kernel_buffer=%p\n", kernel_buffer);
-                si_meminfo(&mem_info);
-                printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after successful kmalloc - Total: %lu, Free: %lu, Available: %lu\n",
-                       mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
-                break;
-            } else {
-                printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: kmalloc failed, kernel_buffer is NULL\n");
-                printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: kmalloc failed, retrying... (%d retries left)\n", retry_count - 1);
-                si_meminfo(&mem_info);
-                printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after kmalloc failure - Total: %lu, Free: %lu, Available: %lu\n",
-                       mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
-                msleep(100);
-                retry_count--;
-            }
-        }
+// Replaces the binding unless the arena is mapped, and releases the old one
+static int session_set_binding(struct session *session, struct loaded_model *model, uint8_t *arena) {
+    struct loaded_model *old_model;
+    uint8_t *old_arena;
 
-        if (!kernel_buffer) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to allocate memory for kernel buffer with kmalloc\n");
-            mutex_unlock(&kernel_buffer_mutex);
-            return -ENOMEM;
-        }
+    spin_lock(&session->arena_lock);
+    if (session->arena_mappings) {
+        spin_unlock(&session->arena_lock);
+        return -EBUSY;
+    }
+    old_model = session->model;
+    old_arena = session->arena;
+    session->model = model;
+    session->arena = arena;
+    spin_unlock(&session->arena_lock);
+
+    if (old_model) {
+        vfree(old_arena);
+        put_model(old_model);
     }
+    return 0;
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Successfully allocated kernel buffer with size %zu\n", len + 1);
+static int session_unbind(struct session *session) {
+    return session_set_binding(session, NULL, NULL);
+}
 
-    // Log system memory usage after successful allocation
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after allocation - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Successfully allocated kernel buffer with size %zu\n", len + 1);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Kernel buffer state after allocation: %s\n", kernel_buffer ? "Allocated" : "Not Allocated");
+// Makes the model with the given handle the session's model, with a fresh
+// arena. Rebinding the bound model keeps the arena and the inputs in it.
+static int session_bind(struct session *session, int handle) {
+    struct loaded_model *model;
+    uint8_t *arena;
+    int ret;
 
-    if (!kernel_buffer) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Kernel buffer is not allocated\n");
-        mutex_unlock(&kernel_buffer_mutex);
+    if (session->model && session->model->handle == handle) {
+        return 0;
+    }
+    model = get_model(handle);
+    if (!model) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: No model loaded with handle %d\n", handle);
+        return -ENOENT;
+    }
+    // Zeroed and mappable into userspace by dev_mmap
+    arena = vmalloc_user(max_t(size_t, model->plan->arena_size, 1));
+    if (!arena) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to allocate %zu byte tensor arena\n", model->plan->arena_size);
+        put_model(model);
         return -ENOMEM;
     }
+    ret = session_set_binding(session, model, arena);
+    if (ret < 0) {
+        vfree(arena);
+        put_model(model);
+    }
+    return ret;
+}
 
-    // Additional logging to verify kernel buffer integrity before processing commands
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Kernel buffer before processing commands: %s\n", kernel_buffer);
+static int session_execute(struct session *session) {
+    int ret;
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Before memcpy, buffer: %s\n", buffer);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Before memcpy, kernel_buffer: %p\n", kernel_buffer);
-    if (!kernel_buffer) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Kernel buffer is not allocated\n");
-        mutex_unlock(&kernel_buffer_mutex);
-        return -ENOMEM;
+    if (!session->model) {
+        return -ENOENT;
     }
-    if (copy_from_user(kernel_buffer, buffer, len)) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to copy data from user space\n");
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
-        mutex_unlock(&kernel_buffer_mutex);
-        return -EFAULT;
+    ret = tflite_plan_invoke(session->model->plan, session->arena);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Model execution failed with error code %d\n", ret);
+        return ret;
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: After memcpy, kernel_buffer: %s\n", kernel_buffer);
+    session->result = ret;
+    return ret;
+}
 
-    if (len >= 1024) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Input length exceeds buffer limit after copy\n");
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
-        mutex_unlock(&kernel_buffer_mutex);
-        return -EINVAL;
+static void session_notify(struct session *session) {
+    wake_up_interruptible(&session->wait);
+    spin_lock(&session->event_lock);
+    if (session->eventfd) {
+        eventfd_signal(session->eventfd);
     }
+    spin_unlock(&session->event_lock);
+}
 
-    kernel_buffer[len] = '\0'; // Ensure null-termination
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Kernel buffer state after null-termination: %s\n", kernel_buffer);
+static void session_exec_work(struct work_struct *work) {
+    struct session *session = container_of(work, struct session, exec_work);
+    int ret;
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Parsing command from kernel buffer\n");
-    // Parse the command from the kernel buffer
-    if (strncmp(kernel_buffer, "LOAD_MODEL ", 11) == 0) {
-        char *model_path = kernel_buffer + 11;
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Loading model from path: %s\n", model_path);
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: model_path before calling load_model: %s\n", model_path);
-        ret = load_model(model_path);
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: load_model function returned %d\n", ret);
-        if (ret < 0) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to load model from path: %s\n", model_path);
-            vfree(kernel_buffer);
-            kernel_buffer = NULL;
-            mutex_unlock(&kernel_buffer_mutex);
-            return ret;
-        }
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Model loaded successfully\n");
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kernel_buffer after loading model: %s\n", kernel_buffer);
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Exiting LOAD_MODEL command handling\n");
-    } else if (strncmp(kernel_buffer, "EXECUTE_MODEL", 13) == 0) {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Executing model\n");
-        ret = execute_model();
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: execute_model function returned %d\n", ret);
-        snprintf_ret = snprintf(kernel_buffer, 1024, "Model execution result: %d", ret);
-        if (snprintf_ret < 0) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf failed with error code %d\n", snprintf_ret);
-            vfree(kernel_buffer);
-            kernel_buffer = NULL;
-            mutex_unlock(&kernel_buffer_mutex);
-            return snprintf_ret;
-        } else if (snprintf_ret >= 1024) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf output was truncated\n");
-            vfree(kernel_buffer);
-            kernel_buffer = NULL;
-            mutex_unlock(&kernel_buffer_mutex);
-            return -EINVAL;
-        }
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: snprintf completed successfully, kernel_buffer: %s\n", kernel_buffer);
-        if (ret < 0) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Model execution failed\n");
-            vfree(kernel_buffer);
-            kernel_buffer = NULL;
-            mutex_unlock(&kernel_buffer_mutex);
-            return ret;
-        }
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Model executed successfully\n");
-    } else if (strncmp(kernel_buffer, "GET_RESULTS", 11) == 0) {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Getting results\n");
-        result_buffer = kmalloc(2048, GFP_KERNEL); // Allocate result buffer with sufficient size
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: result_buffer allocated at %p\n", result_buffer);
-        if (!result_buffer) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to allocate memory for result buffer\n");
-            vfree(kernel_buffer);
-            kernel_buffer = NULL;
-            mutex_unlock(&kernel_buffer_mutex);
+    // Nothing rebinds or frees the arena while exec_busy is set
+    ret = tflite_plan_invoke(session->model->plan, session->arena);
+    if (ret < 0) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Model execution failed with error code %d\n", ret);
+    }
+
+    mutex_lock(&session->lock);
+    session->result = ret;
+    session->exec_busy = false;
+    session->exec_done = true;
+    mutex_unlock(&session->lock);
+    session_notify(session);
+}
+
+// Queues the bound model; the result is collected once it is done
+static int session_submit(struct session *session) {
+    if (!session->model) {
+        return -ENOENT;
+    }
+    session->exec_busy = true;
+    session->exec_done = false;
+    queue_work(exec_workqueue, &session->exec_work);
+    return 0;
+}
+
+// Takes the result of a finished asynchronous execution
+static int session_collect(struct session *session, int *result) {
+    if (session->exec_busy) {
+        return -EAGAIN;
+    }
+    if (!session->exec_done) {
+        return -ENOENT;
+    }
+    session->exec_done = false;
+    *result = session->result;
+    return 0;
+}
+
+static int create_command_pools(void) {
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(command_pools); i++) {
+        command_pools[i]->pool = mempool_create_kmalloc_pool(max(pool_reserve, 1U), command_pools[i]->size);
+        if (!command_pools[i]->pool) {
+            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to reserve the %s pool\n", command_pools[i]->name);
+            destroy_command_pools();
             return -ENOMEM;
         }
+    }
+    return 0;
+}
 
-        ret = get_results(result_buffer, 2048);
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: get_results function returned %d\n", ret);
-        if (ret < 0) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to retrieve results\n");
-            kfree(result_buffer);
-            vfree(kernel_buffer);
-            kernel_buffer = NULL;
-            mutex_unlock(&kernel_buffer_mutex);
-            return ret;
-        } else {
-            result_buffer[2047] = '\0'; // Ensure null-termination
-            printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Before copy_to_user, result_buffer: %s\n", result_buffer);
-            error_count = copy_to_user((void *)buffer, result_buffer, strnlen(result_buffer, 2048) + 1); // Ensure null-terminator is copied
-            printk(KERN_INFO "TensorFlowLiteKernelInterpreter: After copy_to_user, error_count: %d\n", error_count);
-            if (error_count != 0) {
-                printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to copy results to user space\n");
-                kfree(result_buffer);
-                vfree(kernel_buffer);
-                kernel_buffer = NULL;
-                mutex_unlock(&kernel_buffer_mutex);
-                return -EFAULT;
-            }
-        }
-        kfree(result_buffer);
-    } else {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Unknown command\n");
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
-        mutex_unlock(&kernel_buffer_mutex);
-        return -EINVAL;
+static void destroy_command_pools(void) {
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(command_pools); i++) {
+        mempool_destroy(command_pools[i]->pool);
+        command_pools[i]->pool = NULL;
     }
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: After snprintf, kernel_buffer: %s\n", kernel_buffer);
-    if (snprintf_ret < 0) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf failed with error code %d\n", snprintf_ret);
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
-        mutex_unlock(&kernel_buffer_mutex);
-        return snprintf_ret;
-    } else if (snprintf_ret >= 1024) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf output was truncated\n");
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
-        mutex_unlock(&kernel_buffer_mutex);
-        return -EINVAL;
+// Never sleeps; the reserve is used once the page allocator fails
+static void *command_pool_alloc(struct command_pool *pool) {
+    void *element = mempool_alloc(pool->pool, GFP_NOWAIT);
+
+    if (!element) {
+        atomic_long_inc(&pool->failures);
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: snprintf completed successfully, kernel_buffer: %s\n", kernel_buffer);
+    return element;
+}
 
-    vfree(kernel_buffer);
-    kernel_buffer = NULL;
-    mutex_unlock(&kernel_buffer_mutex);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Exiting dev_write function\n");
-    return len;
+static void command_pool_free(struct command_pool *pool, void *element) {
+    mempool_free(element, pool->pool);
 }
 
-int load_model(const char *model_path) {
-    struct file *model_file;
-    loff_t pos = 0;
-    ssize_t ret;
-    struct sysinfo mem_info;
-    loff_t file_size;
+static int dev_open(struct inode *inodep, struct file *filep) {
+    struct session *session = kzalloc(sizeof(*session), GFP_KERNEL);
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Entering load_model function\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: model_path: %s\n", model_path);
+    if (!session) {
+        return -ENOMEM;
+    }
+    mutex_init(&session->lock);
+    spin_lock_init(&session->arena_lock);
+    INIT_LIST_HEAD(&session->models);
+    INIT_WORK(&session->exec_work, session_exec_work);
+    init_waitqueue_head(&session->wait);
+    spin_lock_init(&session->event_lock);
+    filep->private_data = session;
+    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Device opened\n");
+    return 0;
+}
 
-    // Log system memory usage before loading the model
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory before loading model - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
+static int dev_release(struct inode *inodep, struct file *filep) {
+    struct session *session = filep->private_data;
+    struct session_model *entry, *next;
+
+    // An asynchronous execution still owns the arena
+    flush_work(&session->exec_work);
+    session_unbind(session);
+    if (session->ring) {
+        free_ring(session->ring);
+    }
+    if (session->eventfd) {
+        eventfd_ctx_put(session->eventfd);
+    }
+    kvfree(session->results);
+    // Models loaded through this file and never unloaded
+    list_for_each_entry_safe(entry, next, &session->models, list) {
+        unload_model(entry->handle);
+        command_pool_free(&entry_pool, entry);
+    }
+    mutex_destroy(&session->lock);
+    kfree(session);
+    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Device closed\n");
+    return 0;
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Attempting to open model file %s\n", model_path);
+// Loads a model and binds the session to it
+static int session_load_model(struct session *session, const char *model_path) {
+    struct session_model *entry = command_pool_alloc(&entry_pool);
+    int handle;
+    int ret;
 
-    // Ensure the model_path is null-terminated and within the maximum allowed length
-    if (strnlen(model_path, PATH_MAX) == PATH_MAX) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Model path exceeds maximum allowed length\n");
-        return -ENAMETOOLONG;
+    if (!entry) {
+        return -ENOMEM;
+    }
+    handle = load_model(model_path);
+    if (handle < 0) {
+        command_pool_free(&entry_pool, entry);
+        return handle;
     }
+    ret = session_bind(session, handle);
+    if (ret < 0) {
+        unload_model(handle);
+        command_pool_free(&entry_pool, entry);
+        return ret;
+    }
+    entry->handle = handle;
+    list_add(&entry->list, &session->models);
+    return handle;
+}
 
-    model_file = filp_open(model_path, O_RDONLY, 0);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: filp_open returned %p\n", model_file);
-    if (IS_ERR(model_file)) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to open model file %s with error %ld\n", model_path, PTR_ERR(model_file));
-        return PTR_ERR(model_file);
+// Only references taken through this session can be dropped through it
+static int session_unload_model(struct session *session, int handle) {
+    struct session_model *entry;
+
+    list_for_each_entry(entry, &session->models, list) {
+        if (entry->handle == handle) {
+            list_del(&entry->list);
+            command_pool_free(&entry_pool, entry);
+            // A mapped arena stays bound, with its own model reference
+            if (session->model && session->model->handle == handle) {
+                session_unbind(session);
+            }
+            return unload_model(handle);
+        }
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Successfully opened model file %s\n", model_path);
+    return -ENOENT;
+}
 
-    // Determine the size of the model file
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Attempting to read model file size\n");
-    file_size = i_size_read(file_inode(model_file));
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Model file size: %lld\n", file_size);
+static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset) {
+    struct session *session = filep->private_data;
+    char *command;
+    int handle;
+    int ret;
 
-    // Free existing kernel_buffer if already allocated
-    if (kernel_buffer) {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Freeing existing kernel buffer at %p\n", kernel_buffer);
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
+    if (len >= KERNEL_BUFFER_SIZE) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Input length exceeds buffer limit\n");
+        return -EINVAL;
     }
 
-    // Ensure kernel_buffer is allocated
-    if (!kernel_buffer) {
-        kernel_buffer = vmalloc(file_size + 1);
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Allocated kernel buffer at %p\n", kernel_buffer);
-        if (!kernel_buffer) {
-            printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to allocate memory for kernel buffer\n");
-            filp_close(model_file, NULL);
-            return -ENOMEM;
+    mutex_lock(&session->lock);
+    if (copy_from_user(session->buffer, buffer, len)) {
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to copy data from user space\n");
+        session->buffer[0] = '\0';
+        mutex_unlock(&session->lock);
+        return -EFAULT;
+    }
+    session->buffer[len] = '\0';
+    command = strim(session->buffer);
+    // Every command replaces the response, which is read from its start
+    kvfree(session->results);
+    session->results = NULL;
+    *offset = 0;
+
+    // Parse the command; the response replaces it in the session buffer
+    if (session->exec_busy && strncmp(command, "GET_RESULTS", 11) != 0 &&
+        strncmp(command, "GET_POOL_STATS", 14) != 0) {
+        // An asynchronous execution owns the binding and the arena
+        ret = -EBUSY;
+    } else if (strncmp(command, "LOAD_MODEL ", 11) == 0) {
+        const char *model_path = skip_spaces(command + 11);
+
+        ret = session_load_model(session, model_path);
+        if (ret >= 0) {
+            snprintf(session->buffer, KERNEL_BUFFER_SIZE, "Model handle: %d", ret);
+        }
+    } else if (strncmp(command, "UNLOAD_MODEL ", 13) == 0) {
+        ret = kstrtoint(command + 13, 10, &handle);
+        if (ret == 0) {
+            ret = session_unload_model(session, handle);
+        }
+        if (ret == 0) {
+            snprintf(session->buffer, KERNEL_BUFFER_SIZE, "Model unloaded: %d", handle);
+        }
+    } else if (strncmp(command, "EXECUTE_MODEL", 13) == 0) {
+        // EXECUTE_MODEL_ASYNC only queues the model, and GET_RESULTS or
+        // poll() tell when it is done. An explicit handle may name any
+        // loaded model, and binds it.
+        bool async = strncmp(command + 13, "_ASYNC", 6) == 0;
+        const char *arg = skip_spaces(command + (async ? 19 : 13));
+
+        ret = 0;
+        if (*arg) {
+            ret = kstrtoint(arg, 10, &handle);
+            if (ret == 0) {
+                ret = session_bind(session, handle);
+            }
+        }
+        if (ret == 0 && async) {
+            ret = session_submit(session);
+            if (ret == 0) {
+                snprintf(session->buffer, KERNEL_BUFFER_SIZE, "Model execution queued");
+            }
+        } else if (ret == 0) {
+            ret = session_execute(session);
+            if (ret >= 0) {
+                snprintf(session->buffer, KERNEL_BUFFER_SIZE, "Model execution result: %d", ret);
+            }
+        }
+    } else if (strncmp(command, "GET_POOL_STATS", 14) == 0) {
+        snprintf(session->buffer, KERNEL_BUFFER_SIZE,
+                 "path_pool_failures=%ld scratch_pool_failures=%ld entry_pool_failures=%ld\n",
+                 atomic_long_read(&path_pool.failures), atomic_long_read(&scratch_pool.failures),
+                 atomic_long_read(&entry_pool.failures));
+        ret = 0;
+    } else if (strncmp(command, "GET_RESULTS", 11) == 0) {
+        if (session->exec_busy) {
+            ret = -EAGAIN;
+        } else {
+            session->exec_done = false;
+            ret = session_pack_results(session);
         }
     } else {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Kernel buffer is already allocated\n");
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Unknown command\n");
+        ret = -EINVAL;
     }
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Attempting to read model file into kernel buffer\n");
-    // Read the model file into kernel_buffer
-    ret = kernel_read(model_file, kernel_buffer, file_size, &pos);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kernel_read returned %ld\n", ret);
     if (ret < 0) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to read model file %s with error %ld\n", model_path, ret);
-        vfree(kernel_buffer);
-        filp_close(model_file, NULL);
-        return ret;
+        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Command failed with error %d\n", ret);
+        session->buffer[0] = '\0';
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Successfully read model file into kernel buffer\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kernel_buffer after reading model file: %s\n", kernel_buffer);
-
-    filp_close(model_file, NULL);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Closed model file %s\n", model_path);
-
-    // Log system memory usage after loading the model
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after loading model - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
-
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Model loaded from %s\n", model_path);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kernel_buffer after loading model: %s\n", kernel_buffer);
-    return 0;
+    mutex_unlock(&session->lock);
+    return ret < 0 ? ret : len;
 }
 
 /* Removed redundant definition of tensorflow_lite_kernel_interpreter_exit */
@@ -403,230 +675,754 @@ int load_model(const char *model_path) {
 
 /* Removed redundant definition of tensorflow_lite_kernel_interpreter_exit */
 
+// Returns the response to the session's last command
 static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *offset) {
-    int error_count = 0;
-    error_count = copy_to_user(buffer, kernel_buffer, len);
+    struct session *session = filep->private_data;
+    ssize_t ret;
 
-    if (error_count == 0) {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Sent %zu characters to the user\n", len);
-        return len;
+    mutex_lock(&session->lock);
+    if (session->results) {
+        ret = simple_read_from_buffer(buffer, len, offset, session->results, session->results_bytes);
     } else {
-        printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Failed to send %d characters to the user\n", error_count);
+        ret = simple_read_from_buffer(buffer, len, offset, session->buffer, strnlen(session->buffer, KERNEL_BUFFER_SIZE));
+    }
+    mutex_unlock(&session->lock);
+    return ret;
+}
+
+// Binary interface, see tensorflow_lite_ioctl.h. Every command runs under the
+// session lock, like the text commands.
+
+// Plan dims are padded with leading ones to four
+static void copy_operand_dims(const struct tflite_plan_operand *operand, __s32 *dims) {
+    int i;
+
+    for (i = 0; i < operand->rank; i++) {
+        dims[i] = operand->dims[TFLITE_MAX_DIMS - operand->rank + i];
+    }
+}
+
+static void fill_tensor_info(struct tflite_tensor_info *info, const struct tflite_plan_operand *operand) {
+    memset(info, 0, sizeof(*info));
+    info->type = operand->type;
+    info->rank = operand->rank;
+    copy_operand_dims(operand, info->dims);
+    info->scale_bits = operand->scale_bits;
+    info->zero_point = operand->zero_point;
+    info->bytes = operand->bytes;
+    info->offset = operand->constant ? TFLITE_NO_OFFSET : operand->arena_offset;
+}
+
+// Packs the outputs of the bound model's last execution for dev_read, in
+// the framing of tensor_results.h
+static int session_pack_results(struct session *session) {
+    struct tensor_result_header *headers;
+    const struct tflite_plan *plan;
+    const void **data;
+    void *scratch;
+    int ret = 0;
+    int i;
+
+    if (!session->model) {
+        return -ENOENT;
+    }
+    if (session->result < 0) {
+        return session->result;
+    }
+    plan = session->model->plan;
+    if (plan->num_outputs > SCRATCH_MAX_OUTPUTS) {
+        return -E2BIG;
+    }
+    scratch = command_pool_alloc(&scratch_pool);
+    if (!scratch) {
+        return -ENOMEM;
+    }
+    // The headers, then the data pointers
+    memset(scratch, 0, SCRATCH_BUFFER_SIZE);
+    headers = scratch;
+    data = (const void **)(headers + plan->num_outputs);
+    for (i = 0; i < plan->num_outputs; i++) {
+        const struct tflite_plan_operand *operand = &plan->outputs[i];
+
+        headers[i].type = operand->type;
+        headers[i].rank = operand->rank;
+        copy_operand_dims(operand, headers[i].dims);
+        headers[i].scale_bits = operand->scale_bits;
+        headers[i].zero_point = operand->zero_point;
+        headers[i].bytes = operand->bytes;
+        data[i] = tflite_input_data(operand, session->arena);
+    }
+    session->results = tensor_ops_pack_results(headers, data, plan->num_outputs, &session->results_bytes);
+    if (!session->results) {
+        ret = -ENOMEM;
+    }
+    command_pool_free(&scratch_pool, scratch);
+    return ret;
+}
+
+static long ioctl_load(struct session *session, void __user *argp) {
+    struct tflite_ioc_load load;
+    char *model_path;
+    long ret;
+    int handle;
+
+    if (copy_from_user(&load, argp, sizeof(load))) {
         return -EFAULT;
     }
+    if (load.reserved) {
+        return -EINVAL;
+    }
+    model_path = command_pool_alloc(&path_pool);
+    if (!model_path) {
+        return -ENOMEM;
+    }
+    ret = strncpy_from_user(model_path, u64_to_user_ptr(load.path), PATH_MAX);
+    if (ret < 0 || ret == PATH_MAX) {
+        command_pool_free(&path_pool, model_path);
+        return ret < 0 ? ret : -ENAMETOOLONG;
+    }
+    handle = session_load_model(session, model_path);
+    command_pool_free(&path_pool, model_path);
+    if (handle < 0) {
+        return handle;
+    }
+
+    load.handle = handle;
+    if (copy_to_user(argp, &load, sizeof(load))) {
+        session_unload_model(session, handle);
+        return -EFAULT;
+    }
+    return 0;
 }
 
-int execute_model(void) {
-    int ret;
-    int snprintf_ret;
-    struct sysinfo mem_info;
+static long ioctl_query_metadata(void __user *argp) {
+    struct tflite_ioc_metadata metadata;
+    struct tflite_tensor_info info;
+    struct tflite_tensor_info __user *tensors;
+    const struct tflite_plan *plan;
+    struct loaded_model *model;
+    unsigned int count;
+    unsigned int i;
+    long ret = 0;
+
+    if (copy_from_user(&metadata, argp, sizeof(metadata))) {
+        return -EFAULT;
+    }
+    model = get_model(metadata.handle);
+    if (!model) {
+        return -ENOENT;
+    }
+    plan = model->plan;
+
+    // As many tensors as fit; the counts tell the caller how many there are
+    tensors = u64_to_user_ptr(metadata.tensors);
+    count = min_t(unsigned int, metadata.capacity, plan->num_inputs + plan->num_outputs);
+    for (i = 0; i < count && ret == 0; i++) {
+        if (i < plan->num_inputs) {
+            fill_tensor_info(&info, &plan->inputs[i]);
+        } else {
+            fill_tensor_info(&info, &plan->outputs[i - plan->num_inputs]);
+        }
+        if (copy_to_user(&tensors[i], &info, sizeof(info))) {
+            ret = -EFAULT;
+        }
+    }
+    metadata.num_inputs = plan->num_inputs;
+    metadata.num_outputs = plan->num_outputs;
+    metadata.arena_bytes = plan->arena_size;
+    put_model(model);
+
+    if (ret == 0 && copy_to_user(argp, &metadata, sizeof(metadata))) {
+        ret = -EFAULT;
+    }
+    return ret;
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Entering execute_model function\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kernel_buffer before execution: %s\n", kernel_buffer);
+// Copies one input into the session arena or one output out of it
+static long session_copy_tensor(struct session *session, const struct tflite_ioc_tensor *tensor, bool input) {
+    const struct tflite_plan *plan;
+    const struct tflite_plan_operand *operand;
 
-    // Log system memory usage before executing the model
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory before executing model - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
+    if (tensor->reserved) {
+        return -EINVAL;
+    }
+    if (!session->model) {
+        return -ENOENT;
+    }
+    plan = session->model->plan;
+    if (tensor->index >= (input ? plan->num_inputs : plan->num_outputs)) {
+        return -EINVAL;
+    }
+    operand = input ? &plan->inputs[tensor->index] : &plan->outputs[tensor->index];
+    if (tensor->bytes != operand->bytes) {
+        return -EINVAL;
+    }
+
+    if (input) {
+        // Constant inputs are part of the model and cannot be set
+        if (operand->constant) {
+            return -EINVAL;
+        }
+        if (copy_from_user(tflite_output_data(operand, session->arena), u64_to_user_ptr(tensor->data), operand->bytes)) {
+            return -EFAULT;
+        }
+    } else if (copy_to_user(u64_to_user_ptr(tensor->data), tflite_input_data(operand, session->arena), operand->bytes)) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+static long ioctl_tensor(struct session *session, void __user *argp, bool input) {
+    struct tflite_ioc_tensor tensor;
+
+    if (copy_from_user(&tensor, argp, sizeof(tensor))) {
+        return -EFAULT;
+    }
+    return session_copy_tensor(session, &tensor, input);
+}
+
+static long ioctl_execute(struct session *session, void __user *argp) {
+    struct tflite_ioc_execute execute;
+    long ret;
+
+    if (copy_from_user(&execute, argp, sizeof(execute))) {
+        return -EFAULT;
+    }
+    if (execute.flags & ~TFLITE_EXECUTE_ASYNC) {
+        return -EINVAL;
+    }
+    ret = session_bind(session, execute.handle);
+    if (ret == 0 && (execute.flags & TFLITE_EXECUTE_ASYNC)) {
+        ret = session_submit(session);
+    } else if (ret == 0) {
+        ret = session_execute(session);
+    }
+    return ret < 0 ? ret : 0;
+}
 
-    ret = interpret_and_execute_model(kernel_buffer);
+static long ioctl_run(struct session *session, void __user *argp) {
+    struct tflite_ioc_tensor __user *tensors;
+    struct tflite_ioc_tensor tensor;
+    struct tflite_ioc_run run;
+    unsigned int i;
+    long ret;
 
+    if (copy_from_user(&run, argp, sizeof(run))) {
+        return -EFAULT;
+    }
+    if (run.flags) {
+        return -EINVAL;
+    }
+    ret = session_bind(session, run.handle);
     if (ret < 0) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Model execution failed with error code %d\n", ret);
         return ret;
     }
 
-    snprintf_ret = snprintf(kernel_buffer, 1024, "Model execution result: %d", ret);
-    if (snprintf_ret < 0) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf failed with error code %d\n", snprintf_ret);
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
-        mutex_unlock(&kernel_buffer_mutex);
-        return snprintf_ret;
-    } else if (snprintf_ret >= 1024) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf output was truncated\n");
-        vfree(kernel_buffer);
-        kernel_buffer = NULL;
-        mutex_unlock(&kernel_buffer_mutex);
-        return -EINVAL;
+    tensors = u64_to_user_ptr(run.inputs);
+    for (i = 0; i < run.num_inputs; i++) {
+        if (copy_from_user(&tensor, &tensors[i], sizeof(tensor))) {
+            return -EFAULT;
+        }
+        ret = session_copy_tensor(session, &tensor, true);
+        if (ret < 0) {
+            return ret;
+        }
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: snprintf completed, kernel_buffer: %s\n", kernel_buffer);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: snprintf returned %d\n", snprintf_ret);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Model executed\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kernel_buffer after execution: %s\n", kernel_buffer);
 
-    // Log system memory usage after executing the model
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after executing model - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
+    ret = session_execute(session);
+    if (ret < 0) {
+        return ret;
+    }
 
-    return ret;
+    tensors = u64_to_user_ptr(run.outputs);
+    for (i = 0; i < run.num_outputs; i++) {
+        if (copy_from_user(&tensor, &tensors[i], sizeof(tensor))) {
+            return -EFAULT;
+        }
+        ret = session_copy_tensor(session, &tensor, false);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
 }
 
-static int interpret_and_execute_model(char *model_data) {
-    int result = 0;
-    struct tensorflow_lite_model *model = parse_tensorflow_lite_model(model_data);
-    int ret;
+static void free_ring(struct session_ring *ring) {
+    if (ring->thread) {
+        kthread_stop(ring->thread);
+    }
+    flush_work(&ring->work);
+    if (ring->model) {
+        vfree(ring->arena);
+        put_model(ring->model);
+    }
+    vfree(ring->memory);
+    kfree(ring);
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Entering interpret_and_execute_model function\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: model_data: %s\n", model_data);
+static int ring_bind(struct session_ring *ring, int handle) {
+    struct loaded_model *model;
+    uint8_t *arena;
 
+    if (ring->model && ring->model->handle == handle) {
+        return 0;
+    }
+    model = get_model(handle);
     if (!model) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to parse model data\n");
+        return -ENOENT;
+    }
+    arena = vzalloc(max_t(size_t, model->plan->arena_size, 1));
+    if (!arena) {
+        put_model(model);
+        return -ENOMEM;
+    }
+    if (ring->model) {
+        vfree(ring->arena);
+        put_model(ring->model);
+    }
+    ring->model = model;
+    ring->arena = arena;
+    return 0;
+}
+
+static bool ring_data_fits(const struct session_ring *ring, u64 offset, size_t bytes) {
+    return offset <= ring->data_bytes && bytes <= ring->data_bytes - offset;
+}
+
+// Runs one request, copied out of the shared SQ before it is validated
+static int ring_run(struct session_ring *ring, const struct tflite_sqe *sqe) {
+    const struct tflite_plan_operand *operand;
+    const struct tflite_plan *plan;
+    unsigned int i;
+    int ret;
+
+    if (sqe->flags || sqe->num_inputs > TFLITE_RING_MAX_TENSORS || sqe->num_outputs > TFLITE_RING_MAX_TENSORS) {
+        return -EINVAL;
+    }
+    ret = ring_bind(ring, sqe->handle);
+    if (ret < 0) {
+        return ret;
+    }
+    plan = ring->model->plan;
+    if (sqe->num_inputs != plan->num_inputs || sqe->num_outputs > plan->num_outputs) {
         return -EINVAL;
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Successfully parsed model data\n");
 
-    ret = load_computation_graph(model);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: load_computation_graph function returned %d\n", ret);
+    for (i = 0; i < sqe->num_inputs; i++) {
+        operand = &plan->inputs[i];
+        if (operand->constant || !ring_data_fits(ring, sqe->inputs[i], operand->bytes)) {
+            return -EINVAL;
+        }
+        memcpy(tflite_output_data(operand, ring->arena), ring->data + sqe->inputs[i], operand->bytes);
+    }
+
+    ret = tflite_plan_invoke(plan, ring->arena);
     if (ret < 0) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to load computation graph\n");
-        kfree(model);
         return ret;
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Computation graph loaded successfully\n");
 
-    result = execute_computation_graph(model);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: execute_computation_graph function returned %d\n", result);
+    for (i = 0; i < sqe->num_outputs; i++) {
+        operand = &plan->outputs[i];
+        if (!ring_data_fits(ring, sqe->outputs[i], operand->bytes)) {
+            return -EINVAL;
+        }
+        memcpy(ring->data + sqe->outputs[i], tflite_input_data(operand, ring->arena), operand->bytes);
+    }
+    return 0;
+}
 
-    kfree(model->graph);
-    kfree(model);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Freed model and graph memory\n");
+// Runs the queued requests while the CQ has room. Returns how many ran.
+static int ring_process(struct session_ring *ring) {
+    struct tflite_ring_header *header = ring->header;
+    u32 sq_tail = smp_load_acquire(&header->sq_tail);
+    int count = 0;
+
+    while (ring->sq_head != sq_tail) {
+        struct tflite_sqe sqe;
+        struct tflite_cqe *cqe;
+        int result;
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Exiting interpret_and_execute_model function\n");
-    return result;
+        if (ring->cq_tail - smp_load_acquire(&header->cq_head) >= ring->cq_entries) {
+            break;
+        }
+        memcpy(&sqe, &ring->sqes[ring->sq_head & (ring->sq_entries - 1)], sizeof(sqe));
+        ring->sq_head++;
+        smp_store_release(&header->sq_head, ring->sq_head);
+        trace_tflite_queue_dequeue(ring, TFLITE_TRACE_QUEUE_SQ, sqe.user_data, sq_tail - ring->sq_head);
+
+        result = ring_run(ring, &sqe);
+
+        cqe = &ring->cqes[ring->cq_tail & (ring->cq_entries - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->result = result;
+        cqe->flags = 0;
+        ring->cq_tail++;
+        smp_store_release(&header->cq_tail, ring->cq_tail);
+        trace_tflite_queue_enqueue(ring, TFLITE_TRACE_QUEUE_CQ, sqe.user_data,
+                                   ring->cq_tail - READ_ONCE(header->cq_head));
+        session_notify(ring->session);
+
+        count++;
+        cond_resched();
+    }
+    return count;
 }
 
-static struct tensorflow_lite_model *parse_tensorflow_lite_model(char *model_data) {
-    struct tensorflow_lite_model *model = kmalloc(sizeof(struct tensorflow_lite_model), GFP_KERNEL);
-    size_t offset = 0;
-    if (!model) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to allocate memory for model\n");
-        return NULL;
-    }
-    while (offset < strlen(model_data)) {
-        uint8_t field_number = model_data[offset] >> 3;
-        uint8_t wire_type = model_data[offset] & 0x07;
-        offset++;
-        switch (field_number) {
-            case 1:
-                if (wire_type == 2) {
-                    uint32_t length = 0;
-                    memcpy(&length, &model_data[offset], sizeof(uint32_t));
-                    offset += sizeof(uint32_t);
-                    model->graph = kmalloc(length, GFP_KERNEL);
-                    if (!model->graph) {
-                        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Failed to allocate memory for graph\n");
-                        kfree(model);
-                        return NULL;
-                    }
-                    memcpy(model->graph, &model_data[offset], length);
-                    offset += length;
-                }
-                break;
-            case 2:
-                if (wire_type == 0) {
-                    uint64_t value = 0;
-                    memcpy(&value, &model_data[offset], sizeof(uint64_t));
-                    offset += sizeof(uint64_t);
-                    model->parameters = value;
-                }
-                break;
-            default:
-                printk(KERN_WARNING "TensorFlowLiteKernelInterpreter: Unknown field number %u\n", field_number);
-                break;
+static void ring_work(struct work_struct *work) {
+    ring_process(container_of(work, struct session_ring, work));
+}
+
+static bool ring_pending(const struct session_ring *ring) {
+    return READ_ONCE(ring->header->sq_tail) != ring->sq_head;
+}
+
+// Polls the SQ, and sleeps once it has been idle for idle_jiffies until
+// RING_ENTER wakes it
+static int ring_thread(void *data) {
+    struct session_ring *ring = data;
+    struct tflite_ring_header *header = ring->header;
+    unsigned long idle_since = jiffies;
+
+    while (!kthread_should_stop()) {
+        if (ring_process(ring) > 0) {
+            idle_since = jiffies;
+            continue;
+        }
+        if (time_before(jiffies, idle_since + ring->idle_jiffies)) {
+            cond_resched();
+            continue;
+        }
+
+        set_current_state(TASK_INTERRUPTIBLE);
+        WRITE_ONCE(header->flags, TFLITE_RING_NEED_WAKEUP);
+        // Pairs with the barrier between the client's sq_tail and flags
+        smp_mb();
+        if (!ring_pending(ring) && !kthread_should_stop()) {
+            schedule();
         }
+        __set_current_state(TASK_RUNNING);
+        WRITE_ONCE(header->flags, 0);
+        idle_since = jiffies;
     }
-    return model;
+    return 0;
 }
 
-static int load_computation_graph(struct tensorflow_lite_model *model) {
-    if (!model || !model->graph) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Invalid model or graph\n");
+static long ioctl_setup_rings(struct session *session, void __user *argp) {
+    struct tflite_ioc_rings setup;
+    struct session_ring *ring;
+    size_t sq_offset, cq_offset, data_offset, ring_bytes;
+    struct tflite_ring_header *header;
+    long ret;
+
+    if (copy_from_user(&setup, argp, sizeof(setup))) {
+        return -EFAULT;
+    }
+    if ((setup.flags & ~(TFLITE_RING_SQPOLL | TFLITE_RING_ASYNC)) ||
+        (setup.flags & TFLITE_RING_SQPOLL && setup.flags & TFLITE_RING_ASYNC)) {
+        return -EINVAL;
+    }
+    if (!is_power_of_2(setup.sq_entries) || setup.sq_entries > TFLITE_RING_MAX_ENTRIES ||
+        !is_power_of_2(setup.cq_entries) || setup.cq_entries > 2 * TFLITE_RING_MAX_ENTRIES ||
+        setup.cq_entries < setup.sq_entries) {
+        return -EINVAL;
+    }
+    // The SQPOLL thread busy-polls a CPU for this long, so it is bounded
+    if (setup.sq_idle_ms > TFLITE_RING_MAX_IDLE_MS) {
+        return -EINVAL;
+    }
+    if (session->ring) {
+        return -EBUSY;
+    }
+
+    // Header, SQ and CQ, then the data area from a page boundary
+    sq_offset = ALIGN(sizeof(struct tflite_ring_header), SMP_CACHE_BYTES);
+    cq_offset = ALIGN(sq_offset + setup.sq_entries * sizeof(struct tflite_sqe), SMP_CACHE_BYTES);
+    data_offset = PAGE_ALIGN(cq_offset + setup.cq_entries * sizeof(struct tflite_cqe));
+    if (setup.data_bytes > INT_MAX - data_offset) {
         return -EINVAL;
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Computation graph loaded\n");
+    ring_bytes = PAGE_ALIGN(data_offset + setup.data_bytes);
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (!ring) {
+        return -ENOMEM;
+    }
+    ring->session = session;
+    ring->async = setup.flags & TFLITE_RING_ASYNC;
+    INIT_WORK(&ring->work, ring_work);
+    ring->memory = vmalloc_user(ring_bytes);
+    if (!ring->memory) {
+        kfree(ring);
+        return -ENOMEM;
+    }
+    ring->bytes = ring_bytes;
+    ring->header = ring->memory;
+    ring->sqes = (struct tflite_sqe *)((uint8_t *)ring->memory + sq_offset);
+    ring->cqes = (struct tflite_cqe *)((uint8_t *)ring->memory + cq_offset);
+    ring->data = (uint8_t *)ring->memory + data_offset;
+    ring->data_bytes = setup.data_bytes;
+    ring->sq_entries = setup.sq_entries;
+    ring->cq_entries = setup.cq_entries;
+    header = ring->header;
+    header->sq_mask = setup.sq_entries - 1;
+    header->cq_mask = setup.cq_entries - 1;
+
+    if (setup.flags & TFLITE_RING_SQPOLL) {
+        ring->idle_jiffies = msecs_to_jiffies(setup.sq_idle_ms);
+        ring->thread = kthread_run(ring_thread, ring, "tflite-sqpoll/%d", task_pid_nr(current));
+        if (IS_ERR(ring->thread)) {
+            ret = PTR_ERR(ring->thread);
+            ring->thread = NULL;
+            free_ring(ring);
+            return ret;
+        }
+    }
+
+    setup.sq_offset = sq_offset;
+    setup.cq_offset = cq_offset;
+    setup.data_offset = data_offset;
+    setup.ring_bytes = ring_bytes;
+    if (copy_to_user(argp, &setup, sizeof(setup))) {
+        free_ring(ring);
+        return -EFAULT;
+    }
+    // dev_mmap reads it without the session lock
+    smp_store_release(&session->ring, ring);
+    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Set up %u/%u entry rings with %llu data bytes%s\n",
+           setup.sq_entries, setup.cq_entries, setup.data_bytes, ring->thread ? " and SQ polling" : "");
     return 0;
 }
 
-static int execute_computation_graph(struct tensorflow_lite_model *model) {
-    int result = 0;
-    uint8_t *graph_data;
-    size_t offset;
+static long ioctl_ring_enter(struct session *session) {
+    struct session_ring *ring = session->ring;
 
-    if (!model || !model->graph) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: Invalid model or graph\n");
-        return -EINVAL;
+    if (!ring) {
+        return -ENOENT;
+    }
+    if (ring->thread) {
+        wake_up_process(ring->thread);
+        return 0;
+    }
+    if (ring->async) {
+        queue_work(exec_workqueue, &ring->work);
+        return 0;
     }
+    return ring_process(ring);
+}
+
+static long ioctl_set_eventfd(struct session *session, void __user *argp) {
+    struct eventfd_ctx *eventfd = NULL;
+    struct eventfd_ctx *old;
+    int fd;
 
-    // Implement the actual logic for executing the computation graph
-    // For simplicity, assume the graph is a sequence of operations that can be executed in order
-    // Iterate through the graph and execute each operation
-    graph_data = (uint8_t *)model->graph;
-    offset = 0;
-    while (offset < model->parameters) {
-        uint8_t operation = graph_data[offset];
-        offset++;
-        switch (operation) {
-            case 0x01: // Example operation code
-                // Perform the operation (placeholder)
-                result += graph_data[offset];
-                offset++;
-                break;
-            case 0x02: // Another example operation code
-                // Perform the operation (placeholder)
-                result *= graph_data[offset];
-                offset++;
-                break;
-            default:
-                printk(KERN_WARNING "TensorFlowLiteKernelInterpreter: Unknown operation code %u\n", operation);
-                break;
+    if (get_user(fd, (__s32 __user *)argp)) {
+        return -EFAULT;
+    }
+    if (fd >= 0) {
+        eventfd = eventfd_ctx_fdget(fd);
+        if (IS_ERR(eventfd)) {
+            return PTR_ERR(eventfd);
         }
     }
+    spin_lock(&session->event_lock);
+    old = session->eventfd;
+    session->eventfd = eventfd;
+    spin_unlock(&session->event_lock);
+    if (old) {
+        eventfd_ctx_put(old);
+    }
+    return 0;
+}
+
+static long ioctl_get_completion(struct session *session, void __user *argp) {
+    int result;
+    int ret;
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Computation graph executed with result %d\n", result);
-    return result;
+    ret = session_collect(session, &result);
+    if (ret < 0) {
+        return ret;
+    }
+    return put_user(result, (__s32 __user *)argp);
 }
 
-static int get_results(char *result_buffer, size_t buffer_size) {
-    int snprintf_ret;
-    struct sysinfo mem_info;
+// Commands using the session's binding or arena, which an asynchronous
+// execution owns until it completes
+static bool ioctl_uses_binding(unsigned int cmd) {
+    switch (cmd) {
+    case TFLITE_IOC_LOAD:
+    case TFLITE_IOC_UNLOAD:
+    case TFLITE_IOC_SET_INPUT:
+    case TFLITE_IOC_EXECUTE:
+    case TFLITE_IOC_GET_OUTPUT:
+    case TFLITE_IOC_RUN:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Entering get_results function\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: kernel_buffer before retrieving results: %s\n", kernel_buffer);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: result_buffer before retrieving results: %s\n", result_buffer);
+static long dev_ioctl(struct file *filep, unsigned int cmd, unsigned long arg) {
+    struct session *session = filep->private_data;
+    void __user *argp = (void __user *)arg;
+    int handle;
+    long ret;
 
-    // Log system memory usage before retrieving results
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory before retrieving results - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
+    mutex_lock(&session->lock);
+    if (session->exec_busy && ioctl_uses_binding(cmd)) {
+        mutex_unlock(&session->lock);
+        return -EBUSY;
+    }
+    switch (cmd) {
+    case TFLITE_IOC_GET_VERSION:
+        ret = put_user((__u32)TFLITE_IOC_VERSION, (__u32 __user *)argp);
+        break;
+    case TFLITE_IOC_LOAD:
+        ret = ioctl_load(session, argp);
+        break;
+    case TFLITE_IOC_UNLOAD:
+        ret = get_user(handle, (__s32 __user *)argp);
+        if (ret == 0) {
+            ret = session_unload_model(session, handle);
+        }
+        break;
+    case TFLITE_IOC_QUERY_METADATA:
+        ret = ioctl_query_metadata(argp);
+        break;
+    case TFLITE_IOC_SET_INPUT:
+        ret = ioctl_tensor(session, argp, true);
+        break;
+    case TFLITE_IOC_EXECUTE:
+        ret = ioctl_execute(session, argp);
+        break;
+    case TFLITE_IOC_GET_OUTPUT:
+        ret = ioctl_tensor(session, argp, false);
+        break;
+    case TFLITE_IOC_RUN:
+        ret = ioctl_run(session, argp);
+        break;
+    case TFLITE_IOC_SETUP_RINGS:
+        ret = ioctl_setup_rings(session, argp);
+        break;
+    case TFLITE_IOC_RING_ENTER:
+        ret = ioctl_ring_enter(session);
+        break;
+    case TFLITE_IOC_SET_EVENTFD:
+        ret = ioctl_set_eventfd(session, argp);
+        break;
+    case TFLITE_IOC_GET_COMPLETION:
+        ret = ioctl_get_completion(session, argp);
+        break;
+    default:
+        ret = -ENOTTY;
+        break;
+    }
+    mutex_unlock(&session->lock);
+    return ret;
+}
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: result_buffer before snprintf: %s\n", result_buffer);
+static void arena_vma_open(struct vm_area_struct *vma) {
+    struct session *session = vma->vm_private_data;
 
-    snprintf_ret = snprintf(result_buffer, buffer_size, "%s", kernel_buffer);
-    if (snprintf_ret < 0) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf failed with error code %d\n", snprintf_ret);
-        return snprintf_ret;
-    } else if (snprintf_ret >= buffer_size) {
-        printk(KERN_ALERT "TensorFlowLiteKernelInterpreter: snprintf output was truncated\n");
-        return -EINVAL;
+    spin_lock(&session->arena_lock);
+    session->arena_mappings++;
+    spin_unlock(&session->arena_lock);
+}
+
+static void arena_vma_close(struct vm_area_struct *vma) {
+    struct session *session = vma->vm_private_data;
+
+    spin_lock(&session->arena_lock);
+    session->arena_mappings--;
+    spin_unlock(&session->arena_lock);
+}
+
+static const struct vm_operations_struct arena_vm_ops = {
+    .open = arena_vma_open,
+    .close = arena_vma_close,
+};
+
+// Maps the tensor arena of the bound model, so inputs can be written and
+// outputs read in place without a copy, or the rings at their offset. The
+// mapping holds the file open, so the session outlives it.
+static int dev_mmap(struct file *filep, struct vm_area_struct *vma) {
+    struct session *session = filep->private_data;
+    struct session_ring *ring;
+    uint8_t *arena;
+    int ret;
+
+    if (vma->vm_pgoff == TFLITE_RING_MMAP_OFFSET >> PAGE_SHIFT) {
+        ring = smp_load_acquire(&session->ring);
+        if (!ring) {
+            return -ENOENT;
+        }
+        return remap_vmalloc_range(vma, ring->memory, 0);
     }
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: snprintf completed, result_buffer: %s\n", result_buffer);
 
-    // Log system memory usage after retrieving results
-    si_meminfo(&mem_info);
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Memory after retrieving results - Total: %lu, Free: %lu, Available: %lu\n",
-           mem_info.totalram, mem_info.freeram, mem_info.freeram + mem_info.bufferram);
+    spin_lock(&session->arena_lock);
+    arena = session->arena;
+    if (arena) {
+        session->arena_mappings++;
+    }
+    spin_unlock(&session->arena_lock);
+    if (!arena) {
+        return -ENOENT;
+    }
 
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Results retrieved\n");
-    printk(KERN_INFO "TensorFlowLiteKernelInterpreter: result_buffer after retrieving results: %s\n", result_buffer);
+    // Fails for ranges beyond the arena
+    ret = remap_vmalloc_range(vma, arena, vma->vm_pgoff);
+    if (ret < 0) {
+        spin_lock(&session->arena_lock);
+        session->arena_mappings--;
+        spin_unlock(&session->arena_lock);
+        return ret;
+    }
+    vma->vm_private_data = session;
+    vma->vm_ops = &arena_vm_ops;
     return 0;
 }
 
+// io_uring passthrough of the ioctls, see struct tflite_uring_cmd. Commands
+// can block, so at submission they are handed to io_uring's own workers,
+// where they run like the ioctl on the submitter's behalf.
+static int dev_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags) {
+    const struct tflite_uring_cmd *cmd = io_uring_sqe_cmd(ioucmd->sqe);
+
+    if (issue_flags & IO_URING_F_NONBLOCK) {
+        return -EAGAIN;
+    }
+    return dev_ioctl(ioucmd->file, ioucmd->cmd_op, (unsigned long)READ_ONCE(cmd->arg));
+}
+
+// Readable once an asynchronous execution has finished and while the CQ
+// has completions to reap
+static __poll_t dev_poll(struct file *filep, poll_table *wait) {
+    struct session *session = filep->private_data;
+    struct session_ring *ring = smp_load_acquire(&session->ring);
+    __poll_t mask = 0;
+
+    poll_wait(filep, &session->wait, wait);
+    if (READ_ONCE(session->exec_done)) {
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
+    if (ring && READ_ONCE(ring->header->cq_head) != READ_ONCE(ring->cq_tail)) {
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
+    return mask;
+}
+
+// The module stays loaded while any file, mapping or io_uring request holds
+// the device open, as sessions reference models, workers and ring threads
 static struct file_operations fops = {
+    .owner = THIS_MODULE,
     .open = dev_open,
     .read = dev_read,
     .write = dev_write,
+    .unlocked_ioctl = dev_ioctl,
+    // Every pointer travels as a __u64, so the layouts match for 32-bit callers
+    .compat_ioctl = compat_ptr_ioctl,
+    .mmap = dev_mmap,
+    .poll = dev_poll,
+    .uring_cmd = dev_uring_cmd,
     .release = dev_release,
 };
 
@@ -634,10 +1430,24 @@ static struct class* tensorflow_lite_class = NULL;
 static struct device* tensorflow_lite_device = NULL;
 
 static int __init tensorflow_lite_kernel_interpreter_init(void) {
+    int ret;
+
     printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Initializing the TensorFlowLiteKernelInterpreter\n");
 
+    ret = create_command_pools();
+    if (ret < 0) {
+        return ret;
+    }
+    exec_workqueue = alloc_workqueue("tflite_exec", WQ_UNBOUND, 0);
+    if (!exec_workqueue) {
+        destroy_command_pools();
+        return -ENOMEM;
+    }
+
     major_number = register_chrdev(0, DEVICE_NAME, &fops);
     if (major_number < 0) {
+        destroy_workqueue(exec_workqueue);
+        destroy_command_pools();
         printk(KERN_ALERT "TensorFlowLiteKernelInterpreter failed to register a major number\n");
         return major_number;
     }
@@ -647,6 +1457,8 @@ static int __init tensorflow_lite_kernel_interpreter_init(void) {
     tensorflow_lite_class = class_create(THIS_MODULE, CLASS_NAME);
     if (IS_ERR(tensorflow_lite_class)) {
         unregister_chrdev(major_number, DEVICE_NAME);
+        destroy_workqueue(exec_workqueue);
+        destroy_command_pools();
         printk(KERN_ALERT "Failed to register device class\n");
         return PTR_ERR(tensorflow_lite_class);
     }
@@ -657,6 +1469,8 @@ static int __init tensorflow_lite_kernel_interpreter_init(void) {
     if (IS_ERR(tensorflow_lite_device)) {
         class_destroy(tensorflow_lite_class);
         unregister_chrdev(major_number, DEVICE_NAME);
+        destroy_workqueue(exec_workqueue);
+        destroy_command_pools();
         printk(KERN_ALERT "Failed to create the device\n");
         return PTR_ERR(tensorflow_lite_device);
     }
@@ -666,10 +1480,22 @@ static int __init tensorflow_lite_kernel_interpreter_init(void) {
 }
 
 static void __exit tensorflow_lite_kernel_interpreter_exit(void) {
+    struct loaded_model *model;
+    int handle;
+
     device_destroy(tensorflow_lite_class, MKDEV(major_number, 0));
     class_unregister(tensorflow_lite_class);
     class_destroy(tensorflow_lite_class);
     unregister_chrdev(major_number, DEVICE_NAME);
+    destroy_workqueue(exec_workqueue);
+
+    // Sessions unload their models when closed, and no session outlives the
+    // module, so only models without references can be left here
+    idr_for_each_entry(&model_handles, model, handle) {
+        free_model(model);
+    }
+    idr_destroy(&model_handles);
+    destroy_command_pools();
     printk(KERN_INFO "TensorFlowLiteKernelInterpreter: Goodbye from the TensorFlowLiteKernelInterpreter\n");
 }
 
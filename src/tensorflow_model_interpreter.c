@@ -3,6 +3,8 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/err.h>
+#include "tensor_ops.h"
 
 #define DEVICE_NAME "tensorflow_model_interpreter"
 #define CLASS_NAME "tensorflow"
@@ -14,6 +16,8 @@ MODULE_VERSION("0.1");
 
 static int major_number;
 static char *kernel_buffer;
+// Loaded model, mapped read-only from the page cache
+static struct model_mapping *model_mapping = NULL;
 static struct class *tensorflow_class = NULL;
 static struct device *tensorflow_device = NULL;
 
@@ -28,16 +32,14 @@ static int dev_release(struct inode *inodep, struct file *filep) {
 }
 
 static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *offset) {
-    int error_count = 0;
-    error_count = copy_to_user(buffer, kernel_buffer, len);
+    ssize_t ret = simple_read_from_buffer(buffer, len, offset, kernel_buffer, strnlen(kernel_buffer, 1024));
 
-    if (error_count == 0) {
-        printk(KERN_INFO "TensorFlowModelInterpreter: Sent %zu characters to the user\n", len);
-        return 0;
+    if (ret >= 0) {
+        printk(KERN_INFO "TensorFlowModelInterpreter: Sent %zd characters to the user\n", ret);
     } else {
-        printk(KERN_INFO "TensorFlowModelInterpreter: Failed to send %d characters to the user\n", error_count);
-        return -EFAULT;
+        printk(KERN_INFO "TensorFlowModelInterpreter: Failed to send characters to the user\n");
     }
+    return ret;
 }
 
 static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset) {
@@ -80,47 +82,18 @@ static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, lof
     return len;
 }
 
-// Function to load the model from the specified path into kernel memory
+// Function to map the model at the specified path from the page cache. The
+// weights are used in place and shared with every other user of the file.
 static int load_model(const char *model_path) {
-    struct file *model_file;
-    mm_segment_t old_fs;
-    loff_t pos = 0;
-    int ret;
-    size_t file_size;
-    void *model_data;
-
-    old_fs = get_fs();
-    set_fs(KERNEL_DS);
-
-    model_file = filp_open(model_path, O_RDONLY, 0);
-    if (IS_ERR(model_file)) {
-        printk(KERN_ALERT "TensorFlowModelInterpreter: Failed to open model file %s\n", model_path);
-        set_fs(old_fs);
-        return PTR_ERR(model_file);
-    }
-
-    file_size = i_size_read(file_inode(model_file));
-    model_data = kmalloc(file_size, GFP_KERNEL);
-    if (!model_data) {
-        printk(KERN_ALERT "TensorFlowModelInterpreter: Failed to allocate memory for model data\n");
-        filp_close(model_file, NULL);
-        set_fs(old_fs);
-        return -ENOMEM;
-    }
+    struct model_mapping *mapping = tensor_ops_model_map(model_path);
 
-    ret = kernel_read(model_file, model_data, file_size, &pos);
-    if (ret < 0) {
-        printk(KERN_ALERT "TensorFlowModelInterpreter: Failed to read model file %s\n", model_path);
-        kfree(model_data);
-        filp_close(model_file, NULL);
-        set_fs(old_fs);
-        return ret;
+    if (IS_ERR(mapping)) {
+        printk(KERN_ALERT "TensorFlowModelInterpreter: Failed to map model file %s\n", model_path);
+        return PTR_ERR(mapping);
     }
 
-    filp_close(model_file, NULL);
-    set_fs(old_fs);
-
-    kernel_buffer = model_data;
+    tensor_ops_model_unmap(model_mapping);
+    model_mapping = mapping;
     printk(KERN_INFO "TensorFlowModelInterpreter: Model loaded from %s\n", model_path);
     return 0;
 }
@@ -130,11 +103,15 @@ static int execute_model(void) {
     // For simplicity, assume the model is a simple function that can be executed
     int ret;
 
-    // Assume the model has been loaded into kernel_buffer
+    if (!model_mapping) {
+        printk(KERN_ALERT "TensorFlowModelInterpreter: No model loaded\n");
+        return -ENOENT;
+    }
+
     // Custom model execution logic
     // Example: Interpret the model data and execute it as a function
     // This is a placeholder for the actual execution logic
-    ret = interpret_and_execute_model(kernel_buffer);
+    ret = interpret_and_execute_model((const char *)model_mapping->data);
 
     // Store the results in kernel_buffer
     snprintf(kernel_buffer, 1024, "Model execution result: %d", ret);
@@ -143,7 +120,7 @@ static int execute_model(void) {
     return 0;
 }
 
-static int interpret_and_execute_model(char *model_data) {
+static int interpret_and_execute_model(const char *model_data) {
     // Custom logic to interpret and execute the TensorFlow model data
     int result = 0;
 
@@ -173,7 +150,7 @@ static int interpret_and_execute_model(char *model_data) {
     return result;
 }
 
-static struct tensorflow_model *parse_tensorflow_model(char *model_data) {
+static struct tensorflow_model *parse_tensorflow_model(const char *model_data) {
     struct tensorflow_model *model = kmalloc(sizeof(struct tensorflow_model), GFP_KERNEL);
     if (!model) {
         printk(KERN_ALERT "TensorFlowModelInterpreter: Failed to allocate memory for model\n");
@@ -309,6 +286,7 @@ static int __init tensorflow_model_interpreter_init(void) {
 
 static void __exit tensorflow_model_interpreter_exit(void) {
     kfree(kernel_buffer);
+    tensor_ops_model_unmap(model_mapping);
     device_destroy(tensorflow_class, MKDEV(major_number, 0));
     class_unregister(tensorflow_class);
     class_destroy(tensorflow_class);
@@ -4,53 +4,32 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
-#include <linux/vmalloc.h>
+#include <linux/err.h>
+#include "tensor_ops.h"
 
 #define MODEL_PATH "/path/to/tensorflow/model"
 
 // Data structures to represent a TensorFlow model within the kernel
 struct tf_model {
-    void *model_data;
+    struct model_mapping *mapping;
+    const void *model_data;
     size_t model_size;
     // Add additional fields as needed
 };
 
-// Function to load a TensorFlow model from a file
+// Function to load a TensorFlow model from a file. The file is mapped from
+// the page cache rather than copied, and shared with every other user of it.
 int load_tf_model(struct tf_model *model, const char *path) {
-    struct file *model_file;
-    mm_segment_t old_fs;
-    loff_t pos = 0;
-
-    old_fs = get_fs();
-    set_fs(KERNEL_DS);
-
-    model_file = filp_open(path, O_RDONLY, 0);
-    if (IS_ERR(model_file)) {
-        printk(KERN_ERR "Failed to open TensorFlow model file\n");
-        set_fs(old_fs);
-        return PTR_ERR(model_file);
-    }
-
-    model->model_size = i_size_read(file_inode(model_file));
-    model->model_data = vmalloc(model->model_size);
-    if (!model->model_data) {
-        printk(KERN_ERR "Failed to allocate memory for TensorFlow model\n");
-        filp_close(model_file, NULL);
-        set_fs(old_fs);
-        return -ENOMEM;
-    }
+    struct model_mapping *mapping = tensor_ops_model_map(path);
 
-    if (kernel_read(model_file, model->model_data, model->model_size, &pos) != model->model_size) {
-        printk(KERN_ERR "Failed to read TensorFlow model file\n");
-        vfree(model->model_data);
-        filp_close(model_file, NULL);
-        set_fs(old_fs);
-        return -EIO;
+    if (IS_ERR(mapping)) {
+        printk(KERN_ERR "Failed to map TensorFlow model file\n");
+        return PTR_ERR(mapping);
     }
 
-    filp_close(model_file, NULL);
-    set_fs(old_fs);
-
+    model->mapping = mapping;
+    model->model_data = model->mapping->data;
+    model->model_size = model->mapping->size;
     return 0;
 }
 
@@ -70,7 +49,7 @@ int execute_tf_model(struct tf_model *model, void *input_data, size_t input_size
 
     // Perform inference using the model
     // (This is a placeholder. Actual implementation will depend on the model and inference logic)
-    void *inference_output = model->model_data; // Placeholder for inference output
+    const void *inference_output = model->model_data; // Placeholder for inference output
 
     // Handle the output data
     // (This is a placeholder. Actual implementation will depend on the model and output data format)
@@ -81,9 +60,9 @@ int execute_tf_model(struct tf_model *model, void *input_data, size_t input_size
 
 // Function to clean up resources allocated for TensorFlow model execution
 void cleanup_tf_model(struct tf_model *model) {
-    if (model->model_data) {
-        vfree(model->model_data);
-    }
+    tensor_ops_model_unmap(model->mapping);
+    model->mapping = NULL;
+    model->model_data = NULL;
 }
 
 // Initialization function for the TensorFlow model execution module
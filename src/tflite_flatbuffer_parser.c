@@ -3,21 +3,50 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/err.h>
+#include <linux/mm.h>
 #include <flatbuffers/flatbuffers.h>
 #include "schema_v3c_generated.h"
+#include "tensor_ops.h"
+#include "tflite_plan.h"
+#include "tflite_trace.h"
 
 #define DEVICE_NAME "tflite_parser_device"
 #define CLASS_NAME "tflite_parser"
+#define TFLITE_ARENA_ALIGNMENT 64
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("kasinadhsarma, Devin");
 MODULE_DESCRIPTION("A kernel module for parsing and executing TensorFlow Lite models");
 MODULE_VERSION("0.1");
 
+static int parse_model(const char *model_data, size_t model_size);
+static int load_model_file(const char *model_path);
+static void free_plan(void);
+static void free_model(void);
+static struct tflite_plan *prepare_model(const tflite::Model *model);
+static void destroy_plan(struct tflite_plan *plan);
+static int invoke_plan(const struct tflite_plan *plan, uint8_t *arena);
+static int benchmark_model(unsigned int iterations);
+
 static int major_number;
 static char *kernel_buffer;
 static struct class *tflite_parser_class = NULL;
 static struct device *tflite_parser_device = NULL;
+static DEFINE_MUTEX(parser_mutex);
+
+// Model file contents, mapped read-only from the page cache
+static struct model_mapping *model_file = NULL;
+
+// Execution plan built by prepare_model() and the arena it runs against
+static struct tflite_plan *model_plan = NULL;
+static uint8_t *plan_arena = NULL;
 
 static int dev_open(struct inode *inodep, struct file *filep) {
     printk(KERN_INFO "TFLiteParserDevice: Device opened\n");
@@ -30,276 +59,1276 @@ static int dev_release(struct inode *inodep, struct file *filep) {
 }
 
 static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *offset) {
-    int error_count = 0;
-    error_count = copy_to_user(buffer, kernel_buffer, len);
+    ssize_t ret;
 
-    if (error_count == 0) {
-        printk(KERN_INFO "TFLiteParserDevice: Sent %zu characters to the user\n", len);
-        return 0;
+    mutex_lock(&parser_mutex);
+    ret = simple_read_from_buffer(buffer, len, offset, kernel_buffer, strnlen(kernel_buffer, 1024));
+    mutex_unlock(&parser_mutex);
+
+    if (ret >= 0) {
+        printk(KERN_INFO "TFLiteParserDevice: Sent %zd characters to the user\n", ret);
     } else {
-        printk(KERN_INFO "TFLiteParserDevice: Failed to send %d characters to the user\n", error_count);
-        return -EFAULT;
+        printk(KERN_INFO "TFLiteParserDevice: Failed to send characters to the user\n");
     }
+    return ret;
 }
 
 static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset) {
-    snprintf(kernel_buffer, 1024, "%s(%zu letters)", buffer, len);
+    char command_buffer[256];
+    size_t command_len = min(len, sizeof(command_buffer) - 1);
+    char *command;
+    int ret = 0;
+
+    if (copy_from_user(command_buffer, buffer, command_len)) {
+        return -EFAULT;
+    }
+    command_buffer[command_len] = '\0';
+    command = strim(command_buffer);
     printk(KERN_INFO "TFLiteParserDevice: Received %zu characters from the user\n", len);
 
+    mutex_lock(&parser_mutex);
+
     // Command handling logic
-    if (strncmp(buffer, "PARSE_MODEL", 11) == 0) {
-        // Handle model parsing
+    if (strncmp(command, "PARSE_MODEL", 11) == 0) {
+        // Handle model parsing; an optional path loads a new model first
+        const char *model_path = skip_spaces(command + 11);
         printk(KERN_INFO "TFLiteParserDevice: Parsing model\n");
-        int ret = parse_model(kernel_buffer);
+        if (*model_path) {
+            ret = load_model_file(model_path);
+        } else if (!model_file) {
+            ret = -ENOENT;
+        }
+        if (ret == 0) {
+            ret = parse_model((const char *)model_file->data, model_file->size);
+        }
         if (ret < 0) {
             printk(KERN_ALERT "TFLiteParserDevice: Failed to parse model\n");
         }
+    } else if (strncmp(command, "BENCHMARK_MODEL", 15) == 0) {
+        // Handle throughput measurement over repeated inferences
+        unsigned int iterations = 100;
+        const char *arg = skip_spaces(command + 15);
+        if (*arg && kstrtouint(arg, 10, &iterations) < 0) {
+            ret = -EINVAL;
+        } else {
+            ret = benchmark_model(iterations);
+        }
+        if (ret < 0) {
+            printk(KERN_ALERT "TFLiteParserDevice: Failed to benchmark model\n");
+        }
     } else {
         printk(KERN_INFO "TFLiteParserDevice: Unknown command\n");
     }
 
-    return len;
+    mutex_unlock(&parser_mutex);
+    return ret < 0 ? ret : len;
 }
 
-// Function to parse the TensorFlow Lite model from the kernel buffer
-static int parse_model(const char *model_data) {
-    flatbuffers::Verifier verifier((const uint8_t *)model_data, 1024);
-    if (!tflite::VerifyModelBuffer(verifier)) {
-        printk(KERN_ALERT "TFLiteParserDevice: Invalid model buffer\n");
-        return -EINVAL;
+// Function to map a TensorFlow Lite model file from the page cache; weights
+// are used in place and shared with every other user of the same file
+static int load_model_file(const char *model_path) {
+    struct model_mapping *mapping = tensor_ops_model_map(model_path);
+
+    if (IS_ERR(mapping)) {
+        printk(KERN_ALERT "TFLiteParserDevice: Failed to map model file %s\n", model_path);
+        return PTR_ERR(mapping);
     }
 
-    const tflite::Model *model = tflite::GetModel(model_data);
-    if (model == NULL) {
-        printk(KERN_ALERT "TFLiteParserDevice: Failed to get model from buffer\n");
+    free_model();
+    model_file = mapping;
+
+    printk(KERN_INFO "TFLiteParserDevice: Loaded %zu byte model from %s\n", mapping->size, model_path);
+    return 0;
+}
+
+static void free_plan(void) {
+    destroy_plan(model_plan);
+    vfree(plan_arena);
+    model_plan = NULL;
+    plan_arena = NULL;
+}
+
+static void free_model(void) {
+    free_plan();
+    tensor_ops_model_unmap(model_file);
+    model_file = NULL;
+}
+
+// Older converters only fill deprecated_builtin_code, newer ones builtin_code
+static int tflite_builtin_code(const tflite::OperatorCode *op_code) {
+    return max((int)op_code->builtin_code(), (int)op_code->deprecated_builtin_code());
+}
+
+static size_t tensor_type_size(tflite::TensorType type) {
+    switch (type) {
+        case tflite::TensorType_FLOAT32:
+        case tflite::TensorType_INT32:
+            return 4;
+        case tflite::TensorType_INT64:
+            return 8;
+        case tflite::TensorType_INT16:
+            return 2;
+        case tflite::TensorType_UINT8:
+        case tflite::TensorType_INT8:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static size_t tensor_num_elements(const tflite::Tensor *tensor) {
+    size_t count = 1;
+
+    if (!tensor->shape()) {
+        return 0;
+    }
+    for (auto dim : *tensor->shape()) {
+        if (dim <= 0) {
+            return 0;
+        }
+        count *= dim;
+    }
+    return count;
+}
+
+// Expand a tensor shape of rank <= 4 to NHWC by prepending ones
+static int tensor_dims4(const tflite::Tensor *tensor, int *dims) {
+    int rank = tensor->shape() ? tensor->shape()->size() : 0;
+    int i;
+
+    if (rank > 4) {
         return -EINVAL;
     }
+    for (i = 0; i < 4 - rank; i++) {
+        dims[i] = 1;
+    }
+    for (i = 0; i < rank; i++) {
+        dims[4 - rank + i] = tensor->shape()->Get(i);
+    }
+    return 0;
+}
 
-    printk(KERN_INFO "TFLiteParserDevice: Model has %d subgraphs\n", model->subgraphs()->size());
+// Quantization parameters are read as raw float bits so no FPU state is used
+static uint32_t tensor_scale_bits(const tflite::Tensor *tensor, int channel) {
+    const tflite::QuantizationParameters *quant = tensor->quantization();
+    uint32_t bits = TENSOR_OPS_FLOAT_ONE_BITS;
 
-    // Iterate over subgraphs
+    if (quant && quant->scale() && quant->scale()->size() > 0) {
+        int index = quant->scale()->size() > 1 ? channel : 0;
+        memcpy(&bits, quant->scale()->Data() + index, sizeof(bits));
+    }
+    return bits;
+}
+
+// Per-channel scales are read by output channel, so a filter has one scale
+// per output channel or a single scale for the whole tensor
+static bool tensor_scales_are_valid(const tflite::Tensor *tensor, int channels) {
+    const tflite::QuantizationParameters *quant = tensor->quantization();
+    uint32_t count = quant && quant->scale() ? quant->scale()->size() : 0;
+
+    return count <= 1 || count == (uint32_t)channels;
+}
+
+static uint8_t tensor_xor_mask(const tflite::Tensor *tensor) {
+    return tensor->type() == tflite::TensorType_INT8 ? TENSOR_OPS_INT8_XOR : 0;
+}
+
+// Zero point mapped onto the unsigned domain the kernels operate in
+static int32_t tensor_zero_point(const tflite::Tensor *tensor) {
+    const tflite::QuantizationParameters *quant = tensor->quantization();
+    int32_t zero_point = 0;
+
+    if (quant && quant->zero_point() && quant->zero_point()->size() > 0) {
+        zero_point = (int32_t)quant->zero_point()->Get(0);
+    }
+    return zero_point + (tensor_xor_mask(tensor) ? 128 : 0);
+}
+
+// Zero point as stored in the model, for describing tensors to callers
+static int32_t tensor_model_zero_point(const tflite::Tensor *tensor) {
+    const tflite::QuantizationParameters *quant = tensor->quantization();
+
+    if (quant && quant->zero_point() && quant->zero_point()->size() > 0) {
+        return (int32_t)quant->zero_point()->Get(0);
+    }
+    return 0;
+}
+
+static bool tensor_is_quantized8(const tflite::Tensor *tensor) {
+    return tensor->type() == tflite::TensorType_UINT8 || tensor->type() == tflite::TensorType_INT8;
+}
+
+// Read the raw bits of a float field from an options table
+static uint32_t options_float_bits(const void *options, flatbuffers::voffset_t field, uint32_t default_bits) {
+    if (!options) {
+        return default_bits;
+    }
+    return reinterpret_cast<const flatbuffers::Table *>(options)->GetField<uint32_t>(field, default_bits);
+}
+
+// Clamp range of a fused activation in the output's quantized domain
+static int compute_activation_range(tflite::ActivationFunctionType activation, const tflite::Tensor *output,
+                                    int32_t *act_min, int32_t *act_max) {
+    int32_t zero_point = tensor_zero_point(output);
+    struct quant_multiplier inv_scale;
+    int ret;
+
+    *act_min = 0;
+    *act_max = 255;
+    if (activation == tflite::ActivationFunctionType_NONE) {
+        return 0;
+    }
+
+    ret = tensor_ops_quantize_ratio(TENSOR_OPS_FLOAT_ONE_BITS, TENSOR_OPS_FLOAT_ONE_BITS,
+                                    tensor_scale_bits(output, 0), 0, &inv_scale);
+    if (ret < 0) {
+        return ret;
+    }
+
+    switch (activation) {
+        case tflite::ActivationFunctionType_RELU:
+            *act_min = max(0, zero_point);
+            break;
+        case tflite::ActivationFunctionType_RELU6:
+            *act_min = max(0, zero_point);
+            *act_max = min(255, zero_point + tensor_ops_multiply_by_quantized_multiplier(6, &inv_scale));
+            break;
+        case tflite::ActivationFunctionType_RELU_N1_TO_1:
+            *act_min = max(0, zero_point - tensor_ops_multiply_by_quantized_multiplier(1, &inv_scale));
+            *act_max = min(255, zero_point + tensor_ops_multiply_by_quantized_multiplier(1, &inv_scale));
+            break;
+        default:
+            return -EINVAL;
+    }
+    return 0;
+}
+
+static bool index_is_valid(int32_t idx, uint32_t size) {
+    return idx >= 0 && (uint32_t)idx < size;
+}
+
+// The verifier only checks that the flatbuffer is well formed. Every index
+// that selects a tensor, buffer or operator code is checked here, before
+// anything uses it to index a table or a kernel array.
+static int validate_model(const tflite::Model *model) {
+    if (!model->subgraphs() || model->subgraphs()->size() == 0 || !model->buffers() || !model->operator_codes()) {
+        return -EINVAL;
+    }
     for (auto subgraph : *model->subgraphs()) {
-        if (subgraph == NULL) {
-            printk(KERN_ALERT "TFLiteParserDevice: Subgraph is NULL\n");
+        uint32_t num_tensors;
+
+        if (!subgraph->tensors() || !subgraph->operators() || !subgraph->inputs() || !subgraph->outputs()) {
             return -EINVAL;
         }
-        printk(KERN_INFO "TFLiteParserDevice: Subgraph has %d tensors\n", subgraph->tensors()->size());
-
-        // Iterate over tensors
+        num_tensors = subgraph->tensors()->size();
         for (auto tensor : *subgraph->tensors()) {
-            if (tensor == NULL) {
-                printk(KERN_ALERT "TFLiteParserDevice: Tensor is NULL\n");
+            if (tensor->buffer() >= model->buffers()->size()) {
                 return -EINVAL;
             }
-            printk(KERN_INFO "TFLiteParserDevice: Tensor type: %d\n", tensor->type());
-            printk(KERN_INFO "TFLiteParserDevice: Tensor shape: ");
-            for (auto dim : *tensor->shape()) {
-                printk(KERN_CONT "%d ", dim);
-            }
-            printk(KERN_CONT "\n");
-
-            // Handle tensor data buffer
-            const tflite::Buffer *buffer = model->buffers()->Get(tensor->buffer());
-            if (buffer == NULL || buffer->data() == NULL) {
-                printk(KERN_INFO "TFLiteParserDevice: Tensor has no data buffer\n");
-            } else {
-                printk(KERN_INFO "TFLiteParserDevice: Tensor data size: %d\n", buffer->data()->size());
-            }
         }
-
-        // Iterate over operators
         for (auto op : *subgraph->operators()) {
-            if (op == NULL) {
-                printk(KERN_ALERT "TFLiteParserDevice: Operator is NULL\n");
+            if (!op->inputs() || !op->outputs() || op->opcode_index() >= model->operator_codes()->size()) {
                 return -EINVAL;
             }
-            const tflite::OperatorCode *op_code = model->operator_codes()->Get(op->opcode_index());
-            if (op_code == NULL) {
-                printk(KERN_ALERT "TFLiteParserDevice: Operator code is NULL\n");
+            // Optional inputs are encoded as -1
+            for (auto idx : *op->inputs()) {
+                if (idx != -1 && !index_is_valid(idx, num_tensors)) {
+                    return -EINVAL;
+                }
+            }
+            for (auto idx : *op->outputs()) {
+                if (!index_is_valid(idx, num_tensors)) {
+                    return -EINVAL;
+                }
+            }
+        }
+        for (auto idx : *subgraph->inputs()) {
+            if (!index_is_valid(idx, num_tensors)) {
                 return -EINVAL;
             }
-            printk(KERN_INFO "TFLiteParserDevice: Operator code: %d\n", op_code->builtin_code());
-
-            // Example: Handle ADD operator
-            if (op_code->builtin_code() == tflite::BuiltinOperator_ADD) {
-                printk(KERN_INFO "TFLiteParserDevice: Handling ADD operator\n");
-                // Add logic to execute ADD operator
-                execute_add_operator(op, subgraph, model);
-            } else if (op_code->builtin_code() == tflite::BuiltinOperator_MUL) {
-                printk(KERN_INFO "TFLiteParserDevice: Handling MUL operator\n");
-                // Add logic to execute MUL operator
-                execute_mul_operator(op, subgraph, model);
-            } else if (op_code->builtin_code() == tflite::BuiltinOperator_SUB) {
-                printk(KERN_INFO "TFLiteParserDevice: Handling SUB operator\n");
-                // Add logic to execute SUB operator
-                execute_sub_operator(op, subgraph, model);
-            } else {
-                printk(KERN_INFO "TFLiteParserDevice: Unsupported operator\n");
+        }
+        for (auto idx : *subgraph->outputs()) {
+            if (!index_is_valid(idx, num_tensors)) {
+                return -EINVAL;
             }
         }
     }
+    return 0;
+}
+
+// Function to parse the TensorFlow Lite model from the kernel buffer
+static int parse_model(const char *model_data, size_t model_size) {
+    flatbuffers::Verifier verifier((const uint8_t *)model_data, model_size);
+    if (!tflite::VerifyModelBuffer(verifier)) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid model buffer\n");
+        return -EINVAL;
+    }
+
+    const tflite::Model *model = tflite::GetModel(model_data);
+    if (model == NULL || validate_model(model) < 0) {
+        printk(KERN_ALERT "TFLiteParserDevice: Failed to get model from buffer\n");
+        return -EINVAL;
+    }
+
+    // Release the plan of a previously parsed model but keep the model file
+    free_plan();
+
+    model_plan = prepare_model(model);
+    if (IS_ERR(model_plan)) {
+        int ret = PTR_ERR(model_plan);
+        printk(KERN_ALERT "TFLiteParserDevice: Failed to prepare model\n");
+        model_plan = NULL;
+        return ret;
+    }
+
+    plan_arena = (uint8_t *)vzalloc(max_t(size_t, model_plan->arena_size, 1));
+    if (!plan_arena) {
+        printk(KERN_ALERT "TFLiteParserDevice: Failed to allocate %zu byte tensor arena\n", model_plan->arena_size);
+        free_plan();
+        return -ENOMEM;
+    }
+    printk(KERN_INFO "TFLiteParserDevice: Prepared %d operators, tensor arena %zu bytes\n",
+           model_plan->num_entries, model_plan->arena_size);
+
+    return invoke_plan(model_plan, plan_arena);
+}
 
+// Function to run a prepared plan; no flatbuffer data is touched here
+static int invoke_plan(const struct tflite_plan *plan, uint8_t *arena) {
+    const struct tflite_plan_entry *entry = plan->entries;
+    const struct tflite_plan_entry *end = plan->entries + plan->num_entries;
+    int ret;
+
+    for (; entry < end; entry++) {
+        trace_tflite_op_begin(entry, entry - plan->entries, arena);
+        ret = entry->kernel(entry, arena);
+        trace_tflite_op_end(entry, entry - plan->entries, arena, ret);
+        if (ret < 0) {
+            return ret;
+        }
+    }
     return 0;
 }
 
-static void execute_add_operator(const tflite::Operator *op, const tflite::SubGraph *subgraph, const tflite::Model *model) {
-    // Get input and output tensor indices
-    int input1_idx = op->inputs()->Get(0);
-    int input2_idx = op->inputs()->Get(1);
-    int output_idx = op->outputs()->Get(0);
+// Function to measure inference throughput over repeated invocations
+static int benchmark_model(unsigned int iterations) {
+    ktime_t start;
+    u64 elapsed_ns;
+    unsigned int i;
+    int ret;
 
-    // Get input and output tensors
-    const tflite::Tensor *input1 = subgraph->tensors()->Get(input1_idx);
-    const tflite::Tensor *input2 = subgraph->tensors()->Get(input2_idx);
-    const tflite::Tensor *output = subgraph->tensors()->Get(output_idx);
+    if (!model_plan) {
+        printk(KERN_ALERT "TFLiteParserDevice: No model parsed\n");
+        return -ENOENT;
+    }
+    if (iterations == 0) {
+        return -EINVAL;
+    }
 
-    // Validate tensors
-    if (input1 == NULL || input2 == NULL || output == NULL) {
-        printk(KERN_ALERT "TFLiteParserDevice: One or more tensors are NULL in ADD operator\n");
-        return;
+    start = ktime_get();
+    for (i = 0; i < iterations; i++) {
+        ret = invoke_plan(model_plan, plan_arena);
+        if (ret < 0) {
+            return ret;
+        }
+        cond_resched();
     }
+    elapsed_ns = max_t(u64, ktime_to_ns(ktime_sub(ktime_get(), start)), 1);
 
-    // Validate tensor shapes
-    if (input1->shape()->Length() != input2->shape()->Length() || input1->shape()->Length() != output->shape()->Length()) {
-        printk(KERN_ALERT "TFLiteParserDevice: Tensor shapes are incompatible in ADD operator\n");
-        return;
+    snprintf(kernel_buffer, 1024,
+             "iterations=%u total_ns=%llu avg_ns=%llu inferences_per_sec=%llu\n",
+             iterations, elapsed_ns, div_u64(elapsed_ns, iterations),
+             div64_u64((u64)iterations * NSEC_PER_SEC, elapsed_ns));
+    printk(KERN_INFO "TFLiteParserDevice: Benchmark %s", kernel_buffer);
+    return 0;
+}
+
+static int run_conv_2d(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    tensor_ops_conv2d_q8(&entry->params.conv,
+                         entry->inputs[0].dims, tflite_input_data(&entry->inputs[0], arena),
+                         entry->inputs[1].dims, entry->inputs[1].constant,
+                         (const int32_t *)entry->inputs[2].constant,
+                         entry->output.dims, tflite_output_data(&entry->output, arena));
+    return 0;
+}
+
+static int run_conv_2d_f32(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    return tensor_ops_conv2d_f32(&entry->params.fconv,
+                                 entry->inputs[0].dims, (const float *)tflite_input_data(&entry->inputs[0], arena),
+                                 entry->inputs[1].dims,
+                                 entry->output.dims, (float *)tflite_output_data(&entry->output, arena),
+                                 (float *)tflite_scratch_data(entry, arena));
+}
+
+static int run_depthwise_conv_2d(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    tensor_ops_depthwise_conv2d_q8(&entry->params.conv,
+                                   entry->inputs[0].dims, tflite_input_data(&entry->inputs[0], arena),
+                                   entry->inputs[1].dims, entry->inputs[1].constant,
+                                   (const int32_t *)entry->inputs[2].constant,
+                                   entry->output.dims, tflite_output_data(&entry->output, arena));
+    return 0;
+}
+
+static int run_average_pool_2d(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    tensor_ops_average_pool2d_q8(&entry->params.pool,
+                                 entry->inputs[0].dims, tflite_input_data(&entry->inputs[0], arena),
+                                 entry->output.dims, tflite_output_data(&entry->output, arena));
+    return 0;
+}
+
+static int run_reshape(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    const uint8_t *input = tflite_input_data(&entry->inputs[0], arena);
+    uint8_t *output = tflite_output_data(&entry->output, arena);
+
+    if (input != output) {
+        memcpy(output, input, entry->output.bytes);
     }
+    return 0;
+}
 
-    // Get input and output data buffers
-    const tflite::Buffer *input1_buffer = model->buffers()->Get(input1->buffer());
-    const tflite::Buffer *input2_buffer = model->buffers()->Get(input2->buffer());
-    tflite::Buffer *output_buffer = model->buffers()->Get(output->buffer());
+static int run_softmax(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    const int depth = entry->output.dims[3];
 
-    // Validate buffers
-    if (input1_buffer == NULL || input2_buffer == NULL || output_buffer == NULL) {
-        printk(KERN_ALERT "TFLiteParserDevice: One or more buffers are NULL in ADD operator\n");
-        return;
+    tensor_ops_softmax_q8(entry->params.softmax, entry->output.bytes / depth, depth,
+                          tflite_input_data(&entry->inputs[0], arena),
+                          tflite_output_data(&entry->output, arena));
+    return 0;
+}
+
+static int run_fully_connected(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    const struct qfc_params *params = &entry->params.fully_connected;
+
+    tensor_ops_fully_connected_q8(params, entry->output.bytes / params->output_depth,
+                                  tflite_input_data(&entry->inputs[0], arena),
+                                  tflite_output_data(&entry->output, arena),
+                                  (int32_t *)tflite_scratch_data(entry, arena));
+    return 0;
+}
+
+static int run_add(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    tensor_ops_broadcast_q8(&entry->broadcast, TENSOR_OPS_BINARY_ADD, &entry->params.elementwise,
+                            tflite_input_data(&entry->inputs[0], arena), tflite_input_data(&entry->inputs[1], arena),
+                            tflite_output_data(&entry->output, arena), (uint8_t *)tflite_scratch_data(entry, arena));
+    return 0;
+}
+
+static int run_sub(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    tensor_ops_broadcast_q8(&entry->broadcast, TENSOR_OPS_BINARY_SUB, &entry->params.elementwise,
+                            tflite_input_data(&entry->inputs[0], arena), tflite_input_data(&entry->inputs[1], arena),
+                            tflite_output_data(&entry->output, arena), (uint8_t *)tflite_scratch_data(entry, arena));
+    return 0;
+}
+
+static int run_mul(const struct tflite_plan_entry *entry, uint8_t *arena) {
+    tensor_ops_broadcast_q8(&entry->broadcast, TENSOR_OPS_BINARY_MUL, &entry->params.elementwise,
+                            tflite_input_data(&entry->inputs[0], arena), tflite_input_data(&entry->inputs[1], arena),
+                            tflite_output_data(&entry->output, arena), (uint8_t *)tflite_scratch_data(entry, arena));
+    return 0;
+}
+
+// A bias, when present, holds one value of the given type per output channel
+static bool bias_is_valid(const struct tflite_plan_entry *entry, int type, int channels) {
+    const struct tflite_plan_operand *bias = &entry->inputs[2];
+
+    if (entry->num_inputs <= 2 || bias->tensor_index < 0) {
+        return true;
     }
+    return bias->type == type && bias->bytes >= (size_t)channels * sizeof(int32_t);
+}
 
-    // Handle quantization parameters
-    float input1_scale = input1->quantization() ? input1->quantization()->scale()->Get(0) : 1.0f;
-    int32_t input1_zero_point = input1->quantization() ? input1->quantization()->zero_point()->Get(0) : 0;
-    float input2_scale = input2->quantization() ? input2->quantization()->scale()->Get(0) : 1.0f;
-    int32_t input2_zero_point = input2->quantization() ? input2->quantization()->zero_point()->Get(0) : 0;
-    float output_scale = output->quantization() ? output->quantization()->scale()->Get(0) : 1.0f;
-    int32_t output_zero_point = output->quantization() ? output->quantization()->zero_point()->Get(0) : 0;
+// Shared setup for CONV_2D and DEPTHWISE_CONV_2D
+static int prepare_conv_params(const tflite::Tensor *input, const tflite::Tensor *filter,
+                               const tflite::Tensor *output, tflite::ActivationFunctionType activation,
+                               struct tflite_plan_entry *entry) {
+    struct qconv_params *params = &entry->params.conv;
+    const int output_channels = entry->output.dims[3];
+    struct quant_multiplier *multipliers;
+    int ret;
+    int c;
 
-    // Perform the ADD operation
-    for (int i = 0; i < input1->shape()->Length(); i++) {
-        int32_t input1_val = input1_buffer->data()->Get(i) - input1_zero_point;
-        int32_t input2_val = input2_buffer->data()->Get(i) - input2_zero_point;
-        int32_t output_val = input1_val + input2_val;
-        output_buffer->mutable_data()->Get(i) = output_val + output_zero_point;
+    if (!tensor_is_quantized8(input) || !tensor_is_quantized8(filter) || !tensor_is_quantized8(output)) {
+        printk(KERN_ALERT "TFLiteParserDevice: Only 8-bit quantized convolutions are supported\n");
+        return -EOPNOTSUPP;
+    }
+    // Weights and bias are used in place from the model buffer
+    if (!entry->inputs[1].constant ||
+        (entry->num_inputs > 2 && entry->inputs[2].tensor_index >= 0 && !entry->inputs[2].constant)) {
+        return -EOPNOTSUPP;
+    }
+    if (!bias_is_valid(entry, tflite::TensorType_INT32, output_channels) ||
+        !tensor_scales_are_valid(filter, output_channels)) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid bias or filter scales in convolution\n");
+        return -EINVAL;
     }
 
-    printk(KERN_INFO "TFLiteParserDevice: ADD operator executed\n");
+    params->input_offset = -tensor_zero_point(input);
+    params->filter_offset = -tensor_zero_point(filter);
+    params->output_offset = tensor_zero_point(output);
+    params->input_xor = tensor_xor_mask(input);
+    params->filter_xor = tensor_xor_mask(filter);
+    params->output_xor = tensor_xor_mask(output);
+
+    // Effective scale per output channel: input_scale * filter_scale / output_scale
+    multipliers = (struct quant_multiplier *)kcalloc(output_channels, sizeof(*multipliers), GFP_KERNEL);
+    if (!multipliers) {
+        return -ENOMEM;
+    }
+    entry->owned_data = multipliers;
+    for (c = 0; c < output_channels; c++) {
+        ret = tensor_ops_quantize_ratio(tensor_scale_bits(input, 0), tensor_scale_bits(filter, c),
+                                        tensor_scale_bits(output, 0), 0, &multipliers[c]);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    params->output_multiplier = multipliers;
+
+    return compute_activation_range(activation, output, &params->act_min, &params->act_max);
 }
 
-static void execute_mul_operator(const tflite::Operator *op, const tflite::SubGraph *subgraph, const tflite::Model *model) {
-    // Get input and output tensor indices
-    int input1_idx = op->inputs()->Get(0);
-    int input2_idx = op->inputs()->Get(1);
-    int output_idx = op->outputs()->Get(0);
+// Clamp range of a fused activation for float outputs, stored through the
+// bit patterns so that no FPU state is used at prepare time
+static int compute_activation_range_f32(tflite::ActivationFunctionType activation, float *act_min, float *act_max) {
+    uint32_t min_bits = TENSOR_OPS_FLOAT_LOWEST_BITS;
+    uint32_t max_bits = TENSOR_OPS_FLOAT_MAX_BITS;
 
-    // Get input and output tensors
-    const tflite::Tensor *input1 = subgraph->tensors()->Get(input1_idx);
-    const tflite::Tensor *input2 = subgraph->tensors()->Get(input2_idx);
-    const tflite::Tensor *output = subgraph->tensors()->Get(output_idx);
+    switch (activation) {
+        case tflite::ActivationFunctionType_NONE:
+            break;
+        case tflite::ActivationFunctionType_RELU:
+            min_bits = 0;
+            break;
+        case tflite::ActivationFunctionType_RELU6:
+            min_bits = 0;
+            max_bits = TENSOR_OPS_FLOAT_SIX_BITS;
+            break;
+        case tflite::ActivationFunctionType_RELU_N1_TO_1:
+            min_bits = TENSOR_OPS_FLOAT_MINUS_ONE_BITS;
+            max_bits = TENSOR_OPS_FLOAT_ONE_BITS;
+            break;
+        default:
+            return -EINVAL;
+    }
+    memcpy(act_min, &min_bits, sizeof(min_bits));
+    memcpy(act_max, &max_bits, sizeof(max_bits));
+    return 0;
+}
 
-    // Validate tensors
-    if (input1 == NULL || input2 == NULL || output == NULL) {
-        printk(KERN_ALERT "TFLiteParserDevice: One or more tensors are NULL in MUL operator\n");
-        return;
+// Float CONV_2D: pick direct or Winograd for this shape and repack the filter for it
+static int prepare_conv_2d_f32(const tflite::Conv2DOptions *options, const tflite::Tensor *filter,
+                               const tflite::Tensor *output, struct tflite_plan_entry *entry) {
+    struct fconv_params *params = &entry->params.fconv;
+    const int *filter_dims = entry->inputs[1].dims;
+    float *packed;
+    int ret;
+
+    if (filter->type() != tflite::TensorType_FLOAT32 || output->type() != tflite::TensorType_FLOAT32) {
+        return -EOPNOTSUPP;
+    }
+    if (!entry->inputs[1].constant ||
+        (entry->num_inputs > 2 && entry->inputs[2].tensor_index >= 0 && !entry->inputs[2].constant)) {
+        return -EOPNOTSUPP;
+    }
+    if (!bias_is_valid(entry, tflite::TensorType_FLOAT32, entry->output.dims[3])) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid bias in CONV_2D operator\n");
+        return -EINVAL;
     }
 
-    // Validate tensor shapes
-    if (input1->shape()->Length() != input2->shape()->Length() || input1->shape()->Length() != output->shape()->Length()) {
-        printk(KERN_ALERT "TFLiteParserDevice: Tensor shapes are incompatible in MUL operator\n");
-        return;
+    ret = compute_activation_range_f32(options->fused_activation_function(), &params->act_min, &params->act_max);
+    if (ret < 0) {
+        return ret;
     }
 
-    // Get input and output data buffers
-    const tflite::Buffer *input1_buffer = model->buffers()->Get(input1->buffer());
-    const tflite::Buffer *input2_buffer = model->buffers()->Get(input2->buffer());
-    tflite::Buffer *output_buffer = model->buffers()->Get(output->buffer());
+    params->algorithm = tensor_ops_conv2d_f32_select(params, filter_dims, entry->output.dims);
+    packed = (float *)kvmalloc(tensor_ops_conv2d_f32_packed_size(params->algorithm, filter_dims), GFP_KERNEL);
+    if (!packed) {
+        return -ENOMEM;
+    }
+    entry->owned_data = packed;
+    ret = tensor_ops_conv2d_f32_pack_filter(params->algorithm, filter_dims,
+                                            (const float *)entry->inputs[1].constant, packed);
+    if (ret < 0) {
+        return ret;
+    }
+    params->packed_filter = packed;
+    params->bias = entry->num_inputs > 2 ? (const float *)entry->inputs[2].constant : NULL;
 
-    // Validate buffers
-    if (input1_buffer == NULL || input2_buffer == NULL || output_buffer == NULL) {
-        printk(KERN_ALERT "TFLiteParserDevice: One or more buffers are NULL in MUL operator\n");
-        return;
+    entry->scratch_bytes = tensor_ops_conv2d_f32_scratch_size(params->algorithm, filter_dims);
+    entry->kernel = run_conv_2d_f32;
+    printk(KERN_INFO "TFLiteParserDevice: CONV_2D %dx%dx%d -> %d uses %s\n",
+           filter_dims[1], filter_dims[2], filter_dims[3], filter_dims[0],
+           params->algorithm == TENSOR_OPS_CONV_WINOGRAD ? "winograd" : "direct");
+    return 0;
+}
+
+// Extent of the output along one spatial axis for the given window, or -1 if
+// the dilated window does not fit the input
+static int window_output_size(int input, int filter, int stride, int dilation, bool same_padding) {
+    int effective;
+
+    if (filter - 1 > (INT_MAX - 1) / dilation) {
+        return -1;
+    }
+    effective = (filter - 1) * dilation + 1;
+    if (same_padding) {
+        return (input - 1) / stride + 1;
+    }
+    if (effective > input) {
+        return -1;
+    }
+    return (input - effective) / stride + 1;
+}
+
+// Strides, dilations and window sizes divide or bound the kernels' loops, the
+// batch of the output is read from the input, and the kernels write exactly
+// the output extent the window produces
+static bool window_is_valid(const int *input_dims, const int *output_dims, int stride_h, int stride_w,
+                            int dilation_h, int dilation_w, int filter_h, int filter_w, bool same_padding) {
+    if (stride_h <= 0 || stride_w <= 0 || dilation_h <= 0 || dilation_w <= 0 || filter_h <= 0 || filter_w <= 0 ||
+        input_dims[3] <= 0 || input_dims[0] != output_dims[0]) {
+        return false;
+    }
+    return window_output_size(input_dims[1], filter_h, stride_h, dilation_h, same_padding) == output_dims[1] &&
+           window_output_size(input_dims[2], filter_w, stride_w, dilation_w, same_padding) == output_dims[2];
+}
+
+static int prepare_conv_2d(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    const tflite::Conv2DOptions *options = op->builtin_options_as_Conv2DOptions();
+    const tflite::Tensor *input;
+    const int *input_dims = entry->inputs[0].dims;
+    const int *filter_dims = entry->inputs[1].dims;
+    const int *output_dims = entry->output.dims;
+    int stride_h, stride_w, dilation_h, dilation_w, pad_h, pad_w;
+    bool same_padding;
+    int ret;
+
+    if (!options || entry->num_inputs < 2 || filter_dims[3] != input_dims[3] || filter_dims[0] != output_dims[3]) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid tensors in CONV_2D operator\n");
+        return -EINVAL;
+    }
+
+    same_padding = options->padding() == tflite::Padding_SAME;
+    stride_h = options->stride_h();
+    stride_w = options->stride_w();
+    dilation_h = options->dilation_h_factor();
+    dilation_w = options->dilation_w_factor();
+    if (!window_is_valid(input_dims, output_dims, stride_h, stride_w, dilation_h, dilation_w,
+                         filter_dims[1], filter_dims[2], same_padding)) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid geometry in CONV_2D operator\n");
+        return -EINVAL;
+    }
+    pad_h = tensor_ops_compute_padding(input_dims[1], filter_dims[1], stride_h, dilation_h, output_dims[1], same_padding);
+    pad_w = tensor_ops_compute_padding(input_dims[2], filter_dims[2], stride_w, dilation_w, output_dims[2], same_padding);
+
+    input = subgraph->tensors()->Get(op->inputs()->Get(0));
+    if (input->type() == tflite::TensorType_FLOAT32) {
+        struct fconv_params *params = &entry->params.fconv;
+
+        params->stride_h = stride_h;
+        params->stride_w = stride_w;
+        params->dilation_h = dilation_h;
+        params->dilation_w = dilation_w;
+        params->pad_h = pad_h;
+        params->pad_w = pad_w;
+        return prepare_conv_2d_f32(options, subgraph->tensors()->Get(op->inputs()->Get(1)),
+                                   subgraph->tensors()->Get(op->outputs()->Get(0)), entry);
+    }
+
+    ret = prepare_conv_params(input,
+                              subgraph->tensors()->Get(op->inputs()->Get(1)),
+                              subgraph->tensors()->Get(op->outputs()->Get(0)),
+                              options->fused_activation_function(), entry);
+    if (ret < 0) {
+        return ret;
     }
 
-    // Handle quantization parameters
-    float input1_scale = input1->quantization() ? input1->quantization()->scale()->Get(0) : 1.0f;
-    int32_t input1_zero_point = input1->quantization() ? input1->quantization()->zero_point()->Get(0) : 0;
-    float input2_scale = input2->quantization() ? input2->quantization()->scale()->Get(0) : 1.0f;
-    int32_t input2_zero_point = input2->quantization() ? input2->quantization()->zero_point()->Get(0) : 0;
-    float output_scale = output->quantization() ? output->quantization()->scale()->Get(0) : 1.0f;
-    int32_t output_zero_point = output->quantization() ? output->quantization()->zero_point()->Get(0) : 0;
+    entry->params.conv.stride_h = stride_h;
+    entry->params.conv.stride_w = stride_w;
+    entry->params.conv.dilation_h = dilation_h;
+    entry->params.conv.dilation_w = dilation_w;
+    entry->params.conv.depth_multiplier = 1;
+    entry->params.conv.pad_h = pad_h;
+    entry->params.conv.pad_w = pad_w;
+
+    entry->kernel = run_conv_2d;
+    return 0;
+}
+
+static int prepare_depthwise_conv_2d(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    const tflite::DepthwiseConv2DOptions *options = op->builtin_options_as_DepthwiseConv2DOptions();
+    const int *input_dims = entry->inputs[0].dims;
+    const int *filter_dims = entry->inputs[1].dims;
+    const int *output_dims = entry->output.dims;
+    struct qconv_params *params = &entry->params.conv;
+    bool same_padding;
+    int ret;
+
+    if (!options || entry->num_inputs < 2 || filter_dims[3] != output_dims[3] ||
+        !window_is_valid(input_dims, output_dims, options->stride_h(), options->stride_w(),
+                         options->dilation_h_factor(), options->dilation_w_factor(), filter_dims[1], filter_dims[2],
+                         options->padding() == tflite::Padding_SAME) ||
+        output_dims[3] % input_dims[3] != 0) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid tensors in DEPTHWISE_CONV_2D operator\n");
+        return -EINVAL;
+    }
 
-    // Perform the MUL operation
-    for (int i = 0; i < input1->shape()->Length(); i++) {
-        int32_t input1_val = input1_buffer->data()->Get(i) - input1_zero_point;
-        int32_t input2_val = input2_buffer->data()->Get(i) - input2_zero_point;
-        int32_t output_val = input1_val * input2_val;
-        output_buffer->mutable_data()->Get(i) = output_val + output_zero_point;
+    ret = prepare_conv_params(subgraph->tensors()->Get(op->inputs()->Get(0)),
+                              subgraph->tensors()->Get(op->inputs()->Get(1)),
+                              subgraph->tensors()->Get(op->outputs()->Get(0)),
+                              options->fused_activation_function(), entry);
+    if (ret < 0) {
+        return ret;
     }
 
-    printk(KERN_INFO "TFLiteParserDevice: MUL operator executed\n");
+    same_padding = options->padding() == tflite::Padding_SAME;
+    params->stride_h = options->stride_h();
+    params->stride_w = options->stride_w();
+    params->dilation_h = options->dilation_h_factor();
+    params->dilation_w = options->dilation_w_factor();
+    // Some converters leave depth_multiplier unset, so derive it from the shapes
+    params->depth_multiplier = output_dims[3] / input_dims[3];
+    params->pad_h = tensor_ops_compute_padding(input_dims[1], filter_dims[1], params->stride_h, params->dilation_h, output_dims[1], same_padding);
+    params->pad_w = tensor_ops_compute_padding(input_dims[2], filter_dims[2], params->stride_w, params->dilation_w, output_dims[2], same_padding);
+
+    entry->kernel = run_depthwise_conv_2d;
+    return 0;
 }
 
-static void execute_sub_operator(const tflite::Operator *op, const tflite::SubGraph *subgraph, const tflite::Model *model) {
-    // Get input and output tensor indices
-    int input1_idx = op->inputs()->Get(0);
-    int input2_idx = op->inputs()->Get(1);
-    int output_idx = op->outputs()->Get(0);
+static int prepare_average_pool_2d(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    const tflite::Pool2DOptions *options = op->builtin_options_as_Pool2DOptions();
+    const tflite::Tensor *input = subgraph->tensors()->Get(op->inputs()->Get(0));
+    const tflite::Tensor *output = subgraph->tensors()->Get(op->outputs()->Get(0));
+    const int *input_dims = entry->inputs[0].dims;
+    const int *output_dims = entry->output.dims;
+    struct qpool_params *params = &entry->params.pool;
+    bool same_padding;
+    int ret;
 
-    // Get input and output tensors
-    const tflite::Tensor *input1 = subgraph->tensors()->Get(input1_idx);
-    const tflite::Tensor *input2 = subgraph->tensors()->Get(input2_idx);
-    const tflite::Tensor *output = subgraph->tensors()->Get(output_idx);
+    if (!options || input_dims[3] != output_dims[3] ||
+        !window_is_valid(input_dims, output_dims, options->stride_h(), options->stride_w(), 1, 1,
+                         options->filter_height(), options->filter_width(),
+                         options->padding() == tflite::Padding_SAME)) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid tensors in AVERAGE_POOL_2D operator\n");
+        return -EINVAL;
+    }
+    if (!tensor_is_quantized8(input) || input->type() != output->type()) {
+        return -EOPNOTSUPP;
+    }
 
-    // Validate tensors
-    if (input1 == NULL || input2 == NULL || output == NULL) {
-        printk(KERN_ALERT "TFLiteParserDevice: One or more tensors are NULL in SUB operator\n");
-        return;
+    ret = compute_activation_range(options->fused_activation_function(), output, &params->act_min, &params->act_max);
+    if (ret < 0) {
+        return ret;
     }
 
-    // Validate tensor shapes
-    if (input1->shape()->Length() != input2->shape()->Length() || input1->shape()->Length() != output->shape()->Length()) {
-        printk(KERN_ALERT "TFLiteParserDevice: Tensor shapes are incompatible in SUB operator\n");
-        return;
+    same_padding = options->padding() == tflite::Padding_SAME;
+    params->stride_h = options->stride_h();
+    params->stride_w = options->stride_w();
+    params->filter_h = options->filter_height();
+    params->filter_w = options->filter_width();
+    params->xor_mask = tensor_xor_mask(input);
+    params->pad_h = tensor_ops_compute_padding(input_dims[1], params->filter_h, params->stride_h, 1, output_dims[1], same_padding);
+    params->pad_w = tensor_ops_compute_padding(input_dims[2], params->filter_w, params->stride_w, 1, output_dims[2], same_padding);
+
+    entry->kernel = run_average_pool_2d;
+    return 0;
+}
+
+// FULLY_CONNECTED: the weights are repacked into GEMM panels here, once per
+// model, and the constant offset terms are folded into the bias
+static int prepare_fully_connected(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    const tflite::FullyConnectedOptions *options = op->builtin_options_as_FullyConnectedOptions();
+    const tflite::Tensor *input = subgraph->tensors()->Get(op->inputs()->Get(0));
+    const tflite::Tensor *filter = subgraph->tensors()->Get(op->inputs()->Get(1));
+    const tflite::Tensor *output = subgraph->tensors()->Get(op->outputs()->Get(0));
+    struct qfc_params *params = &entry->params.fully_connected;
+    const int output_depth = entry->inputs[1].dims[2];
+    const int accum_depth = entry->inputs[1].dims[3];
+    struct quant_multiplier *multipliers;
+    int32_t *folded_bias;
+    uint8_t *packed;
+    size_t batches;
+    int ret;
+    int c;
+
+    if (entry->num_inputs < 2 || entry->inputs[1].rank != 2 || output_depth <= 0 || accum_depth <= 0 ||
+        entry->inputs[0].bytes % accum_depth != 0) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid tensors in FULLY_CONNECTED operator\n");
+        return -EINVAL;
+    }
+    batches = entry->inputs[0].bytes / accum_depth;
+    if (entry->output.bytes != batches * output_depth) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid tensors in FULLY_CONNECTED operator\n");
+        return -EINVAL;
+    }
+    if (!tensor_is_quantized8(input) || !tensor_is_quantized8(filter) || !tensor_is_quantized8(output) ||
+        (options && options->weights_format() != tflite::FullyConnectedOptionsWeightsFormat_DEFAULT)) {
+        return -EOPNOTSUPP;
+    }
+    if (!entry->inputs[1].constant ||
+        (entry->num_inputs > 2 && entry->inputs[2].tensor_index >= 0 && !entry->inputs[2].constant)) {
+        return -EOPNOTSUPP;
+    }
+    if (!bias_is_valid(entry, tflite::TensorType_INT32, output_depth) || !tensor_scales_are_valid(filter, output_depth)) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid bias or filter scales in FULLY_CONNECTED operator\n");
+        return -EINVAL;
+    }
+
+    // Multipliers, folded bias and packed weights share one allocation
+    multipliers = (struct quant_multiplier *)kvzalloc(output_depth * (sizeof(*multipliers) + sizeof(*folded_bias)) +
+                                                      tensor_ops_qgemm_packed_size(output_depth, accum_depth), GFP_KERNEL);
+    if (!multipliers) {
+        return -ENOMEM;
+    }
+    entry->owned_data = multipliers;
+    folded_bias = (int32_t *)(multipliers + output_depth);
+    packed = (uint8_t *)(folded_bias + output_depth);
+
+    for (c = 0; c < output_depth; c++) {
+        ret = tensor_ops_quantize_ratio(tensor_scale_bits(input, 0), tensor_scale_bits(filter, c),
+                                        tensor_scale_bits(output, 0), 0, &multipliers[c]);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    params->output_depth = output_depth;
+    params->accum_depth = accum_depth;
+    params->input_offset = -tensor_zero_point(input);
+    params->filter_offset = -tensor_zero_point(filter);
+    params->output_offset = tensor_zero_point(output);
+    params->input_xor = tensor_xor_mask(input);
+    params->output_xor = tensor_xor_mask(output);
+    params->output_multiplier = multipliers;
+
+    tensor_ops_qgemm_pack_weights(output_depth, accum_depth, entry->inputs[1].constant,
+                                  tensor_xor_mask(filter), packed);
+    params->packed_weights = packed;
+    tensor_ops_qgemm_fold_bias(params, (const int32_t *)entry->inputs[2].constant, folded_bias);
+    params->bias = folded_bias;
+
+    ret = compute_activation_range(options ? options->fused_activation_function() : tflite::ActivationFunctionType_NONE,
+                                   output, &params->act_min, &params->act_max);
+    if (ret < 0) {
+        return ret;
+    }
+
+    entry->scratch_bytes = tensor_ops_fully_connected_q8_scratch_size(output_depth, batches);
+    entry->kernel = run_fully_connected;
+    return 0;
+}
+
+// RESHAPE and SQUEEZE only change the shape, so the data is copied as is
+static int prepare_reshape(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    if (entry->inputs[0].bytes != entry->output.bytes) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid tensors in RESHAPE operator\n");
+        return -EINVAL;
+    }
+    entry->kernel = run_reshape;
+    return 0;
+}
+
+static int prepare_softmax(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    const tflite::Tensor *input = subgraph->tensors()->Get(op->inputs()->Get(0));
+    const tflite::Tensor *output = subgraph->tensors()->Get(op->outputs()->Get(0));
+    const tflite::SoftmaxOptions *options = op->builtin_options_as_SoftmaxOptions();
+    struct qsoftmax_params *params;
+    int ret;
+
+    if (!tensor_is_quantized8(input) || !tensor_is_quantized8(output) ||
+        entry->inputs[0].bytes != entry->output.bytes || entry->output.dims[3] <= 0) {
+        printk(KERN_ALERT "TFLiteParserDevice: Invalid tensors in SOFTMAX operator\n");
+        return -EINVAL;
+    }
+    // Quantized softmax outputs always use a scale of 1/256
+    if (tensor_scale_bits(output, 0) != TENSOR_OPS_FLOAT_1_256_BITS) {
+        return -EOPNOTSUPP;
+    }
+
+    params = (struct qsoftmax_params *)kzalloc(sizeof(*params), GFP_KERNEL);
+    if (!params) {
+        return -ENOMEM;
+    }
+    entry->owned_data = params;
+
+    ret = tensor_ops_softmax_prepare(options_float_bits(options, tflite::SoftmaxOptions::VT_BETA, 0),
+                                     tensor_scale_bits(input, 0), params);
+    if (ret < 0) {
+        return ret;
+    }
+    params->input_xor = tensor_xor_mask(input);
+    params->output_xor = tensor_xor_mask(output);
+    params->output_offset = tensor_zero_point(output);
+
+    entry->params.softmax = params;
+    entry->kernel = run_softmax;
+    return 0;
+}
+
+// ADD / SUB / MUL: input and output scales are folded into integer
+// multipliers here so the kernels never need the FPU
+static int prepare_elementwise(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    const tflite::Tensor *input1 = subgraph->tensors()->Get(op->inputs()->Get(0));
+    const tflite::Tensor *input2 = subgraph->tensors()->Get(op->inputs()->Get(1));
+    const tflite::Tensor *output = subgraph->tensors()->Get(op->outputs()->Get(0));
+    struct qelementwise_params *params = &entry->params.elementwise;
+    tflite::ActivationFunctionType activation = tflite::ActivationFunctionType_NONE;
+    int ret;
+
+    if (!tensor_is_quantized8(input1) || !tensor_is_quantized8(input2) || !tensor_is_quantized8(output)) {
+        return -EOPNOTSUPP;
+    }
+    // Dims are already padded to rank 4, which right-aligns them for broadcasting
+    ret = tensor_ops_broadcast_prepare(4, entry->inputs[0].dims, 4, entry->inputs[1].dims,
+                                       4, entry->output.dims, &entry->broadcast);
+    if (ret < 0) {
+        printk(KERN_ALERT "TFLiteParserDevice: Tensor shapes are incompatible in elementwise operator\n");
+        return ret;
+    }
+    entry->scratch_bytes = tensor_ops_broadcast_scratch_size(&entry->broadcast, 1);
+
+    params->input1_offset = -tensor_zero_point(input1);
+    params->input2_offset = -tensor_zero_point(input2);
+    params->output_offset = tensor_zero_point(output);
+    params->input1_xor = tensor_xor_mask(input1);
+    params->input2_xor = tensor_xor_mask(input2);
+    params->output_xor = tensor_xor_mask(output);
+
+    switch (entry->opcode) {
+        case tflite::BuiltinOperator_ADD:
+            if (op->builtin_options_as_AddOptions()) {
+                activation = op->builtin_options_as_AddOptions()->fused_activation_function();
+            }
+            ret = tensor_ops_add_prepare(tensor_scale_bits(input1, 0), tensor_scale_bits(input2, 0),
+                                         tensor_scale_bits(output, 0), params);
+            entry->kernel = run_add;
+            break;
+        case tflite::BuiltinOperator_SUB:
+            if (op->builtin_options_as_SubOptions()) {
+                activation = op->builtin_options_as_SubOptions()->fused_activation_function();
+            }
+            ret = tensor_ops_add_prepare(tensor_scale_bits(input1, 0), tensor_scale_bits(input2, 0),
+                                         tensor_scale_bits(output, 0), params);
+            entry->kernel = run_sub;
+            break;
+        default:
+            if (op->builtin_options_as_MulOptions()) {
+                activation = op->builtin_options_as_MulOptions()->fused_activation_function();
+            }
+            ret = tensor_ops_mul_prepare(tensor_scale_bits(input1, 0), tensor_scale_bits(input2, 0),
+                                         tensor_scale_bits(output, 0), params);
+            entry->kernel = run_mul;
+            break;
+    }
+    if (ret < 0) {
+        printk(KERN_ALERT "TFLiteParserDevice: Scales out of range in elementwise operator\n");
+        return ret;
+    }
+
+    return compute_activation_range(activation, output, &params->act_min, &params->act_max);
+}
+
+// Inputs every operator reads through op->inputs(), which must not be
+// omitted; bias and shape inputs are optional
+static int required_inputs(int opcode) {
+    switch (opcode) {
+        case tflite::BuiltinOperator_CONV_2D:
+        case tflite::BuiltinOperator_DEPTHWISE_CONV_2D:
+        case tflite::BuiltinOperator_FULLY_CONNECTED:
+        case tflite::BuiltinOperator_ADD:
+        case tflite::BuiltinOperator_MUL:
+        case tflite::BuiltinOperator_SUB:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+static int prepare_operator(const tflite::Operator *op, const tflite::SubGraph *subgraph, struct tflite_plan_entry *entry) {
+    int i;
+
+    if (entry->num_inputs < required_inputs(entry->opcode)) {
+        return -EINVAL;
+    }
+    for (i = 0; i < required_inputs(entry->opcode); i++) {
+        if (entry->inputs[i].tensor_index < 0) {
+            return -EINVAL;
+        }
+    }
+
+    switch (entry->opcode) {
+        case tflite::BuiltinOperator_CONV_2D:
+            return prepare_conv_2d(op, subgraph, entry);
+        case tflite::BuiltinOperator_DEPTHWISE_CONV_2D:
+            return prepare_depthwise_conv_2d(op, subgraph, entry);
+        case tflite::BuiltinOperator_AVERAGE_POOL_2D:
+            return prepare_average_pool_2d(op, subgraph, entry);
+        case tflite::BuiltinOperator_FULLY_CONNECTED:
+            return prepare_fully_connected(op, subgraph, entry);
+        case tflite::BuiltinOperator_RESHAPE:
+        case tflite::BuiltinOperator_SQUEEZE:
+            return prepare_reshape(op, subgraph, entry);
+        case tflite::BuiltinOperator_SOFTMAX:
+            return prepare_softmax(op, subgraph, entry);
+        case tflite::BuiltinOperator_ADD:
+        case tflite::BuiltinOperator_MUL:
+        case tflite::BuiltinOperator_SUB:
+            return prepare_elementwise(op, subgraph, entry);
+        default:
+            printk(KERN_INFO "TFLiteParserDevice: Unsupported operator %d\n", entry->opcode);
+            return -EOPNOTSUPP;
+    }
+}
+
+// Resolve the shape of every tensor of the main subgraph and point constant
+// tensors at their data in the model buffer
+static int resolve_operands(const tflite::Model *model, const tflite::SubGraph *subgraph,
+                            struct tflite_plan_operand *operands) {
+    const int num_tensors = subgraph->tensors()->size();
+    int i;
+
+    for (i = 0; i < num_tensors; i++) {
+        const tflite::Tensor *tensor = subgraph->tensors()->Get(i);
+        const tflite::Buffer *buffer = model->buffers()->Get(tensor->buffer());
+        struct tflite_plan_operand *operand = &operands[i];
+
+        operand->tensor_index = i;
+        operand->type = tensor->type();
+        operand->scale_bits = tensor_scale_bits(tensor, 0);
+        operand->zero_point = tensor_model_zero_point(tensor);
+        operand->rank = tensor->shape() ? tensor->shape()->size() : 0;
+        if (tensor->shape()) {
+            for (auto dim : *tensor->shape()) {
+                if (dim <= 0) {
+                    printk(KERN_ALERT "TFLiteParserDevice: Tensor %d has a dimension of %d\n", i, dim);
+                    return -EINVAL;
+                }
+            }
+        }
+        operand->bytes = tensor_num_elements(tensor) * tensor_type_size(tensor->type());
+        if (tensor_dims4(tensor, operand->dims) < 0) {
+            printk(KERN_ALERT "TFLiteParserDevice: Tensor %d has more than 4 dimensions\n", i);
+            return -EOPNOTSUPP;
+        }
+
+        if (buffer && buffer->data() && buffer->data()->size() > 0) {
+            if (buffer->data()->size() < operand->bytes) {
+                printk(KERN_ALERT "TFLiteParserDevice: Tensor %d buffer is smaller than its shape\n", i);
+                return -EINVAL;
+            }
+            operand->constant = buffer->data()->Data();
+        }
+    }
+    return 0;
+}
+
+// Place activations and per-operator scratch buffers in the arena with the
+// lifetime-based planner. Scratch buffers live only for their own operator.
+static int plan_activations(const tflite::SubGraph *subgraph, struct tflite_plan *plan,
+                            struct tflite_plan_operand *operands) {
+    const int num_tensors = subgraph->tensors()->size();
+    const int num_ops = plan->num_entries;
+    struct arena_allocation *allocations;
+    int ret;
+    int i, j;
+
+    allocations = (struct arena_allocation *)kcalloc(num_tensors + num_ops, sizeof(*allocations), GFP_KERNEL);
+    if (!allocations) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < num_tensors; i++) {
+        allocations[i].size = operands[i].constant ? 0 : operands[i].bytes;
+        allocations[i].first_use = INT_MAX;
+        allocations[i].last_use = -1;
+    }
+    for (i = 0; i < num_ops; i++) {
+        const tflite::Operator *op = subgraph->operators()->Get(i);
+        for (auto idx : *op->inputs()) {
+            if (idx >= 0) {
+                allocations[idx].first_use = min(allocations[idx].first_use, i);
+                allocations[idx].last_use = max(allocations[idx].last_use, i);
+            }
+        }
+        for (auto idx : *op->outputs()) {
+            allocations[idx].first_use = min(allocations[idx].first_use, i);
+            allocations[idx].last_use = max(allocations[idx].last_use, i);
+        }
+        allocations[num_tensors + i].size = plan->entries[i].scratch_bytes;
+        allocations[num_tensors + i].first_use = i;
+        allocations[num_tensors + i].last_use = i;
+    }
+    // Model inputs are written before the first operator, outputs read after the last
+    for (auto idx : *subgraph->inputs()) {
+        allocations[idx].first_use = 0;
+        allocations[idx].last_use = max(allocations[idx].last_use, 0);
+    }
+    for (auto idx : *subgraph->outputs()) {
+        allocations[idx].first_use = min(allocations[idx].first_use, num_ops);
+        allocations[idx].last_use = num_ops;
+    }
+    for (i = 0; i < num_tensors; i++) {
+        if (allocations[i].last_use < 0) {
+            allocations[i].size = 0;
+        }
+    }
+
+    ret = tensor_ops_plan_arena(allocations, num_tensors + num_ops, TFLITE_ARENA_ALIGNMENT, &plan->arena_size);
+    if (ret < 0) {
+        kfree(allocations);
+        return ret;
+    }
+
+    for (i = 0; i < num_tensors; i++) {
+        operands[i].arena_offset = allocations[i].offset;
+    }
+    for (i = 0; i < num_ops; i++) {
+        struct tflite_plan_entry *entry = &plan->entries[i];
+
+        for (j = 0; j < TFLITE_PLAN_MAX_INPUTS; j++) {
+            if (entry->inputs[j].tensor_index >= 0) {
+                entry->inputs[j].arena_offset = allocations[entry->inputs[j].tensor_index].offset;
+            }
+        }
+        entry->output.arena_offset = allocations[entry->output.tensor_index].offset;
+        entry->scratch_offset = allocations[num_tensors + i].offset;
     }
+    kfree(allocations);
+    return 0;
+}
 
-    // Get input and output data buffers
-    const tflite::Buffer *input1_buffer = model->buffers()->Get(input1->buffer());
-    const tflite::Buffer *input2_buffer = model->buffers()->Get(input2->buffer());
-    tflite::Buffer *output_buffer = model->buffers()->Get(output->buffer());
+static void destroy_plan(struct tflite_plan *plan) {
+    int i;
 
-    // Validate buffers
-    if (input1_buffer == NULL || input2_buffer == NULL || output_buffer == NULL) {
-        printk(KERN_ALERT "TFLiteParserDevice: One or more buffers are NULL in SUB operator\n");
+    if (!plan) {
         return;
     }
+    if (plan->entries) {
+        for (i = 0; i < plan->num_entries; i++) {
+            kvfree(plan->entries[i].owned_data);
+        }
+    }
+    kfree(plan->entries);
+    kfree(plan->inputs);
+    kfree(plan->outputs);
+    kfree(plan);
+}
+
+// Function to compile the main subgraph into a flat array of resolved kernels.
+// Runs once per model; invoke_plan() then never touches the flatbuffer.
+static struct tflite_plan *prepare_model(const tflite::Model *model) {
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+    const int num_tensors = subgraph->tensors()->size();
+    const int num_ops = subgraph->operators()->size();
+    struct tflite_plan_operand *operands;
+    struct tflite_plan *plan;
+    int ret = -ENOMEM;
+    int i, j;
+
+    plan = (struct tflite_plan *)kzalloc(sizeof(*plan), GFP_KERNEL);
+    operands = (struct tflite_plan_operand *)kcalloc(num_tensors, sizeof(*operands), GFP_KERNEL);
+    if (!plan || !operands) {
+        goto fail;
+    }
+    plan->num_entries = num_ops;
+    plan->entries = (struct tflite_plan_entry *)kcalloc(num_ops, sizeof(*plan->entries), GFP_KERNEL);
+    plan->num_inputs = subgraph->inputs()->size();
+    plan->inputs = (struct tflite_plan_operand *)kcalloc(plan->num_inputs, sizeof(*plan->inputs), GFP_KERNEL);
+    plan->num_outputs = subgraph->outputs()->size();
+    plan->outputs = (struct tflite_plan_operand *)kcalloc(plan->num_outputs, sizeof(*plan->outputs), GFP_KERNEL);
+    if (!plan->entries || !plan->inputs || !plan->outputs) {
+        goto fail;
+    }
+
+    ret = resolve_operands(model, subgraph, operands);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    for (i = 0; i < num_ops; i++) {
+        const tflite::Operator *op = subgraph->operators()->Get(i);
+        struct tflite_plan_entry *entry = &plan->entries[i];
+
+        entry->opcode = tflite_builtin_code(model->operator_codes()->Get(op->opcode_index()));
+        entry->num_inputs = min((int)op->inputs()->size(), TFLITE_PLAN_MAX_INPUTS);
+        for (j = 0; j < TFLITE_PLAN_MAX_INPUTS; j++) {
+            int idx = j < entry->num_inputs ? op->inputs()->Get(j) : -1;
+            if (idx >= 0) {
+                entry->inputs[j] = operands[idx];
+            } else {
+                entry->inputs[j].tensor_index = -1;
+            }
+        }
+        if (op->outputs()->size() != 1 || operands[op->outputs()->Get(0)].constant) {
+            ret = -EOPNOTSUPP;
+            goto fail;
+        }
+        entry->output = operands[op->outputs()->Get(0)];
+
+        ret = prepare_operator(op, subgraph, entry);
+        if (ret < 0) {
+            printk(KERN_ALERT "TFLiteParserDevice: Failed to prepare operator %d (code %d)\n", i, entry->opcode);
+            goto fail;
+        }
+    }
 
-    // Handle quantization parameters
-    float input1_scale = input1->quantization() ? input1->quantization()->scale()->Get(0) : 1.0f;
-    int32_t input1_zero_point = input1->quantization() ? input1->quantization()->zero_point()->Get(0) : 0;
-    float input2_scale = input2->quantization() ? input2->quantization()->scale()->Get(0) : 1.0f;
-    int32_t input2_zero_point = input2->quantization() ? input2->quantization()->zero_point()->Get(0) : 0;
-    float output_scale = output->quantization() ? output->quantization()->scale()->Get(0) : 1.0f;
-    int32_t output_zero_point = output->quantization() ? output->quantization()->zero_point()->Get(0) : 0;
+    // Arena offsets are assigned last, once every operator's scratch size is known
+    ret = plan_activations(subgraph, plan, operands);
+    if (ret < 0) {
+        goto fail;
+    }
 
-    // Perform the SUB operation
-    for (int i = 0; i < input1->shape()->Length(); i++) {
-        int32_t input1_val = input1_buffer->data()->Get(i) - input1_zero_point;
-        int32_t input2_val = input2_buffer->data()->Get(i) - input2_zero_point;
-        int32_t output_val = input1_val - input2_val;
-        output_buffer->mutable_data()->Get(i) = output_val + output_zero_point;
+    for (i = 0; i < plan->num_inputs; i++) {
+        plan->inputs[i] = operands[subgraph->inputs()->Get(i)];
+    }
+    for (i = 0; i < plan->num_outputs; i++) {
+        plan->outputs[i] = operands[subgraph->outputs()->Get(i)];
     }
 
-    printk(KERN_INFO "TFLiteParserDevice: SUB operator executed\n");
+    kfree(operands);
+    return plan;
+
+fail:
+    kfree(operands);
+    destroy_plan(plan);
+    return (struct tflite_plan *)ERR_PTR(ret);
+}
+
+// Plans for other modules. A plan is immutable once prepared, so one plan can
+// be invoked concurrently against separate arenas of plan->arena_size bytes.
+struct tflite_plan *tflite_plan_create(const void *model_data, size_t model_size) {
+    flatbuffers::Verifier verifier((const uint8_t *)model_data, model_size);
+    const tflite::Model *model;
+    struct tflite_plan *plan;
+
+    trace_tflite_prepare_begin(model_size);
+    if (!tflite::VerifyModelBuffer(verifier)) {
+        plan = (struct tflite_plan *)ERR_PTR(-EINVAL);
+    } else {
+        model = tflite::GetModel(model_data);
+        if (validate_model(model) < 0) {
+            plan = (struct tflite_plan *)ERR_PTR(-EINVAL);
+        } else {
+            plan = prepare_model(model);
+        }
+    }
+    if (IS_ERR(plan)) {
+        trace_tflite_prepare_end(0, 0, PTR_ERR(plan));
+    } else {
+        trace_tflite_prepare_end(plan->num_entries, plan->arena_size, 0);
+    }
+    return plan;
+}
+EXPORT_SYMBOL_GPL(tflite_plan_create);
+
+void tflite_plan_destroy(struct tflite_plan *plan) {
+    destroy_plan(plan);
+}
+EXPORT_SYMBOL_GPL(tflite_plan_destroy);
+
+int tflite_plan_invoke(const struct tflite_plan *plan, uint8_t *arena) {
+    return invoke_plan(plan, arena);
 }
+EXPORT_SYMBOL_GPL(tflite_plan_invoke);
 
 static struct file_operations fops = {
     .open = dev_open,
@@ -334,7 +1363,7 @@ static int __init tflite_parser_device_init(void) {
     }
     printk(KERN_INFO "TFLiteParserDevice: Device class created correctly\n");
 
-    kernel_buffer = kmalloc(1024, GFP_KERNEL);
+    kernel_buffer = (char *)kzalloc(1024, GFP_KERNEL);
     if (!kernel_buffer) {
         device_destroy(tflite_parser_class, MKDEV(major_number, 0));
         class_destroy(tflite_parser_class);
@@ -347,6 +1376,7 @@ static int __init tflite_parser_device_init(void) {
 }
 
 static void __exit tflite_parser_device_exit(void) {
+    free_model();
     kfree(kernel_buffer);
     device_destroy(tflite_parser_class, MKDEV(major_number, 0));
     class_unregister(tflite_parser_class);
@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Correctness test of the tensor_ops kernels. With selftest=1 the module checks
+# every kernel, thread pool path and the arena planner against a scalar
+# reference at load time, and refuses to load if any of them disagrees.
+
+# Check a forced variant with SIMD=scalar|sse2|avx2|neon; every supported
+# variant of the elementwise kernels is checked either way
+SIMD=${SIMD:-auto}
+
+sudo dmesg -C
+sudo insmod src/tensor_ops.ko selftest=1 simd=$SIMD
+status=$?
+
+dmesg | grep "TensorOps: Self-test"
+
+if [ $status -ne 0 ]; then
+    echo "Error: tensor_ops self-test failed" >&2
+    exit 1
+fi
+
+sudo rmmod tensor_ops
+echo "Self-test completed successfully"
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Microbenchmark of the scalar and vectorized elementwise kernels in tensor_ops.
+# The module times every variant the CPU supports at load time.
+
+# Force a variant for the interpreters with SIMD=scalar|sse2|avx2|neon
+SIMD=${SIMD:-auto}
+
+sudo dmesg -C
+sudo insmod src/tensor_ops.ko benchmark=1 simd=$SIMD
+if [ $? -ne 0 ]; then
+    echo "Error: Failed to load tensor_ops" >&2
+    exit 1
+fi
+
+# One line per kernel and variant, with the speedup over the scalar kernels
+dmesg | grep "TensorOps:"
+
+sudo rmmod tensor_ops
@@ -50,12 +50,17 @@ free -m
 ulimit -a
 lsof | wc -l
 
-# Read the results from the device
-cat /dev/tensorflow_interpreter_device
+# Read the results from the device; they are binary (include/tensor_results.h)
+cat /dev/tensorflow_interpreter_device > /tmp/tensorflow_results.bin
 if [ $? -ne 0 ]; then
     echo "Error: Failed to read results" >&2
     exit 1
 fi
+if [ "$(head -c 4 /tmp/tensorflow_results.bin)" != "TSNR" ]; then
+    echo "Error: Results do not start with the tensor results header" >&2
+    exit 1
+fi
+od -A d -t x1 /tmp/tensorflow_results.bin | head -n 8
 
 # Log system resource usage after reading results
 echo "Logging system resource usage after reading results..."